@@ -22,6 +22,8 @@
 
 #include "ScateConfigPage.hpp"
 #include "ScatePlugin.hpp"
+#include "ScateSession.hpp"
+#include "ScateSettings.hpp"
 
 #include <klocale.h>
 #include <kconfiggroup.h>
@@ -35,6 +37,7 @@
 #include <QLabel>
 #include <QToolBar>
 #include <QAction>
+#include <QHeaderView>
 
 /*********************** CONFIG ******************************/
 
@@ -50,6 +53,16 @@ ScateConfigPage::ScateConfigPage( ScatePlugin *plugin_, QWidget *parent )
     sclangExeEdit = new QLineEdit();
     dataDirEdit = new QLineEdit();
     startLangCheck = new QCheckBox( "Start With Scate" );
+    standbyCheck = new QCheckBox( "Keep a Standby Interpreter for Fast Restart" );
+    evalFileSpin = new QSpinBox();
+    evalFileSpin->setRange( 0, 1024 * 1024 );
+    evalFileSpin->setSingleStep( 64 );
+    evalFileSpin->setSuffix( " KiB" );
+    evalFileSpin->setSpecialValueText( "Never" );
+    stallTimeoutSpin = new QSpinBox();
+    stallTimeoutSpin->setRange( 0, 3600 );
+    stallTimeoutSpin->setSuffix( " s" );
+    stallTimeoutSpin->setSpecialValueText( "Never" );
 
     QFormLayout *sclangForm = new QFormLayout();
     sclangForm->setContentsMargins(0,0,0,0);
@@ -57,14 +70,31 @@ ScateConfigPage::ScateConfigPage( ScatePlugin *plugin_, QWidget *parent )
                         sclangExeEdit );
     sclangForm->addRow( new QLabel( i18n( "Runtime Directory:" ) ),
                         dataDirEdit );
+    sclangForm->addRow( new QLabel( i18n( "Evaluate via File Above:" ) ),
+                        evalFileSpin );
+    sclangForm->addRow( new QLabel( i18n( "Report Stall After:" ) ),
+                        stallTimeoutSpin );
 
     QVBoxLayout *sclangVBox = new QVBoxLayout();
     sclangVBox->addLayout( sclangForm );
     sclangVBox->addWidget( startLangCheck );
+    sclangVBox->addWidget( standbyCheck );
 
     QGroupBox *sclangGrp = new QGroupBox( "Sclang" );
     sclangGrp->setLayout( sclangVBox );
 
+    // Sessions group
+
+    sessionList = new ScateSessionListWidget();
+
+    QVBoxLayout *sessionVBox = new QVBoxLayout();
+    sessionVBox->addWidget( new QLabel( i18n( "Further interpreters, to which documents can "
+                                              "be bound to run side by side:" ) ) );
+    sessionVBox->addWidget( sessionList );
+
+    QGroupBox *sessionGrp = new QGroupBox( "Sessions" );
+    sessionGrp->setLayout( sessionVBox );
+
     // GUI group
 
     swingOscDirEdit = new QLineEdit();
@@ -79,6 +109,7 @@ ScateConfigPage::ScateConfigPage( ScatePlugin *plugin_, QWidget *parent )
 
   QVBoxLayout * progVBox = new QVBoxLayout();
   progVBox->addWidget( sclangGrp );
+  progVBox->addWidget( sessionGrp );
   progVBox->addWidget( guiGrp );
   progVBox->addStretch(1);
 
@@ -88,13 +119,38 @@ ScateConfigPage::ScateConfigPage( ScatePlugin *plugin_, QWidget *parent )
   // Terminal tab
 
   trmMaxRowSpin = new QSpinBox();
-  trmMaxRowSpin->setRange( 10, 1000 );
+  trmMaxRowSpin->setRange( 100, 100000000 );
+  trmMaxRowSpin->setSingleStep( 10000 );
+  trmMemorySpin = new QSpinBox();
+  trmMemorySpin->setRange( 1, 4096 );
+  trmMemorySpin->setSuffix( " MiB" );
+  trmFrameRateSpin = new QSpinBox();
+  trmFrameRateSpin->setRange( 0, 200 );
+  trmFrameRateSpin->setSuffix( " fps" );
+  trmFrameRateSpin->setSpecialValueText( "Unlimited" );
+  trmPauseRateSpin = new QSpinBox();
+  trmPauseRateSpin->setRange( 0, 10000000 );
+  trmPauseRateSpin->setSingleStep( 1000 );
+  trmPauseRateSpin->setSuffix( " lines/s" );
+  trmPauseRateSpin->setSpecialValueText( "Never" );
+  outBufferSpin = new QSpinBox();
+  outBufferSpin->setRange( 1, 1024 );
+  outBufferSpin->setSuffix( " MiB" );
+  outOverflowCombo = new QComboBox();
+  outOverflowCombo->addItem( i18n("Pause Interpreter") );
+  outOverflowCombo->addItem( i18n("Drop Oldest Output") );
+  outOverflowCombo->addItem( i18n("Spill to Disk") );
   trmFontCombo = new QFontComboBox();
   trmFontSizeSpin = new QSpinBox();
   trmFontSizeSpin->setRange( 1, 30 );
 
   QFormLayout *trmForm = new QFormLayout();
   trmForm->addRow( new QLabel("Maximum Rows:"), trmMaxRowSpin );
+  trmForm->addRow( new QLabel("Maximum Memory:"), trmMemorySpin );
+  trmForm->addRow( new QLabel("Refresh Rate:"), trmFrameRateSpin );
+  trmForm->addRow( new QLabel("Pause Display Above:"), trmPauseRateSpin );
+  trmForm->addRow( new QLabel("Output Buffer:"), outBufferSpin );
+  trmForm->addRow( new QLabel("When Buffer Is Full:"), outOverflowCombo );
 
   QHBoxLayout *trmFontHBox = new QHBoxLayout();
   trmFontHBox->setContentsMargins(0,0,0,0);
@@ -104,6 +160,17 @@ ScateConfigPage::ScateConfigPage( ScatePlugin *plugin_, QWidget *parent )
 
   trmForm->addRow( new QLabel("Font:"), trmFontHBox );
 
+  logCheck = new QCheckBox( i18n("Write output to log files") );
+  logSizeSpin = new QSpinBox();
+  logSizeSpin->setRange( 1, 1024 );
+  logSizeSpin->setSuffix( " MiB" );
+  logFilesSpin = new QSpinBox();
+  logFilesSpin->setRange( 1, 1000 );
+
+  trmForm->addRow( new QLabel("Post Log:"), logCheck );
+  trmForm->addRow( new QLabel("Log File Size:"), logSizeSpin );
+  trmForm->addRow( new QLabel("Log Files Kept:"), logFilesSpin );
+
   QWidget *trmTab = new QWidget();
   trmTab->setLayout( trmForm );
 
@@ -138,10 +205,22 @@ ScateConfigPage::ScateConfigPage( ScatePlugin *plugin_, QWidget *parent )
   connect( sclangExeEdit, SIGNAL(textChanged(QString)), this, SIGNAL(changed()) );
   connect( dataDirEdit, SIGNAL(textChanged(QString)), this, SIGNAL(changed()) );
   connect( startLangCheck, SIGNAL(stateChanged(int)), this, SIGNAL(changed()) );
+  connect( standbyCheck, SIGNAL(stateChanged(int)), this, SIGNAL(changed()) );
+  connect( evalFileSpin, SIGNAL(valueChanged(int)), this, SIGNAL(changed()) );
+  connect( stallTimeoutSpin, SIGNAL(valueChanged(int)), this, SIGNAL(changed()) );
   connect( swingOscDirEdit, SIGNAL(textChanged(QString)), this, SIGNAL(changed()) );
+  connect( sessionList, SIGNAL(changed()), this, SIGNAL(changed()) );
   connect( trmMaxRowSpin, SIGNAL(valueChanged(int)), this, SIGNAL(changed()) );
+  connect( trmMemorySpin, SIGNAL(valueChanged(int)), this, SIGNAL(changed()) );
+  connect( trmFrameRateSpin, SIGNAL(valueChanged(int)), this, SIGNAL(changed()) );
+  connect( trmPauseRateSpin, SIGNAL(valueChanged(int)), this, SIGNAL(changed()) );
+  connect( outBufferSpin, SIGNAL(valueChanged(int)), this, SIGNAL(changed()) );
+  connect( outOverflowCombo, SIGNAL(currentIndexChanged(int)), this, SIGNAL(changed()) );
   connect( trmFontCombo, SIGNAL(currentFontChanged(QFont)), this, SIGNAL(changed()) );
   connect( trmFontSizeSpin, SIGNAL(valueChanged(int)), this, SIGNAL(changed()) );
+  connect( logCheck, SIGNAL(stateChanged(int)), this, SIGNAL(changed()) );
+  connect( logSizeSpin, SIGNAL(valueChanged(int)), this, SIGNAL(changed()) );
+  connect( logFilesSpin, SIGNAL(valueChanged(int)), this, SIGNAL(changed()) );
   connect( helpDirList, SIGNAL(changed()), this, SIGNAL(changed()) );
   connect( helpFontScaleSpin, SIGNAL(valueChanged(double)), this, SIGNAL(changed()) );
 }
@@ -152,12 +231,24 @@ void ScateConfigPage::apply()
   config.writeEntry( "ScLangExecutable", sclangExeEdit->text() );
   config.writeEntry( "RuntimeDataDir", dataDirEdit->text() );
   config.writeEntry( "StartLang", startLangCheck->isChecked() );
+  config.writeEntry( "StandbyLang", standbyCheck->isChecked() );
+  config.writeEntry( "EvalFileThreshold", evalFileSpin->value() );
+  config.writeEntry( "StallTimeout", stallTimeoutSpin->value() );
   config.writeEntry( "SwingOscProgram", swingOscDirEdit->text() );
+  sessionList->write();
 
   config.writeEntry( "TerminalMaxRows", trmMaxRowSpin->value() );
+  config.writeEntry( "TerminalMemory", trmMemorySpin->value() );
+  config.writeEntry( "TerminalFrameRate", trmFrameRateSpin->value() );
+  config.writeEntry( "TerminalPauseRate", trmPauseRateSpin->value() );
+  config.writeEntry( "OutputBufferSize", outBufferSpin->value() );
+  config.writeEntry( "OutputOverflow", outOverflowCombo->currentIndex() );
   QFont trmFont = trmFontCombo->currentFont();
   trmFont.setPointSize( trmFontSizeSpin->value() );
   config.writeEntry( "TerminalFont", trmFont );
+  config.writeEntry( "PostLog", logCheck->isChecked() );
+  config.writeEntry( "PostLogFileSize", logSizeSpin->value() );
+  config.writeEntry( "PostLogFiles", logFilesSpin->value() );
 
   config.writePathEntry( "HelpDirs", helpDirList->dirs() );
   config.writeEntry( "HelpFontScale", helpFontScaleSpin->value() );
@@ -173,12 +264,24 @@ void ScateConfigPage::reset()
   sclangExeEdit->setText( config.readEntry( "ScLangExecutable", QString() ) );
   dataDirEdit->setText( config.readEntry( "RuntimeDataDir", QString() ) );
   startLangCheck->setChecked( config.readEntry( "StartLang", false ) );
+  standbyCheck->setChecked( config.readEntry( "StandbyLang", false ) );
+  evalFileSpin->setValue( config.readEntry( "EvalFileThreshold", 512 ) );
+  stallTimeoutSpin->setValue( config.readEntry( "StallTimeout", 5 ) );
   swingOscDirEdit->setText( config.readEntry( "SwingOscProgram", QString() ) );
-
-  trmMaxRowSpin->setValue( config.readEntry( "TerminalMaxRows", 500 ) );
+  sessionList->read();
+
+  trmMaxRowSpin->setValue( config.readEntry( "TerminalMaxRows", 1000000 ) );
+  trmMemorySpin->setValue( config.readEntry( "TerminalMemory", 64 ) );
+  trmFrameRateSpin->setValue( config.readEntry( "TerminalFrameRate", 60 ) );
+  trmPauseRateSpin->setValue( config.readEntry( "TerminalPauseRate", 20000 ) );
+  outBufferSpin->setValue( config.readEntry( "OutputBufferSize", 16 ) );
+  outOverflowCombo->setCurrentIndex( config.readEntry( "OutputOverflow", 0 ) );
   QFont trmFont = config.readEntry( "TerminalFont", QFont() );
   trmFontCombo->setCurrentFont( trmFont );
   trmFontSizeSpin->setValue( trmFont.pointSize() );
+  logCheck->setChecked( config.readEntry( "PostLog", true ) );
+  logSizeSpin->setValue( config.readEntry( "PostLogFileSize", 32 ) );
+  logFilesSpin->setValue( config.readEntry( "PostLogFiles", 10 ) );
 
   helpDirList->setDirs( config.readEntry( "HelpDirs", QStringList() ) );
   helpFontScaleSpin->setValue( config.readEntry( "HelpFontScale", 1.0 ) );
@@ -189,12 +292,24 @@ void ScateConfigPage::defaults()
   sclangExeEdit->clear();
   dataDirEdit->setText( QString() );
   startLangCheck->setChecked( false );
+  standbyCheck->setChecked( false );
+  evalFileSpin->setValue( 512 );
+  stallTimeoutSpin->setValue( 5 );
   swingOscDirEdit->clear();
-
-  trmMaxRowSpin->setValue(500);
+  sessionList->clear();
+
+  trmMaxRowSpin->setValue(1000000);
+  trmMemorySpin->setValue(64);
+  trmFrameRateSpin->setValue(60);
+  trmPauseRateSpin->setValue(20000);
+  outBufferSpin->setValue(16);
+  outOverflowCombo->setCurrentIndex(0);
   QFont defFont;
   trmFontCombo->setCurrentFont( defFont );
   trmFontSizeSpin->setValue( defFont.pointSize() );
+  logCheck->setChecked( true );
+  logSizeSpin->setValue(32);
+  logFilesSpin->setValue(10);
 
   helpDirList->setDirs( QStringList() );
   helpFontScaleSpin->setValue(1.0);
@@ -204,9 +319,19 @@ void ScateConfigPage::defaults()
   config.writeEntry( "RuntimeDataDir", QString() );
   config.writeEntry( "SwingOscProgram", QString() );
   config.writeEntry( "StartLang", false );
-
-  config.writeEntry( "TerminalMaxRows", 500 );
+  config.writeEntry( "EvalFileThreshold", 512 );
+  config.writeEntry( "StallTimeout", 5 );
+
+  config.writeEntry( "TerminalMaxRows", 1000000 );
+  config.writeEntry( "TerminalMemory", 64 );
+  config.writeEntry( "TerminalFrameRate", 60 );
+  config.writeEntry( "TerminalPauseRate", 20000 );
+  config.writeEntry( "OutputBufferSize", 16 );
+  config.writeEntry( "OutputOverflow", 0 );
   config.writeEntry( "TerminalFont", defFont );
+  config.writeEntry( "PostLog", true );
+  config.writeEntry( "PostLogFileSize", 32 );
+  config.writeEntry( "PostLogFiles", 10 );
 
   config.writePathEntry( "HelpDirs", QStringList() );
   config.writeEntry( "HelpFontScale", 1.0 );
@@ -278,3 +403,94 @@ QStringList ScateDirListWidget::dirs()
   return dirs;
 }
 
+
+ScateSessionListWidget::ScateSessionListWidget( QWidget *parent ) :
+  QWidget( parent )
+{
+  QHBoxLayout *l = new QHBoxLayout;
+  l->setContentsMargins(0,0,0,0);
+  l->setSpacing(0);
+
+  table = new QTableWidget( 0, 3 );
+  table->setHorizontalHeaderLabels( QStringList() << i18n("Name") << i18n("Command")
+                                                  << i18n("Runtime Directory") );
+  table->horizontalHeader()->setStretchLastSection( true );
+  table->verticalHeader()->hide();
+  table->setSelectionBehavior( QAbstractItemView::SelectRows );
+  table->setMaximumHeight( 100 );
+  l->addWidget( table );
+
+  QToolBar *tools = new QToolBar;
+  tools->setOrientation( Qt::Vertical );
+  tools->setIconSize( QSize(16,16) );
+  QAction *a;
+  a = tools->addAction( KIcon("list-add"), "Add" );
+  QObject::connect( a, SIGNAL(triggered()), this, SLOT(addSession()) );
+  a = tools->addAction( KIcon("list-remove"), "Remove" );
+  QObject::connect( a, SIGNAL(triggered()), this, SLOT(removeSession()) );
+  l->addWidget( tools );
+
+  setLayout( l );
+
+  connect( table, SIGNAL(itemChanged(QTableWidgetItem*)), this, SIGNAL(changed()) );
+}
+
+void ScateSessionListWidget::read()
+{
+  clear();
+  KConfigGroup config(KGlobal::config(), "Scate");
+  foreach( QString name, config.readEntry( "Sessions", QStringList() ) ) {
+    KConfigGroup session = ScateSettings::sessionGroup( name );
+    addRow( name, session.readEntry( "ScLangExecutable", QString() ),
+            session.readEntry( "RuntimeDataDir", QString() ) );
+  }
+}
+
+void ScateSessionListWidget::write()
+{
+  QStringList names;
+  for( int row = 0; row < table->rowCount(); ++row ) {
+    QString name = table->item( row, 0 )->text().trimmed();
+    if( name.isEmpty() || name == ScateSession::defaultName() || names.contains( name ) )
+      continue;
+    names << name;
+    KConfigGroup session = ScateSettings::sessionGroup( name );
+    session.writeEntry( "ScLangExecutable", table->item( row, 1 )->text() );
+    session.writeEntry( "RuntimeDataDir", table->item( row, 2 )->text() );
+  }
+  KConfigGroup config(KGlobal::config(), "Scate");
+  config.writeEntry( "Sessions", names );
+}
+
+void ScateSessionListWidget::clear()
+{
+  table->setRowCount( 0 );
+}
+
+void ScateSessionListWidget::addRow( const QString &name, const QString &command,
+                                     const QString &dataDir )
+{
+  int row = table->rowCount();
+  table->insertRow( row );
+  table->setItem( row, 0, new QTableWidgetItem( name ) );
+  table->setItem( row, 1, new QTableWidgetItem( command ) );
+  table->setItem( row, 2, new QTableWidgetItem( dataDir ) );
+}
+
+void ScateSessionListWidget::addSession()
+{
+  addRow( QString("Session %1").arg( table->rowCount() + 1 ), QString(), QString() );
+  int row = table->rowCount() - 1;
+  table->setCurrentCell( row, 0 );
+  table->editItem( table->item( row, 0 ) );
+  emit changed();
+}
+
+void ScateSessionListWidget::removeSession()
+{
+  int row = table->currentRow();
+  if( row >= 0 ) {
+    table->removeRow( row );
+    emit changed();
+  }
+}
@@ -27,12 +27,15 @@
 #include <QLineEdit>
 #include <QCheckBox>
 #include <QListWidget>
+#include <QTableWidget>
 #include <QFontComboBox>
 #include <QSpinBox>
+#include <QComboBox>
 #include <QDoubleSpinBox>
 
 class ScatePlugin;
 class ScateDirListWidget;
+class ScateSessionListWidget;
 
 class ScateConfigPage : public Kate::PluginConfigPage
 {
@@ -47,11 +50,23 @@ class ScateConfigPage : public Kate::PluginConfigPage
     QLineEdit *sclangExeEdit;
     QLineEdit *dataDirEdit;
     QCheckBox *startLangCheck;
+    QCheckBox *standbyCheck;
+    QSpinBox *evalFileSpin;
+    QSpinBox *stallTimeoutSpin;
     QLineEdit *swingOscDirEdit;
+    ScateSessionListWidget *sessionList;
 
     QSpinBox *trmMaxRowSpin;
+    QSpinBox *trmMemorySpin;
+    QSpinBox *trmFrameRateSpin;
     QFontComboBox *trmFontCombo;
     QSpinBox *trmFontSizeSpin;
+    QSpinBox *trmPauseRateSpin;
+    QSpinBox *outBufferSpin;
+    QComboBox *outOverflowCombo;
+    QCheckBox *logCheck;
+    QSpinBox *logSizeSpin;
+    QSpinBox *logFilesSpin;
 
     ScateDirListWidget *helpDirList;
     QDoubleSpinBox *helpFontScaleSpin;
@@ -74,4 +89,25 @@ class ScateDirListWidget : public QWidget
     QListWidget *list;
 };
 
+// The interpreter sessions besides the default one, each with a name,
+// command and runtime directory.
+
+class ScateSessionListWidget : public QWidget
+{
+  Q_OBJECT
+  public:
+    ScateSessionListWidget( QWidget *parent = 0 );
+    void read();
+    void write();
+    void clear();
+  signals:
+    void changed();
+  public slots:
+    void addSession();
+    void removeSession();
+  private:
+    void addRow( const QString &name, const QString &command, const QString &dataDir );
+    QTableWidget *table;
+};
+
 #endif //SCATE_CONFIG_H
@@ -0,0 +1,98 @@
+/*
+#
+# Copyright 2010-2011 Jakob Leben (jakob.leben@gmail.com)
+#
+# This file is part of Scate - a SuperCollider plugin for Kate
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+*/
+
+#include "ScateEvalFiles.hpp"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QElapsedTimer>
+
+#include <unistd.h>
+#include <stdlib.h>
+#include <errno.h>
+
+ScateEvalFiles::ScateEvalFiles() :
+  writes( 0 ),
+  time( 0 )
+{}
+
+ScateEvalFiles::~ScateEvalFiles()
+{
+  clear();
+}
+
+QString ScateEvalFiles::directory()
+{
+  // prefer tmpfs, so that the code never hits the disk
+  QFileInfo shm( "/dev/shm" );
+  if( shm.isDir() && shm.isWritable() ) return shm.filePath();
+  return QDir::tempPath();
+}
+
+QString ScateEvalFiles::write( const QByteArray &code )
+{
+  QElapsedTimer timer;
+  timer.start();
+
+  QByteArray path = QFile::encodeName( directory() + "/scate-eval-XXXXXX" );
+  int fd = ::mkstemp( path.data() );
+  if( fd == -1 ) return QString();
+
+  const char *data = code.constData();
+  qint64 left = code.size();
+  while( left > 0 ) {
+    ssize_t n = ::write( fd, data, left );
+    if( n == -1 ) {
+      if( errno == EINTR ) continue;
+      ::close( fd );
+      ::unlink( path.constData() );
+      return QString();
+    }
+    data += n;
+    left -= n;
+  }
+  ::close( fd );
+
+  ++writes;
+  time += timer.nsecsElapsed();
+  return QFile::decodeName( path );
+}
+
+QString ScateEvalFiles::command( const QString &fileName )
+{
+  QString literal = fileName;
+  literal.replace( "\\", "\\\\" ).replace( "\"", "\\\"" );
+  return QString("thisProcess.interpreter.executeFile(\"%1\")").arg( literal );
+}
+
+void ScateEvalFiles::release( int id )
+{
+  QString fileName = files.take( id );
+  if( !fileName.isEmpty() ) QFile::remove( fileName );
+}
+
+void ScateEvalFiles::clear()
+{
+  foreach( const QString &fileName, files )
+    QFile::remove( fileName );
+  files.clear();
+}
@@ -0,0 +1,63 @@
+/*
+#
+# Copyright 2010-2011 Jakob Leben (jakob.leben@gmail.com)
+#
+# This file is part of Scate - a SuperCollider plugin for Kate
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+*/
+
+#ifndef SCATE_EVAL_FILES_H
+#define SCATE_EVAL_FILES_H
+
+#include <QHash>
+#include <QString>
+#include <QByteArray>
+
+// Temporary files holding code too large to be sent through the
+// interpreter's input, which is instead told to execute the file.
+// Files are kept in memory-backed storage where available, and removed
+// once the evaluation is over.
+
+class ScateEvalFiles
+{
+  public:
+    ScateEvalFiles();
+    ~ScateEvalFiles();
+
+    // Writes the code to a new file and returns its name, or an empty
+    // string on failure.
+    QString write( const QByteArray &code );
+    // The code that evaluates a file.
+    static QString command( const QString &fileName );
+    // Associates a file with an evaluation, to be removed when it is over.
+    inline void track( int id, const QString &fileName ) { files.insert( id, fileName ); }
+    // Removes the file of an evaluation.
+    void release( int id );
+    void clear();
+
+    inline int count() const { return files.count(); }
+    inline quint64 writeCount() const { return writes; }
+    // nanoseconds spent writing files
+    inline qint64 writeTime() const { return time; }
+
+  private:
+    static QString directory();
+    QHash<int, QString> files;
+    quint64 writes;
+    qint64 time;
+};
+
+#endif // SCATE_EVAL_FILES_H
@@ -0,0 +1,116 @@
+/*
+#
+# Copyright 2010-2011 Jakob Leben (jakob.leben@gmail.com)
+#
+# This file is part of Scate - a SuperCollider plugin for Kate
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+*/
+
+#include "ScateEvalQueue.hpp"
+
+#include <QIODevice>
+
+static const int chunkSize = 64 * 1024;
+// how much may wait in the device's write buffer
+static const int maxBuffered = 128 * 1024;
+
+ScateEvalQueue::ScateEvalQueue( QIODevice *device_, QObject *parent ) :
+  QObject( parent ),
+  device( device_ ),
+  queued( 0 )
+{
+  connect( device, SIGNAL(bytesWritten(qint64)), this, SLOT(pump()) );
+}
+
+void ScateEvalQueue::setDevice( QIODevice *device_ )
+{
+  if( device_ == device ) return;
+  clear();
+  disconnect( device, 0, this, 0 );
+  device = device_;
+  connect( device, SIGNAL(bytesWritten(qint64)), this, SLOT(pump()) );
+}
+
+void ScateEvalQueue::enqueue( const QByteArray &data, int id )
+{
+  if( data.isEmpty() ) return;
+  queue.enqueue( Entry( data, id ) );
+  queued += data.size();
+  pump();
+  emit changed();
+}
+
+qint64 ScateEvalQueue::bytesInFlight() const
+{
+  return device->bytesToWrite();
+}
+
+int ScateEvalQueue::cancellableCount() const
+{
+  int count = 0;
+  foreach( const Entry &e, queue )
+    if( e.offset == 0 && e.id != 0 ) ++count;
+  return count;
+}
+
+void ScateEvalQueue::pump()
+{
+  bool progress = false;
+  while( !queue.isEmpty() && device->bytesToWrite() < maxBuffered ) {
+    Entry &e = queue.head();
+    int size = qMin( chunkSize, e.data.size() - e.offset );
+    qint64 written = device->write( e.data.constData() + e.offset, size );
+    if( written <= 0 ) break;
+    e.offset += written;
+    queued -= written;
+    _stats.bytesSent += written;
+    progress = true;
+    if( e.offset == e.data.size() ) {
+      queue.dequeue();
+      ++_stats.sent;
+    }
+  }
+  if( progress ) emit changed();
+}
+
+void ScateEvalQueue::cancelPending()
+{
+  QList<int> ids;
+  QQueue<Entry> kept;
+  foreach( const Entry &e, queue ) {
+    if( e.offset > 0 || e.id == 0 )
+      kept.enqueue( e );
+    else {
+      queued -= e.data.size();
+      ids.append( e.id );
+    }
+  }
+  if( ids.isEmpty() ) return;
+  queue = kept;
+  _stats.cancelled += ids.count();
+  foreach( int id, ids ) emit cancelled( id );
+  emit changed();
+}
+
+void ScateEvalQueue::clear()
+{
+  if( queue.isEmpty() ) return;
+  foreach( const Entry &e, queue )
+    if( e.offset == 0 ) emit cancelled( e.id );
+  queue.clear();
+  queued = 0;
+  emit changed();
+}
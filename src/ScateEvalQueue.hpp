@@ -0,0 +1,95 @@
+/*
+#
+# Copyright 2010-2011 Jakob Leben (jakob.leben@gmail.com)
+#
+# This file is part of Scate - a SuperCollider plugin for Kate
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+*/
+
+#ifndef SCATE_EVAL_QUEUE_H
+#define SCATE_EVAL_QUEUE_H
+
+#include <QObject>
+#include <QQueue>
+#include <QByteArray>
+
+class QIODevice;
+
+// Writes evaluations to the interpreter in the order they are queued.
+// Data is handed to the device in chunks, only as fast as the device gets
+// rid of it, so a huge evaluation does not end up in the device's write
+// buffer all at once. Queued evaluations that have not started to be sent
+// can be cancelled.
+
+class ScateEvalQueue : public QObject
+{
+  Q_OBJECT
+  public:
+    struct Stats {
+      Stats() : sent(0), cancelled(0), bytesSent(0) {}
+      quint64 sent;
+      quint64 cancelled;
+      quint64 bytesSent;
+    };
+
+    ScateEvalQueue( QIODevice *device, QObject *parent = 0 );
+    // Sends to another device from now on, e.g. a new interpreter process.
+    // Whatever is queued is forgotten.
+    void setDevice( QIODevice * );
+    // 'id' is passed back when the evaluation is cancelled. Data without an
+    // id is a command of the session itself, e.g. a heartbeat probe, which
+    // the session waits for and which therefore can not be cancelled.
+    void enqueue( const QByteArray &data, int id = 0 );
+
+    // number of evaluations not completely handed to the device
+    inline int depth() const { return queue.count(); }
+    // bytes not yet handed to the device
+    inline qint64 queuedBytes() const { return queued; }
+    // bytes handed to the device but not yet written
+    qint64 bytesInFlight() const;
+    // number of evaluations that can still be cancelled
+    int cancellableCount() const;
+    inline const Stats &stats() const { return _stats; }
+
+  public slots:
+    // Cancels all evaluations that have not started to be sent, but not the
+    // commands of the session.
+    void cancelPending();
+    // Forgets everything, e.g. when the interpreter has stopped.
+    void clear();
+
+  signals:
+    void cancelled( int id );
+    void changed();
+
+  private slots:
+    void pump();
+
+  private:
+    struct Entry {
+      Entry( const QByteArray &d = QByteArray(), int i = 0 ) : data( d ), id( i ), offset( 0 ) {}
+      QByteArray data;
+      int id;
+      int offset;
+    };
+
+    QIODevice *device;
+    QQueue<Entry> queue;
+    qint64 queued;
+    Stats _stats;
+};
+
+#endif // SCATE_EVAL_QUEUE_H
@@ -0,0 +1,125 @@
+/*
+#
+# Copyright 2010-2011 Jakob Leben (jakob.leben@gmail.com)
+#
+# This file is part of Scate - a SuperCollider plugin for Kate
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+*/
+
+#include "ScateEvalTracker.hpp"
+
+#include <QtAlgorithms>
+
+#include <time.h>
+
+ScateEvalTracker::ScateEvalTracker( int window_ ) :
+  window( qMax( 1, window_ ) ),
+  next( 0 ),
+  nextId( 1 ),
+  total( 0 )
+{}
+
+qint64 ScateEvalTracker::now()
+{
+  struct timespec ts;
+  ::clock_gettime( CLOCK_MONOTONIC, &ts );
+  return qint64( ts.tv_sec ) * 1000000000 + ts.tv_nsec;
+}
+
+QString ScateEvalTracker::formatLatency( qint64 nsecs )
+{
+  double ms = nsecs / 1000000.0;
+  if( ms < 10 ) return QString("%1 ms").arg( ms, 0, 'f', 2 );
+  if( ms < 1000 ) return QString("%1 ms").arg( qRound( ms ) );
+  return QString("%1 s").arg( ms / 1000, 0, 'f', 1 );
+}
+
+QString ScateEvalTracker::command( int id )
+{
+  return QString("\"@@scate:ack:%1;\".postln;").arg( id );
+}
+
+int ScateEvalTracker::begin( Route route, int bytes )
+{
+  int id = nextId++;
+  if( nextId <= 0 ) nextId = 1;
+  pending.insert( id, Pending( now(), route, bytes ) );
+  return id;
+}
+
+qint64 ScateEvalTracker::finish( const ScateEvalAck &ack )
+{
+  QHash<int, Pending>::iterator it = pending.find( ack.id );
+  if( it == pending.end() ) return -1;
+  qint64 latency = qMax( qint64(0), ack.time - it->time );
+  RouteStats &route = routes[ it->route ];
+  ++route.count;
+  route.bytes += it->bytes;
+  route.latency += latency;
+  pending.erase( it );
+
+  if( samples.count() < window )
+    samples.append( latency );
+  else
+    samples[next] = latency;
+  next = ( next + 1 ) % window;
+  ++total;
+  return latency;
+}
+
+void ScateEvalTracker::reset()
+{
+  pending.clear();
+}
+
+qint64 ScateEvalTracker::percentile( double p ) const
+{
+  if( samples.isEmpty() ) return 0;
+  QVector<qint64> sorted = samples;
+  qSort( sorted );
+  int i = qBound( 0, int( p * sorted.count() + 0.5 ) - 1, sorted.count() - 1 );
+  return sorted[i];
+}
+
+QString ScateEvalTracker::histogram() const
+{
+  // bucket limits in milliseconds
+  static const int limits[] = { 1, 2, 5, 10, 20, 50, 100, 200, 500, 1000 };
+  static const int bucketCount = sizeof(limits) / sizeof(limits[0]) + 1;
+  static const int barWidth = 30;
+
+  int counts[bucketCount] = { 0 };
+  foreach( qint64 latency, samples ) {
+    int b = 0;
+    while( b < bucketCount - 1 && latency >= limits[b] * qint64(1000000) ) ++b;
+    ++counts[b];
+  }
+  int most = 1;
+  for( int b = 0; b < bucketCount; ++b ) most = qMax( most, counts[b] );
+
+  QString text;
+  for( int b = 0; b < bucketCount; ++b ) {
+    QString label = b == 0 ? QString("< %1 ms").arg( limits[0] )
+      : b == bucketCount - 1 ? QString(">= %1 ms").arg( limits[b-1] )
+      : QString("%1-%2 ms").arg( limits[b-1] ).arg( limits[b] );
+    int bar = ( counts[b] * barWidth + most - 1 ) / most;
+    text += QString("  %1 %2 %3\n")
+      .arg( label, -12 )
+      .arg( QString( bar, '#' ), -barWidth )
+      .arg( counts[b] );
+  }
+  return text;
+}
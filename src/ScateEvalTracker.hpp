@@ -0,0 +1,99 @@
+/*
+#
+# Copyright 2010-2011 Jakob Leben (jakob.leben@gmail.com)
+#
+# This file is part of Scate - a SuperCollider plugin for Kate
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+*/
+
+#ifndef SCATE_EVAL_TRACKER_H
+#define SCATE_EVAL_TRACKER_H
+
+#include "ScatePost.hpp"
+
+#include <QHash>
+#include <QVector>
+#include <QString>
+
+// Measures how long the interpreter takes to answer evaluations.
+// Every evaluation is followed by a silent one that posts an
+// acknowledgement carrying its id (see command()); ScatePostReader takes the
+// acknowledgement out of the output and stamps it with its time of arrival.
+// The latencies of the most recent evaluations are kept for statistics.
+
+class ScateEvalTracker
+{
+  public:
+    // how the code of an evaluation was sent
+    enum Route {
+      Pipe,
+      File,
+      RouteCount
+    };
+
+    struct RouteStats {
+      RouteStats() : count(0), bytes(0), latency(0) {}
+      quint64 count;
+      quint64 bytes;
+      // sum of latencies, in nanoseconds
+      qint64 latency;
+    };
+
+    ScateEvalTracker( int window = 1000 );
+
+    // Nanoseconds on a monotonic clock.
+    static qint64 now();
+    static QString formatLatency( qint64 nsecs );
+
+    // Registers an evaluation sent now and returns its id.
+    int begin( Route route = Pipe, int bytes = 0 );
+    // The code to evaluate after an evaluation, to acknowledge it.
+    static QString command( int id );
+    // Returns the latency of an acknowledged evaluation, or -1 if the
+    // evaluation is unknown.
+    qint64 finish( const ScateEvalAck & );
+    // Forgets an evaluation that was never sent.
+    inline void cancel( int id ) { pending.remove( id ); }
+    // Forgets evaluations that will never be acknowledged.
+    void reset();
+
+    inline int pendingCount() const { return pending.count(); }
+    inline int sampleCount() const { return samples.count(); }
+    inline quint64 totalCount() const { return total; }
+    // 'p' between 0 and 1
+    qint64 percentile( double p ) const;
+    // A text histogram of the recent latencies.
+    QString histogram() const;
+    inline const RouteStats &routeStats( Route r ) const { return routes[r]; }
+
+  private:
+    struct Pending {
+      Pending( qint64 t = 0, Route r = Pipe, int b = 0 ) : time( t ), route( r ), bytes( b ) {}
+      qint64 time;
+      Route route;
+      int bytes;
+    };
+
+    QHash<int, Pending> pending;
+    RouteStats routes[RouteCount];
+    QVector<qint64> samples;
+    int window;
+    int next;
+    int nextId;
+    quint64 total;
+};
+
+#endif // SCATE_EVAL_TRACKER_H
@@ -21,34 +21,49 @@
 
 #include "ScateHelpBrowser.hpp"
 #include "ScatePlugin.hpp"
+#include "ScateSettings.hpp"
+#include "ScateHelpIndex.hpp"
+#include "ScateHelpSearch.hpp"
+#include "ScateHelpRenderer.hpp"
+#include "ScateHelpBundle.hpp"
 
 #include <kaction.h>
 #include <kactioncollection.h>
-#include <kconfiggroup.h>
 
 #include <QVBoxLayout>
 #include <QToolBar>
 #include <QPushButton>
 #include <QLabel>
 #include <QWebView>
+#include <QWebSecurityOrigin>
+#include <QTreeWidget>
+#include <QHeaderView>
+#include <QSplitter>
+#include <QFileInfo>
 #include <QDir>
-#include <QDirIterator>
 #include <QMessageBox>
 #include <QDebug>
-#include <QApplication>
 #include <QShortcut>
 #include <QKeyEvent>
+#include <QCompleter>
+#include <QStringListModel>
 
 
 ScateHelpBrowser::ScateHelpBrowser( ScatePlugin *plugin, QWidget *parent )
-: QWidget( parent ), findBar(0), virgin( true )
+: QWidget( parent ), settings( plugin->settings() ), index( plugin->helpIndex() ),
+  search( plugin->helpSearch() ), renderer( plugin->helpRenderer() ),
+  bundle( plugin->helpBundle() ), findBar(0), virgin( true )
 {
-  KConfigGroup config(KGlobal::config(), "Scate");
-
   webView = new QWebView();
-  webView->setTextSizeMultiplier( config.readEntry( "HelpFontScale", 1.0 ) );
+  webView->setTextSizeMultiplier( settings->helpFontScale() );
+  // links to .schelp sources are followed by rendering them
+  webView->page()->setLinkDelegationPolicy( QWebPage::DelegateAllLinks );
+  // pages of the help bundle may link to loose files, e.g. rendered pages
+  QWebSecurityOrigin::addLocalScheme( ScateHelpBundle::scheme() );
+  webView->page()->setNetworkAccessManager( new ScateHelpNetworkManager( bundle, this ) );
 
-  ScateHelpSearchBar *searchBar = new ScateHelpSearchBar();
+  searchBar = new ScateHelpSearchBar();
+  if( search->isReady() ) searchBar->setCompletions( search->symbols() );
 
   QToolBar *toolBar = new QToolBar;
 
@@ -58,11 +73,31 @@ ScateHelpBrowser::ScateHelpBrowser( ScatePlugin *plugin, QWidget *parent )
   toolBar->addAction( webView->pageAction( QWebPage::Forward ) );
   toolBar->addWidget( searchBar );
 
+  resultStatus = new QLabel();
+  resultList = new QTreeWidget();
+  resultList->setHeaderLabels( QStringList() << tr("Title") << tr("File") );
+  resultList->setRootIsDecorated( false );
+  resultList->setUniformRowHeights( true );
+  resultList->header()->setResizeMode( 0, QHeaderView::Stretch );
+
+  resultPane = new QWidget();
+  QVBoxLayout *resultLayout = new QVBoxLayout( resultPane );
+  resultLayout->setContentsMargins(0,0,0,0);
+  resultLayout->setSpacing(2);
+  resultLayout->addWidget( resultStatus );
+  resultLayout->addWidget( resultList );
+  resultPane->hide();
+
+  QSplitter *splitter = new QSplitter( Qt::Vertical );
+  splitter->addWidget( resultPane );
+  splitter->addWidget( webView );
+  splitter->setStretchFactor( 1, 3 );
+
   QVBoxLayout *l = new QVBoxLayout();
   l->setContentsMargins(0,0,0,0);
   l->setSpacing(2);
   l->addWidget( toolBar );
-  l->addWidget( webView );
+  l->addWidget( splitter );
 
   setLayout(l);
 
@@ -78,13 +113,17 @@ ScateHelpBrowser::ScateHelpBrowser( ScatePlugin *plugin, QWidget *parent )
            this, SLOT(searchHelp(const QString&)) );
   connect( copyShortcut, SIGNAL(activated()),
            webView->pageAction( QWebPage::Copy ), SLOT(trigger()) );
-  connect( plugin, SIGNAL(configChanged()), this, SLOT(applyConfig()) );
+  connect( settings, SIGNAL(helpFontScaleChanged()), this, SLOT(applyFontScale()) );
+  connect( index, SIGNAL(updated()), this, SLOT(onIndexUpdated()) );
+  connect( search, SIGNAL(updated()), this, SLOT(onSearchUpdated()) );
+  connect( webView, SIGNAL(linkClicked(const QUrl&)), this, SLOT(openUrl(const QUrl&)) );
+  connect( resultList, SIGNAL(itemActivated(QTreeWidgetItem*, int)),
+           this, SLOT(openResult(QTreeWidgetItem*)) );
 }
 
-void ScateHelpBrowser::applyConfig()
+void ScateHelpBrowser::applyFontScale()
 {
-  KConfigGroup config(KGlobal::config(), "Scate");
-  webView->setTextSizeMultiplier( config.readEntry( "HelpFontScale", 1.0 ) );
+  webView->setTextSizeMultiplier( settings->helpFontScale() );
 }
 
 void ScateHelpBrowser::findText( const QString& str, QWebPage::FindFlags flags )
@@ -94,8 +133,7 @@ void ScateHelpBrowser::findText( const QString& str, QWebPage::FindFlags flags )
 
 void ScateHelpBrowser::goHome()
 {
-  KConfigGroup config(KGlobal::config(), "Scate");
-  QStringList helpDirs = config.readPathEntry( "HelpDirs", QStringList() );
+  const QStringList &helpDirs = settings->helpDirs();
 
   if( !helpDirs.count() ) {
     warnSetHelpDir();
@@ -105,8 +143,11 @@ void ScateHelpBrowser::goHome()
   foreach( QString dirName, helpDirs ) {
     QDir dir(dirName);
     if( dir.exists("Help.html") ) {
-      QUrl helpUrl( dir.absoluteFilePath("Help.html") );
-      webView->load( helpUrl );
+      openFile( dir.absoluteFilePath("Help.html") );
+      return;
+    }
+    if( dir.exists("Help.schelp") ) {
+      openFile( dir.absoluteFilePath("Help.schelp") );
       return;
     }
   }
@@ -134,79 +175,129 @@ void ScateHelpBrowser::newTextSearch()
 
 bool ScateHelpBrowser::findHelpFor( const QString & className )
 {
-
-  KConfigGroup config(KGlobal::config(), "Scate");
-  QStringList helpDirNames = config.readPathEntry( "HelpDirs", QStringList() );
+  const QStringList &helpDirNames = settings->helpDirs();
 
   if( !helpDirNames.count() ) {
     warnSetHelpDir();
     return false;
   }
 
-  QStringList filters;
-  filters << ( className + ".html" );
-
-  QUrl url;
-
-  foreach( QString helpDirName, helpDirNames ) {
-    qDebug() << tr("searching for help in: %1").arg(helpDirName);
-    QDir helpDir( helpDirName );
-    helpDir.setNameFilters( filters );
-
-    QDirIterator iter( helpDir, QDirIterator::Subdirectories );
-    if( iter.hasNext() ) {
-      QString result = iter.next();
-      qDebug() << tr("help search result: %1").arg( result );
-      url = QUrl( iter.filePath() );
-      break;
-    }
-    QApplication::processEvents();
+  if( !index->isReady() ) {
+    pendingLookup = className;
+    return true;
   }
 
-  if( url.isEmpty() ) {
+  QString path = index->find( className + ".html" );
+  if( path.isEmpty() ) path = index->find( className + ".schelp" );
+  qDebug() << tr("help search result: %1").arg( path );
+
+  if( path.isEmpty() ) {
     QString msg = tr("No help file for '%1' found.").arg( className );
     QMessageBox::information( this, "SuperCollider Help", msg );
     return false;
   }
   else {
-    webView->load( url );
+    openFile( path );
     return true;
   }
 }
 
 void ScateHelpBrowser::searchHelp( const QString & searchTerm )
 {
-  KConfigGroup config(KGlobal::config(), "Scate");
-  QStringList helpDirNames = config.readPathEntry( "HelpDirs", QStringList() );
-
-  if( !helpDirNames.count() ) {
+  if( !settings->helpDirs().count() ) {
     warnSetHelpDir();
     return;
   }
 
-  QString searchFileName;
+  resultList->clear();
+  resultPane->show();
 
-  foreach( QString helpDirName, helpDirNames ) {
-    QDir dir( helpDirName );
-    QString fileName = dir.filePath("Search.html");
-    if( !QFile::exists( fileName ) ) continue;
-    searchFileName = fileName;
-    break;
+  if( !search->isReady() ) {
+    pendingSearch = searchTerm;
+    resultStatus->setText( tr("Indexing help files...") );
+    return;
   }
 
-  if( searchFileName.isEmpty() ) {
-#if 0
-    // FIXME: re-enable when SCDoc is merged into main SC
-    QString msg( "Could not find the SCDoc search page in the given help directories." );
-    QMessageBox::warning( this, "SuperCollider Help Search", msg );
-#endif
-    findHelpFor( searchTerm );
-    return;
+  QList<ScateHelpSearch::Result> results = search->search( searchTerm );
+  foreach( const ScateHelpSearch::Result &result, results ) {
+    QTreeWidgetItem *item = new QTreeWidgetItem( resultList );
+    item->setText( 0, result.title );
+    item->setText( 1, QFileInfo( result.path ).fileName() );
+    item->setToolTip( 1, result.path );
+    item->setData( 0, Qt::UserRole, result.path );
   }
 
-  QUrl url( QUrl::fromLocalFile(searchFileName) );
-  url.setFragment(searchTerm);
-  webView->load(url);
+  if( results.isEmpty() )
+    resultStatus->setText( tr("No help found for '%1'.").arg( searchTerm ) );
+  else
+    resultStatus->setText( tr("%n help file(s) found for '%1'.", "", results.count() )
+                           .arg( searchTerm ) );
+
+  // a class name leads right to its help
+  QString name = searchTerm.trimmed();
+  if( name.contains( QChar(' ') ) ) return;
+  QString path = index->find( name + ".html" );
+  if( path.isEmpty() ) path = index->find( name + ".schelp" );
+  if( !path.isEmpty() ) openFile( path );
+}
+
+void ScateHelpBrowser::onSearchUpdated()
+{
+  searchBar->setCompletions( search->symbols() );
+  if( pendingSearch.isEmpty() ) return;
+  QString searchTerm = pendingSearch;
+  pendingSearch.clear();
+  searchHelp( searchTerm );
+}
+
+void ScateHelpBrowser::openResult( QTreeWidgetItem *item )
+{
+  openFile( item->data( 0, Qt::UserRole ).toString() );
+}
+
+void ScateHelpBrowser::openFile( const QString &path, const QString &fragment )
+{
+  QUrl url;
+  if( ScateHelpRenderer::isSource( path ) ) {
+    url = renderer->page( path );
+    if( url.isEmpty() ) {
+      QString msg = tr("Could not render the help file '%1'.").arg( path );
+      QMessageBox::warning( this, "SuperCollider Help", msg );
+      return;
+    }
+  }
+  else {
+    // served from the help bundle if it was packed from the help directories
+    if( bundle->covers( settings->helpDirs() ) ) url = bundle->url( path );
+    if( url.isEmpty() ) url = QUrl::fromLocalFile( path );
+  }
+  if( !fragment.isEmpty() ) url.setFragment( fragment );
+  webView->load( url );
+}
+
+void ScateHelpBrowser::openUrl( const QUrl &url )
+{
+  if( url.scheme() == ScateHelpRenderer::linkScheme() ) {
+    QString target = renderer->linkUrl( url.path() );
+    if( target.isEmpty() ) {
+      QString msg = tr("No help file found for '%1'.").arg( url.path() );
+      QMessageBox::information( this, "SuperCollider Help", msg );
+      return;
+    }
+    openFile( QUrl( target ).toLocalFile(), url.fragment() );
+  }
+  else if( url.scheme() == "file" )
+    openFile( url.toLocalFile(), url.fragment() );
+  else
+    webView->load( url );
+}
+
+void ScateHelpBrowser::onIndexUpdated()
+{
+  if( pendingLookup.isEmpty() ) return;
+  QString className = pendingLookup;
+  pendingLookup.clear();
+  findHelpFor( className );
 }
 
 void ScateHelpBrowser::warnSetHelpDir()
@@ -255,8 +346,23 @@ ScateHelpSearchBar::ScateHelpSearchBar()
 
   setLayout(l);
 
+  // the model is sorted, so that the completer finds the names beginning
+  // with what is typed by binary search
+  completions = new QStringListModel( this );
+  completer = new QCompleter( completions, this );
+  completer->setCaseSensitivity( Qt::CaseInsensitive );
+  completer->setModelSorting( QCompleter::CaseInsensitivelySortedModel );
+  completer->setMaxVisibleItems( 12 );
+  searchField->setCompleter( completer );
+
   connect( findBtn, SIGNAL(clicked()), this, SLOT(search()) );
   connect( searchField, SIGNAL(returnPressed()), this, SLOT(search()) );
+  connect( completer, SIGNAL(activated(const QString&)), this, SLOT(search()) );
+}
+
+void ScateHelpSearchBar::setCompletions( const QStringList &names )
+{
+  completions->setStringList( names );
 }
 
 void ScateHelpSearchBar::search()
@@ -30,6 +30,17 @@
 class QWebView;
 class ScateFindBar;
 class ScatePlugin;
+class ScateSettings;
+class ScateHelpIndex;
+class ScateHelpSearch;
+class ScateHelpRenderer;
+class ScateHelpBundle;
+class QTreeWidget;
+class QTreeWidgetItem;
+class QLabel;
+class QCompleter;
+class QStringListModel;
+class ScateHelpSearchBar;
 
 class ScateHelpBrowser : public QWidget
 {
@@ -39,18 +50,42 @@ class ScateHelpBrowser : public QWidget
     inline bool webViewFocused() { return webView->hasFocus(); }
     inline QString selectedText() { return webView->selectedText(); }
   public slots:
-    void applyConfig();
+    void applyFontScale();
     void goHome();
     void newTextSearch();
-    // NOTE: findHelpFor( class ) is used as a fallback in case SCDoc's
-    // search page (Search.html) is not found in help dirs
+    // Shows the help file named after the class.
     bool findHelpFor( const QString & className );
+    // Lists the help files matching the search term, and shows the help
+    // file named after it, if any.
     void searchHelp( const QString & searchTerm );
     void findText( const QString&, QWebPage::FindFlags );
+  private slots:
+    void onIndexUpdated();
+    void onSearchUpdated();
+    void openResult( QTreeWidgetItem * );
+    // Follows a link, rendering .schelp sources and serving local files
+    // from the help bundle.
+    void openUrl( const QUrl & );
   private:
+    // Shows a help file, rendering .schelp sources and serving others from
+    // the help bundle.
+    void openFile( const QString &path, const QString &fragment = QString() );
     void warnSetHelpDir();
     void showEvent( QShowEvent *e );
     bool event( QEvent *e );
+    ScateSettings *settings;
+    ScateHelpIndex *index;
+    // class whose help is shown once the index is built
+    QString pendingLookup;
+    ScateHelpSearch *search;
+    ScateHelpRenderer *renderer;
+    ScateHelpBundle *bundle;
+    // search shown once the search index is built
+    QString pendingSearch;
+    ScateHelpSearchBar *searchBar;
+    QWidget *resultPane;
+    QLabel *resultStatus;
+    QTreeWidget *resultList;
     QWebView *webView;
     ScateFindBar *findBar;
     bool virgin;
@@ -61,12 +96,16 @@ class ScateHelpSearchBar : public QWidget
   Q_OBJECT
   public:
     ScateHelpSearchBar();
+    // Names completed as they are typed; must be sorted ignoring case.
+    void setCompletions( const QStringList & );
   signals:
     void searchedFor( const QString &text );
   private slots:
     void search();
   private:
     QLineEdit *searchField;
+    QStringListModel *completions;
+    QCompleter *completer;
 };
 
 class ScateFindBar : public QToolBar
@@ -0,0 +1,395 @@
+/*
+#
+# Copyright 2010-2011 Jakob Leben (jakob.leben@gmail.com)
+#
+# This file is part of Scate - a SuperCollider plugin for Kate
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+*/
+
+#include "ScateHelpBundle.hpp"
+#include "ScateEvalTracker.hpp"
+
+#include <kstandarddirs.h>
+
+#include <QDir>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QDataStream>
+#include <QNetworkRequest>
+
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+// changes whenever the layout of the bundle changes
+static const quint32 bundleMagic = 0x53434842; // "SCHB"
+static const quint32 bundleVersion = 1;
+static const int headerSize = 8;
+static const int trailerSize = 12;
+
+static QString contentType( const QString &path )
+{
+  QString suffix = QFileInfo( path ).suffix().toLower();
+  if( suffix == "html" || suffix == "htm" ) return "text/html";
+  if( suffix == "css" ) return "text/css";
+  if( suffix == "js" ) return "application/javascript";
+  if( suffix == "png" ) return "image/png";
+  if( suffix == "jpg" || suffix == "jpeg" ) return "image/jpeg";
+  if( suffix == "gif" ) return "image/gif";
+  if( suffix == "svg" ) return "image/svg+xml";
+  return "application/octet-stream";
+}
+
+static QString cleanPath( const QString &path )
+{
+  return QDir::cleanPath( QDir( path ).absolutePath() );
+}
+
+// Asks the kernel to drop the file from the page cache, so that reading it
+// next time goes to the disk.
+static void dropFromCache( const QString &path )
+{
+  int fd = ::open( QFile::encodeName( path ).constData(), O_RDONLY );
+  if( fd < 0 ) return;
+  ::posix_fadvise( fd, 0, 0, POSIX_FADV_DONTNEED );
+  ::close( fd );
+}
+
+static qint64 loadLoose( const QStringList &pages, qint64 &bytes )
+{
+  bytes = 0;
+  qint64 start = ScateEvalTracker::now();
+  foreach( const QString &page, pages ) {
+    QFile file( page );
+    if( !file.open( QIODevice::ReadOnly ) ) continue;
+    bytes += file.readAll().size();
+  }
+  return ScateEvalTracker::now() - start;
+}
+
+static qint64 loadBundled( ScateHelpBundle &bundle, const QStringList &names )
+{
+  qint64 start = ScateEvalTracker::now();
+  QByteArray data;
+  foreach( const QString &name, names ) bundle.read( name, data );
+  return ScateEvalTracker::now() - start;
+}
+
+ScateHelpBundle::ScateHelpBundle( const QString &fileName, QObject *parent )
+: QObject( parent ),
+  file( fileName ),
+  map( 0 ),
+  mapSize( 0 ),
+  served( 0 )
+{}
+
+ScateHelpBundle::~ScateHelpBundle()
+{
+  close();
+}
+
+QString ScateHelpBundle::defaultFileName()
+{
+  return KStandardDirs::locateLocal( "data", "kate/plugins/katescate/help.bundle" );
+}
+
+QString ScateHelpBundle::scheme()
+{
+  return QString("scate-help");
+}
+
+bool ScateHelpBundle::open()
+{
+  close();
+  if( !file.open( QIODevice::ReadOnly ) ) return false;
+  mapSize = file.size();
+  if( mapSize >= headerSize + trailerSize ) map = file.map( 0, mapSize );
+  if( !map ) {
+    close();
+    return false;
+  }
+
+  quint32 magic, version;
+  QDataStream header( QByteArray::fromRawData( (const char*) map, headerSize ) );
+  header >> magic >> version;
+  if( magic != bundleMagic || version != bundleVersion ) {
+    close();
+    return false;
+  }
+
+  quint64 indexOffset;
+  QDataStream trailer( QByteArray::fromRawData( (const char*) map + mapSize - trailerSize,
+                                                trailerSize ) );
+  trailer >> indexOffset >> magic;
+  if( magic != bundleMagic || indexOffset < (quint64) headerSize
+      || indexOffset > (quint64) ( mapSize - trailerSize ) ) {
+    close();
+    return false;
+  }
+
+  QDataStream index( QByteArray::fromRawData( (const char*) map + indexOffset,
+                                              mapSize - trailerSize - indexOffset ) );
+  index.setVersion( QDataStream::Qt_4_6 );
+  quint32 count;
+  index >> roots >> count;
+  for( quint32 i = 0; i < count && index.status() == QDataStream::Ok; ++i ) {
+    QString name;
+    Entry entry;
+    quint8 compressed;
+    index >> name >> entry.offset >> entry.size >> entry.unpackedSize >> compressed;
+    entry.compressed = compressed;
+    if( entry.offset + entry.size > indexOffset ) break;
+    entries.insert( name, entry );
+  }
+  if( index.status() != QDataStream::Ok || (quint32) entries.count() != count ) {
+    close();
+    return false;
+  }
+  return true;
+}
+
+void ScateHelpBundle::close()
+{
+  if( map ) file.unmap( map );
+  map = 0;
+  mapSize = 0;
+  file.close();
+  roots.clear();
+  entries.clear();
+}
+
+bool ScateHelpBundle::covers( const QStringList &helpDirs ) const
+{
+  if( !map || helpDirs.count() != roots.count() ) return false;
+  for( int i = 0; i < helpDirs.count(); ++i )
+    if( cleanPath( helpDirs[i] ) != roots[i] ) return false;
+  return true;
+}
+
+QUrl ScateHelpBundle::url( const QString &path ) const
+{
+  if( !map ) return QUrl();
+  QString filePath = QDir::cleanPath( QFileInfo( path ).absoluteFilePath() );
+  for( int i = 0; i < roots.count(); ++i ) {
+    if( !filePath.startsWith( roots[i] + '/' ) ) continue;
+    QString name = QString::number( i ) + '/' + filePath.mid( roots[i].size() + 1 );
+    if( !entries.contains( name ) ) continue;
+    QUrl url;
+    url.setScheme( scheme() );
+    url.setPath( '/' + name );
+    return url;
+  }
+  return QUrl();
+}
+
+bool ScateHelpBundle::read( const QString &name, QByteArray &data )
+{
+  QHash<QString, Entry>::const_iterator it = entries.constFind( name );
+  if( it == entries.constEnd() ) return false;
+  const uchar *bytes = map + it->offset;
+  if( it->compressed )
+    data = qUncompress( bytes, it->size );
+  else
+    data = QByteArray( (const char*) bytes, it->size );
+  ++served;
+  return true;
+}
+
+QString ScateHelpBundle::statistics() const
+{
+  if( !map ) return QString("Help bundle: not packed");
+  return QString("Help bundle: %1 files of %2 help directories, %3 MiB, %4 files served")
+    .arg( entries.count() ).arg( roots.count() )
+    .arg( mapSize / 1048576.0, 0, 'f', 1 ).arg( served );
+}
+
+QString ScateHelpBundle::pack( QStringList helpDirs, QString fileName, bool compress )
+{
+  qint64 start = ScateEvalTracker::now();
+
+  // written next to the bundle and renamed, so that a bundle being packed
+  // is never read
+  QString tmpName = fileName + ".new";
+  QFile out( tmpName );
+  if( !out.open( QIODevice::WriteOnly | QIODevice::Truncate ) )
+    return QString("Could not write the help bundle %1").arg( tmpName );
+
+  QDataStream stream( &out );
+  stream << bundleMagic << bundleVersion;
+  stream.setVersion( QDataStream::Qt_4_6 );
+
+  QStringList roots;
+  QStringList names;
+  QList<Entry> entries;
+  qint64 bytes = 0;
+  bool ok = true;
+  for( int i = 0; i < helpDirs.count() && ok; ++i ) {
+    QString root = cleanPath( helpDirs[i] );
+    roots << root;
+    QDirIterator it( root, QDir::Files, QDirIterator::Subdirectories );
+    while( it.hasNext() && ok ) {
+      QString path = it.next();
+      QFile in( path );
+      if( !in.open( QIODevice::ReadOnly ) ) continue;
+      QByteArray data = in.readAll();
+      bytes += data.size();
+
+      Entry entry;
+      entry.unpackedSize = data.size();
+      entry.compressed = false;
+      if( compress ) {
+        QByteArray packed = qCompress( data );
+        if( packed.size() < data.size() * 0.9 ) {
+          data = packed;
+          entry.compressed = true;
+        }
+      }
+      entry.offset = out.pos();
+      entry.size = data.size();
+      ok = out.write( data ) == data.size();
+
+      names << QString::number( i ) + '/' + path.mid( root.size() + 1 );
+      entries << entry;
+    }
+  }
+
+  quint64 indexOffset = out.pos();
+  stream << roots << (quint32) entries.count();
+  for( int i = 0; i < entries.count(); ++i ) {
+    const Entry &entry = entries[i];
+    stream << names[i] << entry.offset << entry.size << entry.unpackedSize
+           << (quint8) entry.compressed;
+  }
+  stream << indexOffset << bundleMagic;
+  qint64 size = out.pos();
+  out.close();
+
+  if( !ok || stream.status() != QDataStream::Ok || out.error() != QFile::NoError ) {
+    QFile::remove( tmpName );
+    return QString("Could not write the help bundle %1").arg( tmpName );
+  }
+  QFile::remove( fileName );
+  if( !QFile::rename( tmpName, fileName ) ) {
+    QFile::remove( tmpName );
+    return QString("Could not write the help bundle %1").arg( fileName );
+  }
+
+  return QString("Packed %1 files of %2 help directories (%3 MiB) into %4 (%5 MiB) in %6")
+    .arg( entries.count() ).arg( roots.count() ).arg( bytes / 1048576.0, 0, 'f', 1 )
+    .arg( fileName ).arg( size / 1048576.0, 0, 'f', 1 )
+    .arg( ScateEvalTracker::formatLatency( ScateEvalTracker::now() - start ) );
+}
+
+QString ScateHelpBundle::benchmark( QStringList pages, QString fileName )
+{
+  QStringList names;
+  {
+    ScateHelpBundle bundle( fileName );
+    if( !bundle.open() ) return QString("There is no help bundle; pack the help files first.");
+    QStringList bundled;
+    foreach( const QString &page, pages ) {
+      QUrl url = bundle.url( page );
+      if( url.isEmpty() ) continue;
+      bundled << page;
+      names << url.path().mid( 1 );
+    }
+    pages = bundled;
+  }
+  if( pages.isEmpty() ) return QString("None of the help pages is in the help bundle.");
+
+  qint64 bytes;
+  foreach( const QString &page, pages ) dropFromCache( page );
+  qint64 looseCold = loadLoose( pages, bytes );
+  qint64 looseWarm = loadLoose( pages, bytes );
+
+  dropFromCache( fileName );
+  qint64 start = ScateEvalTracker::now();
+  ScateHelpBundle bundle( fileName );
+  bundle.open();
+  qint64 openTime = ScateEvalTracker::now() - start;
+  qint64 bundleCold = loadBundled( bundle, names );
+  qint64 bundleWarm = loadBundled( bundle, names );
+
+  double count = pages.count() * 1000.0;
+  QString msg = QString("Loading %1 help pages (%2 KiB), per page:\n")
+    .arg( pages.count() ).arg( bytes / 1024 );
+  msg += QString("  loose files: %1 us cold, %2 us warm\n")
+    .arg( looseCold / count, 0, 'f', 1 ).arg( looseWarm / count, 0, 'f', 1 );
+  msg += QString("  help bundle: %1 us cold, %2 us warm, after opening it in %3\n")
+    .arg( bundleCold / count, 0, 'f', 1 ).arg( bundleWarm / count, 0, 'f', 1 )
+    .arg( ScateEvalTracker::formatLatency( openTime ) );
+  msg += "Cold loads read files dropped from the page cache; parts of the bundle "
+         "mapped by a help browser stay cached.";
+  return msg;
+}
+
+ScateHelpBundleReply::ScateHelpBundleReply( ScateHelpBundle *bundle,
+                                            const QNetworkRequest &request, QObject *parent )
+: QNetworkReply( parent ),
+  offset( 0 )
+{
+  setRequest( request );
+  setUrl( request.url() );
+  setOperation( QNetworkAccessManager::GetOperation );
+  open( QIODevice::ReadOnly | QIODevice::Unbuffered );
+
+  QString path = request.url().path();
+  if( bundle->read( path.mid( 1 ), content ) ) {
+    setHeader( QNetworkRequest::ContentTypeHeader, contentType( path ) );
+    setHeader( QNetworkRequest::ContentLengthHeader, content.size() );
+    QMetaObject::invokeMethod( this, "metaDataChanged", Qt::QueuedConnection );
+    QMetaObject::invokeMethod( this, "readyRead", Qt::QueuedConnection );
+  }
+  else {
+    setError( ContentNotFoundError,
+              QString("%1 is not in the help bundle").arg( request.url().toString() ) );
+    // QtWebKit learns of the failure only by the error signal, which has to
+    // come before finished()
+    qRegisterMetaType<QNetworkReply::NetworkError>( "QNetworkReply::NetworkError" );
+    QMetaObject::invokeMethod( this, "error", Qt::QueuedConnection,
+                               Q_ARG( QNetworkReply::NetworkError, ContentNotFoundError ) );
+  }
+  QMetaObject::invokeMethod( this, "finished", Qt::QueuedConnection );
+}
+
+qint64 ScateHelpBundleReply::bytesAvailable() const
+{
+  return content.size() - offset + QNetworkReply::bytesAvailable();
+}
+
+qint64 ScateHelpBundleReply::readData( char *data, qint64 maxSize )
+{
+  qint64 size = qMin( maxSize, (qint64) content.size() - offset );
+  if( size <= 0 ) return -1;
+  memcpy( data, content.constData() + offset, size );
+  offset += size;
+  return size;
+}
+
+ScateHelpNetworkManager::ScateHelpNetworkManager( ScateHelpBundle *bundle, QObject *parent )
+: QNetworkAccessManager( parent ),
+  bundle( bundle )
+{}
+
+QNetworkReply *ScateHelpNetworkManager::createRequest( Operation op,
+                                                       const QNetworkRequest &request,
+                                                       QIODevice *outgoingData )
+{
+  if( op == GetOperation && request.url().scheme() == ScateHelpBundle::scheme() )
+    return new ScateHelpBundleReply( bundle, request, this );
+  return QNetworkAccessManager::createRequest( op, request, outgoingData );
+}
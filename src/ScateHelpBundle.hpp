@@ -0,0 +1,123 @@
+/*
+#
+# Copyright 2010-2011 Jakob Leben (jakob.leben@gmail.com)
+#
+# This file is part of Scate - a SuperCollider plugin for Kate
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+*/
+
+#ifndef SCATE_HELP_BUNDLE_H
+#define SCATE_HELP_BUNDLE_H
+
+#include <QObject>
+#include <QFile>
+#include <QHash>
+#include <QStringList>
+#include <QUrl>
+#include <QNetworkReply>
+#include <QNetworkAccessManager>
+
+// All files of the help directories packed into one file, so that loading
+// a help page does not open and read many small files.
+// The bundle starts with a header, followed by the contents of the files,
+// each compressed if that makes it notably smaller, then an index of the
+// files by path, and a trailer giving where the index starts. The bundle is
+// read through a memory map of the whole file.
+// Files are named by the number of their help directory and their path
+// relative to it, which is also the path of their URL with the
+// "scate-help" scheme, so relative links between pages keep working.
+
+class ScateHelpBundle : public QObject
+{
+  Q_OBJECT
+
+  public:
+    ScateHelpBundle( const QString &fileName, QObject *parent = 0 );
+    ~ScateHelpBundle();
+    // Where the packed help files are kept.
+    static QString defaultFileName();
+    static QString scheme();
+
+    // Maps the bundle file, again if it was packed meanwhile.
+    bool open();
+    void close();
+    inline bool isOpen() const { return map != 0; }
+    // The bundle holds the files of the given help directories.
+    bool covers( const QStringList &helpDirs ) const;
+    // The URL of the bundled copy of the file, or an empty URL.
+    QUrl url( const QString &path ) const;
+    // The contents of the file of the given name, the path of its URL.
+    bool read( const QString &name, QByteArray &data );
+    QString statistics() const;
+
+    // Packs the files of the help directories into a bundle file, returning
+    // a report.
+    static QString pack( QStringList helpDirs, QString fileName, bool compress );
+    // Compares loading the pages from loose files and from the bundle, first
+    // with the files dropped from the page cache, then again.
+    static QString benchmark( QStringList pages, QString fileName );
+
+  private:
+    struct Entry {
+      quint64 offset;
+      quint32 size;
+      quint32 unpackedSize;
+      bool compressed;
+    };
+
+    QFile file;
+    uchar *map;
+    qint64 mapSize;
+    QStringList roots;
+    QHash<QString, Entry> entries;
+    quint64 served;
+};
+
+// A reply with a file of the help bundle.
+class ScateHelpBundleReply : public QNetworkReply
+{
+  Q_OBJECT
+
+  public:
+    ScateHelpBundleReply( ScateHelpBundle *, const QNetworkRequest &, QObject *parent = 0 );
+    void abort() {}
+    qint64 bytesAvailable() const;
+    bool isSequential() const { return true; }
+
+  protected:
+    qint64 readData( char *data, qint64 maxSize );
+
+  private:
+    QByteArray content;
+    qint64 offset;
+};
+
+// Serves the URLs of the help bundle's scheme from the bundle.
+class ScateHelpNetworkManager : public QNetworkAccessManager
+{
+  Q_OBJECT
+
+  public:
+    ScateHelpNetworkManager( ScateHelpBundle *, QObject *parent = 0 );
+
+  protected:
+    QNetworkReply *createRequest( Operation, const QNetworkRequest &, QIODevice *outgoingData );
+
+  private:
+    ScateHelpBundle *bundle;
+};
+
+#endif // SCATE_HELP_BUNDLE_H
@@ -0,0 +1,279 @@
+/*
+#
+# Copyright 2010-2011 Jakob Leben (jakob.leben@gmail.com)
+#
+# This file is part of Scate - a SuperCollider plugin for Kate
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+*/
+
+#include "ScateHelpIndex.hpp"
+#include "ScateSettings.hpp"
+#include "ScateEvalTracker.hpp"
+
+#include <kstandarddirs.h>
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QDataStream>
+#include <QSet>
+#include <QtConcurrentRun>
+
+// changes whenever the layout of the index file changes
+static const quint32 indexMagic = 0x5343484c; // "SCHI"
+static const quint32 indexVersion = 1;
+
+// refreshes after failed lookups are at most this far apart, in nanoseconds
+static const qint64 missRefreshInterval = Q_INT64_C(10000000000);
+
+// how long to wait for more changes to the help directories before
+// refreshing, in milliseconds
+static const int changeDelay = 1000;
+
+static QDataStream &operator<<( QDataStream &stream, const ScateHelpIndex::Directory &dir )
+{
+  return stream << dir.mtime << dir.subdirs << dir.files;
+}
+
+static QDataStream &operator>>( QDataStream &stream, ScateHelpIndex::Directory &dir )
+{
+  return stream >> dir.mtime >> dir.subdirs >> dir.files;
+}
+
+static bool isHelpFile( const QString &name )
+{
+  return name.endsWith( ".html", Qt::CaseInsensitive )
+    || name.endsWith( ".schelp", Qt::CaseInsensitive );
+}
+
+static bool readIndex( const QString &fileName, ScateHelpIndex::Data &data )
+{
+  QFile file( fileName );
+  if( !file.open( QIODevice::ReadOnly ) ) return false;
+  QDataStream stream( &file );
+  quint32 magic, version;
+  stream >> magic >> version;
+  if( magic != indexMagic || version != indexVersion ) return false;
+  stream.setVersion( QDataStream::Qt_4_6 );
+  stream >> data.roots >> data.dirs;
+  if( stream.status() != QDataStream::Ok ) {
+    data.roots.clear();
+    data.dirs.clear();
+    return false;
+  }
+  return true;
+}
+
+static void writeIndex( const QString &fileName, const ScateHelpIndex::Data &data )
+{
+  // written next to the index and renamed, so that a partly written file is
+  // never read
+  QString tmpName = fileName + ".new";
+  QFile file( tmpName );
+  if( !file.open( QIODevice::WriteOnly | QIODevice::Truncate ) ) return;
+  QDataStream stream( &file );
+  stream << indexMagic << indexVersion;
+  stream.setVersion( QDataStream::Qt_4_6 );
+  stream << data.roots << data.dirs;
+  file.close();
+  if( stream.status() != QDataStream::Ok ) {
+    QFile::remove( tmpName );
+    return;
+  }
+  QFile::remove( fileName );
+  QFile::rename( tmpName, fileName );
+}
+
+// Records the directory at path and the directories below it, reusing the
+// records of the old index for those whose modification time did not change.
+static void scanDirectory( const QString &path, const ScateHelpIndex::Data &old,
+                           ScateHelpIndex::Data &data )
+{
+  if( data.dirs.contains( path ) ) return;
+
+  QFileInfo info( path );
+  if( !info.isDir() ) return;
+  qint64 mtime = info.lastModified().toMSecsSinceEpoch();
+
+  ScateHelpIndex::Directory dir;
+  QHash<QString, ScateHelpIndex::Directory>::const_iterator it = old.dirs.constFind( path );
+  if( it != old.dirs.constEnd() && it->mtime == mtime ) {
+    dir = *it;
+    ++data.reused;
+  }
+  else {
+    dir.mtime = mtime;
+    QFileInfoList entries = QDir( path ).entryInfoList( QDir::Dirs | QDir::Files
+                                                        | QDir::NoDotAndDotDot,
+                                                        QDir::Name );
+    foreach( const QFileInfo &entry, entries ) {
+      if( entry.isDir() ) {
+        // like a recursive directory iterator, links to directories are not
+        // followed
+        if( !entry.isSymLink() ) dir.subdirs << entry.fileName();
+      }
+      else if( isHelpFile( entry.fileName() ) ) {
+        dir.files << entry.fileName();
+      }
+    }
+    ++data.listed;
+  }
+
+  data.dirs.insert( path, dir );
+  foreach( const QString &subdir, dir.subdirs )
+    scanDirectory( path + '/' + subdir, old, data );
+}
+
+// Maps the file names to paths; where several directories have a file of
+// the same name, the first directory of the first help directory wins.
+static void collectFiles( const QString &path, ScateHelpIndex::Data &data )
+{
+  QHash<QString, ScateHelpIndex::Directory>::const_iterator it = data.dirs.constFind( path );
+  if( it == data.dirs.constEnd() ) return;
+  foreach( const QString &name, it->files ) {
+    QString key = name.toLower();
+    if( !data.files.contains( key ) ) data.files.insert( key, path + '/' + name );
+  }
+  foreach( const QString &subdir, it->subdirs )
+    collectFiles( path + '/' + subdir, data );
+}
+
+static ScateHelpIndex::Data buildIndex( ScateHelpIndex::Data old, QStringList roots,
+                                        QString cacheFile )
+{
+  qint64 start = ScateEvalTracker::now();
+
+  // the first build starts from the index file
+  if( old.dirs.isEmpty() ) readIndex( cacheFile, old );
+
+  ScateHelpIndex::Data data;
+  data.listed = data.reused = 0;
+  foreach( const QString &root, roots ) {
+    QString path = QDir::cleanPath( QDir( root ).absolutePath() );
+    data.roots << path;
+    scanDirectory( path, old, data );
+  }
+  foreach( const QString &root, data.roots ) collectFiles( root, data );
+
+  if( data.listed || data.roots != old.roots || data.dirs.count() != old.dirs.count() )
+    writeIndex( cacheFile, data );
+
+  data.time = ScateEvalTracker::now() - start;
+  return data;
+}
+
+ScateHelpIndex::ScateHelpIndex( ScateSettings *settings, QObject *parent )
+: QObject( parent ),
+  settings( settings ),
+  cacheFile( KStandardDirs::locateLocal( "data", "kate/plugins/katescate/helpindex" ) ),
+  ready( false ),
+  _generation( 0 ),
+  refreshAgain( false ),
+  lastMissRefresh( 0 ),
+  lookups( 0 ),
+  lookupTime( 0 )
+{
+  data.listed = data.reused = 0;
+  data.time = 0;
+  changeTimer.setSingleShot( true );
+  changeTimer.setInterval( changeDelay );
+  connect( &watcher, SIGNAL(finished()), this, SLOT(onRefreshed()) );
+  connect( &dirWatcher, SIGNAL(directoryChanged(const QString&)),
+           this, SLOT(onDirectoryChanged()) );
+  connect( &changeTimer, SIGNAL(timeout()), this, SLOT(refresh()) );
+  connect( settings, SIGNAL(helpDirsChanged()), this, SLOT(refresh()) );
+  refresh();
+}
+
+ScateHelpIndex::~ScateHelpIndex()
+{
+  watcher.waitForFinished();
+}
+
+QString ScateHelpIndex::find( const QString &fileName )
+{
+  qint64 start = ScateEvalTracker::now();
+  QString path = data.files.value( fileName.toLower() );
+  lookupTime += ScateEvalTracker::now() - start;
+  ++lookups;
+
+  if( path.isEmpty() && ready ) {
+    if( start - lastMissRefresh >= missRefreshInterval ) {
+      lastMissRefresh = start;
+      refresh();
+    }
+  }
+  return path;
+}
+
+void ScateHelpIndex::refresh()
+{
+  if( watcher.isRunning() ) {
+    refreshAgain = true;
+    return;
+  }
+  watcher.setFuture( QtConcurrent::run( buildIndex, data, settings->helpDirs(), cacheFile ) );
+}
+
+void ScateHelpIndex::onRefreshed()
+{
+  Data result = watcher.result();
+  if( !ready || result.listed || result.roots != data.roots
+      || result.dirs.count() != data.dirs.count() )
+    ++_generation;
+  data = result;
+  ready = true;
+
+  // watch exactly the directories now in the index
+  QSet<QString> watched = dirWatcher.directories().toSet();
+  QStringList gone;
+  foreach( const QString &dir, watched ) {
+    if( !data.dirs.contains( dir ) ) gone << dir;
+  }
+  if( !gone.isEmpty() ) dirWatcher.removePaths( gone );
+  QStringList added;
+  foreach( const QString &dir, data.dirs.keys() ) {
+    if( !watched.contains( dir ) ) added << dir;
+  }
+  if( !added.isEmpty() ) dirWatcher.addPaths( added );
+
+  if( refreshAgain ) {
+    refreshAgain = false;
+    refresh();
+  }
+  emit updated();
+}
+
+void ScateHelpIndex::onDirectoryChanged()
+{
+  changeTimer.start();
+}
+
+QString ScateHelpIndex::statistics() const
+{
+  if( !ready ) return QString("Help index: being built");
+  QString msg = QString("Help index: %1 help files in %2 directories\n")
+    .arg( data.files.count() ).arg( data.dirs.count() );
+  msg += QString("  last refresh: %1 directories listed, %2 unchanged, %3\n")
+    .arg( data.listed ).arg( data.reused )
+    .arg( ScateEvalTracker::formatLatency( data.time ) );
+  msg += QString("  lookups: %1").arg( lookups );
+  if( lookups )
+    msg += QString(", %1 us on average")
+      .arg( lookupTime / 1000.0 / lookups, 0, 'f', 1 );
+  return msg;
+}
@@ -0,0 +1,116 @@
+/*
+#
+# Copyright 2010-2011 Jakob Leben (jakob.leben@gmail.com)
+#
+# This file is part of Scate - a SuperCollider plugin for Kate
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+*/
+
+#ifndef SCATE_HELP_INDEX_H
+#define SCATE_HELP_INDEX_H
+
+#include <QObject>
+#include <QHash>
+#include <QStringList>
+#include <QFutureWatcher>
+#include <QFileSystemWatcher>
+#include <QTimer>
+
+class ScateSettings;
+
+// An index of the help files in the help directories, by file name, so that
+// looking up the help of a class does not walk the directories.
+// The index is built on a worker thread and kept in a file. Each directory
+// is recorded with its modification time, which changes when entries are
+// added to, removed from or renamed in it; refreshing only lists the
+// directories whose time changed and reuses the record of all others.
+// The index refreshes when the help directories change in the settings,
+// shortly after any indexed directory changes on disk, and when a lookup
+// finds nothing, in case a change was missed.
+
+class ScateHelpIndex : public QObject
+{
+  Q_OBJECT
+
+  public:
+    ScateHelpIndex( ScateSettings *, QObject *parent = 0 );
+    ~ScateHelpIndex();
+    // The path of the help file of the given name, e.g. "SinOsc.html",
+    // ignoring case, or an empty string if there is none.
+    QString find( const QString &fileName );
+    // The index was built at least once.
+    inline bool isReady() const { return ready; }
+    // The paths of all help files in the index.
+    inline QStringList files() const { return data.files.values(); }
+    // Changes whenever a refresh found directories added, removed or
+    // changed.
+    inline int generation() const { return _generation; }
+    QString statistics() const;
+
+  public slots:
+    // Brings the index up to date with the help directories, in the
+    // background.
+    void refresh();
+
+  signals:
+    void updated();
+
+  private slots:
+    void onRefreshed();
+    void onDirectoryChanged();
+
+  public:
+    struct Directory {
+      Directory() : mtime( -1 ) {}
+      qint64 mtime;
+      QStringList subdirs;
+      // names of the help files in the directory itself
+      QStringList files;
+    };
+
+    struct Data {
+      QStringList roots;
+      // by path
+      QHash<QString, Directory> dirs;
+      // paths of help files, by lower case file name
+      QHash<QString, QString> files;
+      // directories listed and reused by the last refresh, and its time in
+      // nanoseconds
+      int listed;
+      int reused;
+      qint64 time;
+    };
+
+  private:
+    ScateSettings *settings;
+    QString cacheFile;
+    Data data;
+    QFutureWatcher<Data> watcher;
+    // watches the indexed directories; changes are gathered by changeTimer
+    // into one refresh
+    QFileSystemWatcher dirWatcher;
+    QTimer changeTimer;
+    bool ready;
+    int _generation;
+    bool refreshAgain;
+    // when the last refresh after a failed lookup was started
+    qint64 lastMissRefresh;
+    quint64 lookups;
+    // total time of the lookups, in nanoseconds
+    qint64 lookupTime;
+};
+
+#endif // SCATE_HELP_INDEX_H
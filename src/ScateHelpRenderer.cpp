@@ -0,0 +1,579 @@
+/*
+#
+# Copyright 2010-2011 Jakob Leben (jakob.leben@gmail.com)
+#
+# This file is part of Scate - a SuperCollider plugin for Kate
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+*/
+
+#include "ScateHelpRenderer.hpp"
+#include "ScateHelpIndex.hpp"
+#include "ScateEvalTracker.hpp"
+
+#include <kstandarddirs.h>
+
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QtConcurrentRun>
+#include <QStringList>
+#include <QCryptographicHash>
+
+// changes whenever the rendered pages change, to render them again
+static const int rendererVersion = 2;
+
+static const char *sourceMarker = "scate-source";
+
+static const char *pageStyle =
+  "body { font-family: sans-serif; margin: 1em 2em; }\n"
+  "h1 { margin-bottom: 0.2em; }\n"
+  "h2 { border-bottom: 1px solid #ccc; margin-top: 1.5em; }\n"
+  "h3.method { background: #eef; padding: 0.2em; margin-top: 1.5em; }\n"
+  "h4 { margin-bottom: 0.2em; }\n"
+  "pre.code { background: #f4f4f4; padding: 0.5em; }\n"
+  ".summary { font-style: italic; }\n"
+  ".categories, .related { font-size: small; color: #666; }\n"
+  ".note, .warning { border: 1px solid #ccc; padding: 0.3em; margin: 0.5em 0; }\n"
+  ".warning { border-color: #c66; }\n"
+  ".soft { color: #888; }\n"
+  ".broken { color: #c00; }\n";
+
+static QString escape( const QString &text )
+{
+  QString html;
+  html.reserve( text.size() );
+  foreach( QChar c, text ) {
+    if( c == '&' ) html += "&amp;";
+    else if( c == '<' ) html += "&lt;";
+    else if( c == '>' ) html += "&gt;";
+    else if( c == '\'' ) html += "&#39;";
+    else html += c;
+  }
+  return html;
+}
+
+// Turns SCDoc markup into HTML in one pass. Tags are words followed by
+// "::"; those of sections and methods take the rest of the line, others
+// enclose text up to a closing "::", and some of those enclose verbatim
+// text. Items of lists and tables begin with "##", cells with "||".
+class ScateSchelpParser
+{
+  public:
+    ScateSchelpParser( const QString &source, const QString &dir )
+    : src( source ), dir( dir ), pos( 0 ), methods( NoMethods ) {}
+
+    // Renders the whole source, returning the body.
+    QString parse();
+
+    QString title;
+    QString summary;
+    QString categories;
+    QString related;
+
+  private:
+    enum Methods { NoMethods, ClassMethods, InstanceMethods };
+
+    struct Open {
+      QString close;
+      // "ul", "dl" or "table" for lists and tables
+      QString kind;
+      // closes the current item, if any
+      QString itemClose;
+    };
+
+    bool isTagStart() const;
+    void tag( const QString &name );
+    QString restOfLine();
+    QString verbatim();
+    QString inlineHtml( const QString &text );
+    QString linkHtml( const QString &link );
+    void push( const QString &open, const QString &close, const QString &kind = QString() );
+    void close();
+    void closeAll();
+    // index of the innermost open list or table in the stack, or -1
+    int innermostList() const;
+    void item();
+    void cell();
+    void paragraph();
+
+    QString src;
+    QString dir;
+    int pos;
+    Methods methods;
+    QList<Open> stack;
+    QString out;
+};
+
+QString ScateSchelpParser::parse()
+{
+  int size = src.size();
+  while( pos < size ) {
+    QChar c = src[pos];
+    QChar next = pos + 1 < size ? src[pos + 1] : QChar();
+
+    if( c == '\\' && !next.isNull() ) {
+      // an escaped "::" stays text
+      if( src.mid( pos + 1, 2 ) == "::" ) {
+        out += "::";
+        pos += 3;
+      }
+      else {
+        out += escape( next );
+        pos += 2;
+      }
+    }
+    else if( c == ':' && next == ':' ) {
+      close();
+      pos += 2;
+    }
+    else if( c == '#' && next == '#' ) {
+      item();
+      pos += 2;
+    }
+    else if( c == '|' && next == '|' ) {
+      cell();
+      pos += 2;
+    }
+    else if( isTagStart() ) {
+      int end = pos;
+      while( end < size && src[end].isLetter() ) ++end;
+      QString name = src.mid( pos, end - pos ).toLower();
+      pos = end + 2;
+      tag( name );
+    }
+    else if( c == '\n' ) {
+      out += c;
+      ++pos;
+      // an empty line ends a paragraph
+      int end = pos;
+      while( end < size && ( src[end] == ' ' || src[end] == '\t' ) ) ++end;
+      if( end < size && src[end] == '\n' ) {
+        pos = end + 1;
+        paragraph();
+      }
+    }
+    else {
+      out += escape( c );
+      ++pos;
+    }
+  }
+  closeAll();
+  return out;
+}
+
+bool ScateSchelpParser::isTagStart() const
+{
+  if( !src[pos].isLetter() ) return false;
+  if( pos > 0 && src[pos - 1].isLetterOrNumber() ) return false;
+  int end = pos;
+  while( end < src.size() && src[end].isLetter() ) ++end;
+  return src.mid( end, 2 ) == "::";
+}
+
+void ScateSchelpParser::tag( const QString &name )
+{
+  // document properties
+  if( name == "title" ) { title = restOfLine(); return; }
+  if( name == "class" ) {
+    QString className = restOfLine();
+    if( title.isEmpty() ) title = className;
+    return;
+  }
+  if( name == "summary" ) { summary = inlineHtml( restOfLine() ); return; }
+  if( name == "categories" ) { categories = escape( restOfLine() ); return; }
+  if( name == "related" ) {
+    QStringList links;
+    foreach( const QString &link, restOfLine().split( QChar(',') ) )
+      if( !link.trimmed().isEmpty() ) links << linkHtml( link.trimmed() );
+    related = links.join( ", " );
+    return;
+  }
+  if( name == "redirect" || name == "keyword" || name == "private"
+      || name == "copymethod" ) {
+    restOfLine();
+    return;
+  }
+
+  // sections
+  if( name == "description" || name == "classmethods" || name == "instancemethods"
+      || name == "examples" || name == "section" || name == "subsection" ) {
+    QString heading = inlineHtml( restOfLine() );
+    closeAll();
+    if( name == "classmethods" ) {
+      methods = ClassMethods;
+      heading = "Class Methods";
+    }
+    else if( name == "instancemethods" ) {
+      methods = InstanceMethods;
+      heading = "Instance Methods";
+    }
+    else if( name == "description" ) heading = "Description";
+    else if( name == "examples" ) heading = "Examples";
+    const char *level = name == "subsection" ? "h3" : "h2";
+    out += QString("<%1>%2</%1>\n").arg( level ).arg( heading );
+    return;
+  }
+
+  // methods
+  if( name == "method" ) {
+    QStringList names = restOfLine().split( QChar(',') );
+    closeAll();
+    out += "<h3 class='method'>";
+    for( int i = 0; i < names.count(); ++i ) {
+      QString method = names[i].trimmed();
+      QString anchor = ( methods == ClassMethods ? "*" : "-" ) + method;
+      QString label = ( methods == ClassMethods ? title : QString() ) + "." + method;
+      if( i ) out += " / ";
+      out += QString("<a name='%1'></a>%2").arg( escape( anchor ) ).arg( escape( label ) );
+    }
+    out += "</h3>\n";
+    return;
+  }
+  if( name == "argument" ) {
+    QString argument = inlineHtml( restOfLine() );
+    closeAll();
+    out += QString("<h4 class='argument'>%1</h4>\n").arg( argument );
+    return;
+  }
+  if( name == "returns" || name == "discussion" ) {
+    QString text = inlineHtml( restOfLine() );
+    closeAll();
+    out += QString("<h4>%1:</h4>\n%2\n")
+      .arg( name == "returns" ? "Returns" : "Discussion" ).arg( text );
+    return;
+  }
+
+  // verbatim text
+  if( name == "code" || name == "teletype" ) {
+    QString text = verbatim();
+    // on lines of its own it is a block, else part of the text
+    int firstLine = text.indexOf( QChar('\n') );
+    if( firstLine != -1 && text.left( firstLine ).trimmed().isEmpty() ) {
+      text = text.mid( firstLine + 1 );
+      while( text.endsWith( QChar('\n') ) || text.endsWith( QChar(' ') ) ) text.chop( 1 );
+      out += QString("<pre class='code'>%1</pre>\n").arg( escape( text ) );
+    }
+    else {
+      out += QString("<code>%1</code>").arg( escape( text.trimmed() ) );
+    }
+    return;
+  }
+  if( name == "link" ) {
+    out += linkHtml( verbatim().trimmed() );
+    return;
+  }
+  if( name == "anchor" ) {
+    out += QString("<a name='%1'></a>").arg( escape( verbatim().trimmed() ) );
+    return;
+  }
+  if( name == "image" ) {
+    QStringList parts = verbatim().trimmed().split( QChar('#') );
+    QString url = QUrl::fromLocalFile( dir + '/' + parts[0] ).toString();
+    out += QString("<div class='image'><img src='%1'/><br/>%2</div>")
+      .arg( escape( url ) ).arg( escape( parts.value( 1 ) ) );
+    return;
+  }
+
+  // enclosed text
+  if( name == "strong" ) push( "<strong>", "</strong>" );
+  else if( name == "emphasis" ) push( "<em>", "</em>" );
+  else if( name == "soft" ) push( "<span class='soft'>", "</span>" );
+  else if( name == "note" ) push( "<div class='note'><b>Note:</b> ", "</div>\n" );
+  else if( name == "warning" ) push( "<div class='warning'><b>Warning:</b> ", "</div>\n" );
+  else if( name == "footnote" ) push( "<span class='soft'>[", "]</span>" );
+  else if( name == "list" || name == "tree" ) push( "<ul>", "</ul>\n", "ul" );
+  else if( name == "numberedlist" ) push( "<ol>", "</ol>\n", "ul" );
+  else if( name == "definitionlist" ) push( "<dl>", "</dl>\n", "dl" );
+  else if( name == "table" ) push( "<table border='1' cellspacing='0' cellpadding='3'>",
+                                   "</table>\n", "table" );
+  else out += escape( name + "::" );
+}
+
+QString ScateSchelpParser::restOfLine()
+{
+  int end = src.indexOf( QChar('\n'), pos );
+  if( end == -1 ) end = src.size();
+  QString line = src.mid( pos, end - pos ).trimmed();
+  pos = qMin( end + 1, src.size() );
+  return line;
+}
+
+QString ScateSchelpParser::verbatim()
+{
+  QString text;
+  int size = src.size();
+  while( pos < size ) {
+    if( src[pos] == '\\' && src.mid( pos + 1, 2 ) == "::" ) {
+      text += "::";
+      pos += 3;
+    }
+    else if( src[pos] == ':' && pos + 1 < size && src[pos + 1] == ':' ) {
+      pos += 2;
+      break;
+    }
+    else {
+      text += src[pos++];
+    }
+  }
+  return text;
+}
+
+QString ScateSchelpParser::inlineHtml( const QString &text )
+{
+  ScateSchelpParser parser( text, dir );
+  parser.title = title;
+  return parser.parse().trimmed();
+}
+
+QString ScateSchelpParser::linkHtml( const QString &link )
+{
+  QStringList parts = link.split( QChar('#') );
+  QString target = parts[0];
+  QString anchor = parts.value( 1 );
+  QString label = parts.value( 2 );
+
+  QString url;
+  if( target.contains( "://" ) || target.startsWith( "mailto:" ) )
+    url = target;
+  else if( !target.isEmpty() )
+    // resolved when followed, so that the page does not depend on the index
+    url = ScateHelpRenderer::linkScheme() + ':' + target;
+  if( !anchor.isEmpty() && ( !url.isEmpty() || target.isEmpty() ) )
+    url += '#' + anchor;
+
+  if( label.isEmpty() ) {
+    label = target.section( QChar('/'), -1 );
+    // method anchors begin with '*' or '-'
+    if( !anchor.isEmpty() )
+      label += "." + ( anchor[0].isLetter() ? anchor : anchor.mid( 1 ) );
+    if( label.startsWith( QChar('.') ) ) label = label.mid( 1 );
+  }
+
+  if( url.isEmpty() )
+    return QString("<span class='broken'>%1</span>").arg( escape( label ) );
+  return QString("<a href='%1'>%2</a>").arg( escape( url ) ).arg( escape( label ) );
+}
+
+void ScateSchelpParser::push( const QString &open, const QString &close, const QString &kind )
+{
+  Open o;
+  o.close = close;
+  o.kind = kind;
+  stack.append( o );
+  out += open;
+}
+
+void ScateSchelpParser::close()
+{
+  if( stack.isEmpty() ) return;
+  Open o = stack.takeLast();
+  out += o.itemClose + o.close;
+}
+
+void ScateSchelpParser::closeAll()
+{
+  while( !stack.isEmpty() ) close();
+}
+
+int ScateSchelpParser::innermostList() const
+{
+  for( int i = stack.count() - 1; i >= 0; --i )
+    if( !stack[i].kind.isEmpty() ) return i;
+  return -1;
+}
+
+void ScateSchelpParser::item()
+{
+  // items belong to the innermost list or table, ending what is still open
+  // in the previous item
+  int list = innermostList();
+  if( list == -1 ) {
+    out += "##";
+    return;
+  }
+  while( stack.count() > list + 1 ) close();
+  Open &o = stack.last();
+  out += o.itemClose;
+  if( o.kind == "ul" ) {
+    out += "<li>";
+    o.itemClose = "</li>\n";
+  }
+  else if( o.kind == "dl" ) {
+    out += "<dt>";
+    o.itemClose = "</dt>\n";
+  }
+  else {
+    out += "<tr><td>";
+    o.itemClose = "</td></tr>\n";
+  }
+}
+
+void ScateSchelpParser::cell()
+{
+  int list = innermostList();
+  if( list == -1 ) {
+    out += "||";
+    return;
+  }
+  while( stack.count() > list + 1 ) close();
+  Open &o = stack.last();
+  if( o.kind == "dl" ) {
+    out += o.itemClose + "<dd>";
+    o.itemClose = "</dd>\n";
+  }
+  else if( o.kind == "table" ) {
+    out += "</td><td>";
+  }
+}
+
+void ScateSchelpParser::paragraph()
+{
+  // paragraphs only separate running text
+  foreach( const Open &o, stack )
+    if( !o.kind.isEmpty() ) return;
+  out += "<p>";
+}
+
+ScateHelpRenderer::ScateHelpRenderer( ScateHelpIndex *index, QObject *parent )
+: QObject( parent ),
+  index( index ),
+  cacheDir( KStandardDirs::locateLocal( "cache", "katescate/help/" ) ),
+  hits( 0 ),
+  misses( 0 ),
+  pruned( 0 ),
+  renderTime( 0 )
+{
+  // pages of sources that were removed are never asked for again
+  QtConcurrent::run( &ScateHelpRenderer::pruneCache, cacheDir );
+}
+
+QUrl ScateHelpRenderer::page( const QString &path )
+{
+  QFile file( path );
+  if( !file.open( QIODevice::ReadOnly ) ) return QUrl();
+  QByteArray source = file.readAll();
+
+  // pages are named by the hash of the source path followed by the hash of
+  // the contents, so that the pages of older contents can be found
+  QString pathKey = QString::fromLatin1(
+    QCryptographicHash::hash( path.toUtf8(), QCryptographicHash::Sha1 ).toHex() );
+  QCryptographicHash hash( QCryptographicHash::Sha1 );
+  hash.addData( QByteArray::number( rendererVersion ) );
+  hash.addData( source );
+  QString pageName = pathKey + '-' + QString::fromLatin1( hash.result().toHex() ) + ".html";
+  QString pageFile = cacheDir + pageName;
+
+  if( QFile::exists( pageFile ) ) {
+    ++hits;
+    return QUrl::fromLocalFile( pageFile );
+  }
+
+  qint64 start = ScateEvalTracker::now();
+  QString html = render( QString::fromUtf8( source.constData(), source.size() ), path );
+
+  // written next to the page and renamed, so that a partly written page is
+  // never shown
+  QString tmpFile = pageFile + ".new";
+  QFile out( tmpFile );
+  if( !out.open( QIODevice::WriteOnly | QIODevice::Truncate ) ) return QUrl();
+  QByteArray bytes = html.toUtf8();
+  bool written = out.write( bytes ) == bytes.size();
+  out.close();
+  if( !written || !QFile::rename( tmpFile, pageFile ) ) {
+    QFile::remove( tmpFile );
+    return QUrl();
+  }
+
+  // the pages of older contents of the source are not needed anymore
+  QDir dir( cacheDir );
+  foreach( const QString &name, dir.entryList( QStringList( pathKey + "-*.html" ), QDir::Files ) ) {
+    if( name != pageName && dir.remove( name ) ) ++pruned;
+  }
+
+  renderTime += ScateEvalTracker::now() - start;
+  ++misses;
+  return QUrl::fromLocalFile( pageFile );
+}
+
+QString ScateHelpRenderer::render( const QString &source, const QString &path )
+{
+  ScateSchelpParser parser( source, QFileInfo( path ).absolutePath() );
+  QString body = parser.parse();
+
+  // the source is named on the first line, for pruneCache() to find pages
+  // whose source is gone; '-' is encoded so the name can not end the comment
+  QString html = QString("<!-- %1 %2 -->\n")
+    .arg( sourceMarker ).arg( QString::fromLatin1( QUrl::toPercentEncoding( path, "/", "-" ) ) );
+  html += "<html><head>\n<meta http-equiv='Content-Type' content='text/html; charset=utf-8'/>\n";
+  html += QString("<title>%1</title>\n<style>\n%2</style>\n</head><body>\n")
+    .arg( escape( parser.title ) ).arg( pageStyle );
+  if( !parser.categories.isEmpty() )
+    html += QString("<div class='categories'>%1</div>\n").arg( parser.categories );
+  html += QString("<h1>%1</h1>\n").arg( escape( parser.title ) );
+  if( !parser.summary.isEmpty() )
+    html += QString("<div class='summary'>%1</div>\n").arg( parser.summary );
+  if( !parser.related.isEmpty() )
+    html += QString("<div class='related'>See also: %1</div>\n").arg( parser.related );
+  html += body;
+  html += "\n</body></html>\n";
+  return html;
+}
+
+QString ScateHelpRenderer::linkUrl( const QString &target )
+{
+  QString name = target.section( QChar('/'), -1 );
+  QString path = index->find( name + ".html" );
+  if( path.isEmpty() ) path = index->find( name + ".schelp" );
+  if( path.isEmpty() ) return QString();
+  return QUrl::fromLocalFile( path ).toString();
+}
+
+int ScateHelpRenderer::pruneCache( const QString &cacheDir )
+{
+  int removed = 0;
+  QDir dir( cacheDir );
+  foreach( const QString &name, dir.entryList( QStringList( "*.html" ), QDir::Files ) ) {
+    QFile page( dir.filePath( name ) );
+    if( !page.open( QIODevice::ReadOnly ) ) continue;
+    QByteArray line = page.readLine( 4096 ).trimmed();
+    page.close();
+    // pages of older versions of the renderer are not named by the path of
+    // their source and would never be used again either
+    QByteArray prefix = QByteArray("<!-- ") + sourceMarker + ' ';
+    bool stale = !line.startsWith( prefix ) || !line.endsWith( " -->" );
+    if( !stale ) {
+      QByteArray source = line.mid( prefix.size(), line.size() - prefix.size() - 4 );
+      stale = !QFile::exists( QUrl::fromPercentEncoding( source ) );
+    }
+    if( stale && page.remove() ) ++removed;
+  }
+  return removed;
+}
+
+QString ScateHelpRenderer::statistics() const
+{
+  quint64 pages = hits + misses;
+  QString msg = QString("Help pages from .schelp sources: %1 rendered").arg( misses );
+  if( misses )
+    msg += QString(", %1 on average")
+      .arg( ScateEvalTracker::formatLatency( renderTime / (qint64) misses ) );
+  msg += QString(", %1 from the cache").arg( hits );
+  if( pruned )
+    msg += QString(", %1 stale pages removed").arg( pruned );
+  if( pages )
+    msg += QString(", hit rate %1%").arg( 100.0 * hits / pages, 0, 'f', 1 );
+  return msg;
+}
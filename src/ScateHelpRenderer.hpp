@@ -0,0 +1,77 @@
+/*
+#
+# Copyright 2010-2011 Jakob Leben (jakob.leben@gmail.com)
+#
+# This file is part of Scate - a SuperCollider plugin for Kate
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+*/
+
+#ifndef SCATE_HELP_RENDERER_H
+#define SCATE_HELP_RENDERER_H
+
+#include <QObject>
+#include <QUrl>
+
+class ScateHelpIndex;
+
+// Renders SCDoc's .schelp help sources to HTML pages for the help browser.
+// Rendered pages are kept in a cache directory, named by hashes of the
+// path and contents of the source, so a page is rendered again only when
+// its source changed; the page of the older contents is removed then, and
+// pages of removed sources when the renderer is created. Links to other
+// help documents are left as linkScheme() URLs, resolved through the help
+// index only when followed, preferring rendered HTML files over sources.
+// What depends on the class library, like the arguments of methods, is not
+// known without the interpreter and is left out.
+
+class ScateHelpRenderer : public QObject
+{
+  Q_OBJECT
+
+  public:
+    ScateHelpRenderer( ScateHelpIndex *, QObject *parent = 0 );
+    // The URL of the page rendered from the .schelp file, rendering it if
+    // the cache has no page for its current contents, or an empty URL if
+    // the file can not be read or the page not be written.
+    QUrl page( const QString &path );
+    // Renders the markup of the .schelp file at path to a HTML page.
+    QString render( const QString &source, const QString &path );
+    // The URL of the help document a link names, e.g. "Classes/SinOsc", or
+    // an empty string if there is none.
+    QString linkUrl( const QString &target );
+    QString statistics() const;
+
+    // Removes the pages in cacheDir whose source does not exist anymore,
+    // returning their number. Safe to run in a worker thread.
+    static int pruneCache( const QString &cacheDir );
+
+    // The scheme of the URLs rendered pages link other help documents by,
+    // e.g. "scate-link:Classes/SinOsc#-ar".
+    inline static QString linkScheme() { return "scate-link"; }
+    inline static bool isSource( const QString &path )
+      { return path.endsWith( ".schelp", Qt::CaseInsensitive ); }
+
+  private:
+    ScateHelpIndex *index;
+    QString cacheDir;
+    quint64 hits;
+    quint64 misses;
+    quint64 pruned;
+    // total time of rendering the pages not in the cache, in nanoseconds
+    qint64 renderTime;
+};
+
+#endif // SCATE_HELP_RENDERER_H
@@ -0,0 +1,324 @@
+/*
+#
+# Copyright 2010-2011 Jakob Leben (jakob.leben@gmail.com)
+#
+# This file is part of Scate - a SuperCollider plugin for Kate
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+*/
+
+#include "ScateHelpSearch.hpp"
+#include "ScateHelpIndex.hpp"
+#include "ScateEvalTracker.hpp"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QRegExp>
+#include <QtConcurrentRun>
+#include <QtConcurrentMap>
+
+#include <cmath>
+
+// how much more a word counts where it occurs than in the plain text
+static const float titleWeight = 10;
+static const float nameWeight = 20;
+static const float headingWeight = 3;
+static const float methodWeight = 5;
+
+static void addWords( ScateHelpSearch::Document &doc, const QString &text, float weight )
+{
+  foreach( const QString &word, ScateHelpSearch::tokenize( text ) )
+    doc.words[word] += weight;
+}
+
+// Removes the markup from HTML. Inline elements are removed without a
+// trace, as they may split a word, e.g. a class name in two colors.
+static QString plainText( QString html )
+{
+  html.remove( QRegExp( "</?(span|a|b|i|em|strong|font|code|tt)\\b[^>]*>",
+                        Qt::CaseInsensitive ) );
+  html.replace( QRegExp( "<[^>]*>" ), " " );
+  html.replace( QRegExp( "&#?[a-zA-Z0-9]+;" ), " " );
+  return html;
+}
+
+static void readHtml( QString text, ScateHelpSearch::Document &doc )
+{
+  QRegExp title( "<title[^>]*>(.*)</title>", Qt::CaseInsensitive );
+  title.setMinimal( true );
+  if( title.indexIn( text ) != -1 )
+    doc.title = plainText( title.cap( 1 ) ).simplified();
+
+  QRegExp code( "<(script|style)\\b[^>]*>.*</\\1>", Qt::CaseInsensitive );
+  code.setMinimal( true );
+  text.remove( code );
+
+  QRegExp heading( "<h([1-3])\\b[^>]*>(.*)</h\\1>", Qt::CaseInsensitive );
+  heading.setMinimal( true );
+  int pos = 0;
+  while( ( pos = heading.indexIn( text, pos ) ) != -1 ) {
+    addWords( doc, plainText( heading.cap( 2 ) ), headingWeight );
+    pos += heading.matchedLength();
+  }
+
+  addWords( doc, plainText( text ), 1 );
+}
+
+static void readSchelp( const QString &text, ScateHelpSearch::Document &doc )
+{
+  QRegExp lineTag( "^\\s*([a-zA-Z]+)::(.*)$" );
+  QRegExp markup( "[a-zA-Z]*::" );
+  foreach( const QString &line, text.split( QChar('\n') ) ) {
+    float weight = 0;
+    QString value = line;
+    if( lineTag.exactMatch( line ) ) {
+      QString tag = lineTag.cap( 1 ).toLower();
+      value = lineTag.cap( 2 ).trimmed();
+      if( tag == "title" ) {
+        // added with the weight of a title
+        doc.title = value;
+        continue;
+      }
+      if( tag == "method" || tag == "private" ) {
+        weight = methodWeight;
+        foreach( QString method, value.split( QChar(',') ) ) {
+          method = method.trimmed();
+          if( !method.isEmpty() ) doc.symbols << method;
+        }
+      }
+      else if( tag == "section" || tag == "subsection" || tag == "summary" )
+        weight = headingWeight;
+    }
+    value.replace( markup, " " );
+    addWords( doc, value, 1 );
+    if( weight ) addWords( doc, value, weight );
+  }
+}
+
+static ScateHelpSearch::Document readDocument( const QString &path )
+{
+  ScateHelpSearch::Document doc;
+  doc.path = path;
+  doc.bytes = 0;
+
+  QFile file( path );
+  if( !file.open( QIODevice::ReadOnly ) ) return doc;
+  QByteArray bytes = file.readAll();
+  doc.bytes = bytes.size();
+  QString text = QString::fromUtf8( bytes.constData(), bytes.size() );
+
+  if( path.endsWith( ".schelp", Qt::CaseInsensitive ) )
+    readSchelp( text, doc );
+  else
+    readHtml( text, doc );
+
+  QString name = QFileInfo( path ).completeBaseName();
+  if( doc.title.isEmpty() ) doc.title = name;
+  doc.symbols << doc.title << name;
+  addWords( doc, doc.title, titleWeight );
+  addWords( doc, name, nameWeight );
+
+  // repetitions count less and less
+  QHash<QString, float>::iterator it;
+  for( it = doc.words.begin(); it != doc.words.end(); ++it )
+    it.value() = 1 + std::log( it.value() );
+  return doc;
+}
+
+static void addDocument( ScateHelpSearch::Index &index, const ScateHelpSearch::Document &doc )
+{
+  ScateHelpSearch::Posting posting;
+  posting.doc = index.docs.size();
+  QHash<QString, float>::const_iterator it;
+  for( it = doc.words.constBegin(); it != doc.words.constEnd(); ++it ) {
+    posting.weight = it.value();
+    index.building[it.key()].append( posting );
+  }
+  foreach( const QString &symbol, doc.symbols ) index.symbolSet.insert( symbol );
+  index.docs.append( doc );
+  index.docs.last().words.clear();
+  index.docs.last().symbols.clear();
+  index.bytes += doc.bytes;
+}
+
+static bool caseInsensitiveLessThan( const QString &a, const QString &b )
+{
+  return a.compare( b, Qt::CaseInsensitive ) < 0;
+}
+
+static ScateHelpSearch::Index buildIndex( QStringList paths )
+{
+  qint64 start = ScateEvalTracker::now();
+
+  ScateHelpSearch::Index index =
+    QtConcurrent::blockingMappedReduced<ScateHelpSearch::Index>(
+      paths, readDocument, addDocument, QtConcurrent::OrderedReduce );
+
+  index.words = index.building.keys();
+  qSort( index.words );
+  index.postings.resize( index.words.size() );
+  for( int i = 0; i < index.words.size(); ++i )
+    index.postings[i] = index.building.value( index.words[i] );
+  index.building.clear();
+
+  // in the order QCompleter expects of a case insensitively sorted model
+  index.symbols = index.symbolSet.toList();
+  index.symbolSet.clear();
+  qSort( index.symbols.begin(), index.symbols.end(), caseInsensitiveLessThan );
+
+  index.time = ScateEvalTracker::now() - start;
+  return index;
+}
+
+static bool betterResult( const ScateHelpSearch::Result &a, const ScateHelpSearch::Result &b )
+{
+  if( a.score != b.score ) return a.score > b.score;
+  return a.title < b.title;
+}
+
+ScateHelpSearch::ScateHelpSearch( ScateHelpIndex *helpIndex, QObject *parent )
+: QObject( parent ),
+  helpIndex( helpIndex ),
+  builtGeneration( -1 ),
+  ready( false ),
+  searches( 0 ),
+  searchTime( 0 )
+{
+  connect( &watcher, SIGNAL(finished()), this, SLOT(onBuilt()) );
+  connect( helpIndex, SIGNAL(updated()), this, SLOT(rebuild()) );
+  rebuild();
+}
+
+ScateHelpSearch::~ScateHelpSearch()
+{
+  watcher.waitForFinished();
+}
+
+QStringList ScateHelpSearch::tokenize( const QString &text )
+{
+  QStringList words;
+  QString word;
+  int size = text.size();
+  for( int i = 0; i <= size; ++i ) {
+    QChar c = i < size ? text[i] : QChar(' ');
+    if( c.isLetterOrNumber() || c == '_' ) {
+      word += c.toLower();
+    }
+    else if( !word.isEmpty() ) {
+      if( word.size() >= 2 ) words << word;
+      word.clear();
+    }
+  }
+  return words;
+}
+
+QList<ScateHelpSearch::Result> ScateHelpSearch::search( const QString &query, int maxResults )
+{
+  QList<Result> results;
+  QStringList tokens = tokenize( query );
+  tokens.removeDuplicates();
+  if( !ready || tokens.isEmpty() ) return results;
+
+  qint64 start = ScateEvalTracker::now();
+
+  QHash<int, float> scores;
+  bool first = true;
+  foreach( const QString &token, tokens ) {
+    // the best score of each file for any word beginning with the token
+    QHash<int, float> matched;
+    QStringList::const_iterator begin = index.words.constBegin();
+    QStringList::const_iterator end = index.words.constEnd();
+    QStringList::const_iterator word = qLowerBound( begin, end, token );
+    for( ; word != end && word->startsWith( token ); ++word ) {
+      const QVector<Posting> &postings = index.postings[word - begin];
+      // rare words and words that are mostly the token count more
+      float factor = std::log( 1.0 + index.docs.size() / (double) postings.size() )
+        * token.size() / word->size();
+      foreach( const Posting &posting, postings ) {
+        float &best = matched[posting.doc];
+        best = qMax( best, posting.weight * factor );
+      }
+    }
+
+    if( first ) {
+      scores = matched;
+      first = false;
+    }
+    else {
+      QHash<int, float>::iterator it = scores.begin();
+      while( it != scores.end() ) {
+        QHash<int, float>::const_iterator m = matched.constFind( it.key() );
+        if( m == matched.constEnd() ) {
+          it = scores.erase( it );
+        }
+        else {
+          it.value() += m.value();
+          ++it;
+        }
+      }
+    }
+    if( scores.isEmpty() ) break;
+  }
+
+  QHash<int, float>::const_iterator it;
+  for( it = scores.constBegin(); it != scores.constEnd(); ++it ) {
+    const Document &doc = index.docs[it.key()];
+    Result result;
+    result.path = doc.path;
+    result.title = doc.title;
+    result.score = it.value();
+    results << result;
+  }
+  qSort( results.begin(), results.end(), betterResult );
+  if( results.size() > maxResults ) results.erase( results.begin() + maxResults, results.end() );
+
+  searchTime += ScateEvalTracker::now() - start;
+  ++searches;
+  return results;
+}
+
+void ScateHelpSearch::rebuild()
+{
+  if( watcher.isRunning() ) return;
+  if( !helpIndex->isReady() || helpIndex->generation() == builtGeneration ) return;
+
+  builtGeneration = helpIndex->generation();
+  QStringList paths = helpIndex->files();
+  qSort( paths );
+  watcher.setFuture( QtConcurrent::run( buildIndex, paths ) );
+}
+
+void ScateHelpSearch::onBuilt()
+{
+  index = watcher.result();
+  ready = true;
+  emit updated();
+  // the help index may have changed meanwhile
+  rebuild();
+}
+
+QString ScateHelpSearch::statistics() const
+{
+  if( !ready ) return QString("Help search: being built");
+  QString msg = QString("Help search: %1 words in %2 help files of %3 KiB, built in %4\n")
+    .arg( index.words.size() ).arg( index.docs.size() ).arg( index.bytes / 1024 )
+    .arg( ScateEvalTracker::formatLatency( index.time ) );
+  msg += QString("  completions: %1 names\n").arg( index.symbols.size() );
+  msg += QString("  searches: %1").arg( searches );
+  if( searches )
+    msg += QString(", %1 on average")
+      .arg( ScateEvalTracker::formatLatency( searchTime / (qint64) searches ) );
+  return msg;
+}
@@ -0,0 +1,119 @@
+/*
+#
+# Copyright 2010-2011 Jakob Leben (jakob.leben@gmail.com)
+#
+# This file is part of Scate - a SuperCollider plugin for Kate
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+*/
+
+#ifndef SCATE_HELP_SEARCH_H
+#define SCATE_HELP_SEARCH_H
+
+#include <QObject>
+#include <QHash>
+#include <QSet>
+#include <QVector>
+#include <QStringList>
+#include <QFutureWatcher>
+
+class ScateHelpIndex;
+
+// A full text search over the help files of the help index.
+// The text of the files is split into words, which are kept in an inverted
+// index: a sorted list of words, each with the files it occurs in and a
+// weight for each file. Words in the title and the file name weigh more,
+// as do method names and headings. The files are read and split on all
+// cores, in the background; the index is rebuilt when the help index
+// finds files added or removed.
+// A query is split into words like the text. A file matches if it contains
+// every word of the query, or a word beginning with it, and is ranked by
+// the weights of the words it matched, rare words counting more.
+// Along with the words, the index collects the names of classes, methods
+// and help topics, in their original case, for completing search terms.
+
+class ScateHelpSearch : public QObject
+{
+  Q_OBJECT
+
+  public:
+    struct Result {
+      QString path;
+      QString title;
+      float score;
+    };
+
+    ScateHelpSearch( ScateHelpIndex *, QObject *parent = 0 );
+    ~ScateHelpSearch();
+    // The index was built at least once.
+    inline bool isReady() const { return ready; }
+    // The best matches of the query, best first.
+    QList<Result> search( const QString &query, int maxResults = 100 );
+    // Class names, method names and help topics, sorted ignoring case.
+    inline const QStringList &symbols() const { return index.symbols; }
+    QString statistics() const;
+    // Splits text into lower case words of at least two letters or digits.
+    static QStringList tokenize( const QString &text );
+
+  signals:
+    void updated();
+
+  private slots:
+    void rebuild();
+    void onBuilt();
+
+  public:
+    struct Posting {
+      int doc;
+      float weight;
+    };
+
+    struct Document {
+      QString path;
+      QString title;
+      // words weighted by where and how often they occur
+      QHash<QString, float> words;
+      // names of the class, methods and topic the file documents
+      QStringList symbols;
+      qint64 bytes;
+    };
+
+    struct Index {
+      Index() : bytes( 0 ), time( 0 ) {}
+      QVector<Document> docs;
+      // sorted, and the postings of each
+      QStringList words;
+      QVector< QVector<Posting> > postings;
+      // postings by word, while the files are added
+      QHash<QString, QVector<Posting> > building;
+      QStringList symbols;
+      QSet<QString> symbolSet;
+      qint64 bytes;
+      // time to build, in nanoseconds
+      qint64 time;
+    };
+
+  private:
+    ScateHelpIndex *helpIndex;
+    Index index;
+    QFutureWatcher<Index> watcher;
+    int builtGeneration;
+    bool ready;
+    quint64 searches;
+    // total time of the searches, in nanoseconds
+    qint64 searchTime;
+};
+
+#endif // SCATE_HELP_SEARCH_H
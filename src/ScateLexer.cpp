@@ -0,0 +1,94 @@
+/*
+#
+# Copyright 2010-2011 Jakob Leben (jakob.leben@gmail.com)
+#
+# This file is part of Scate - a SuperCollider plugin for Kate
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+*/
+
+#include "ScateLexer.hpp"
+
+int ScateLexer::lexLine( const QChar *data, int n, int state, QVector<Bracket> *brackets,
+                         bool *hasCode, int *stateStart )
+{
+  int i = 0;
+  bool code = false;
+  if( stateStart ) *stateStart = -1;
+
+  while( i < n ) {
+    ushort c = data[i].unicode();
+    ushort next = i + 1 < n ? data[i+1].unicode() : 0;
+
+    if( state >= Comment ) {
+      if( c == '*' && next == '/' ) {
+        state = state == Comment ? Code : state - 1;
+        i += 2;
+      }
+      else if( c == '/' && next == '*' ) {
+        ++state;
+        i += 2;
+      }
+      else ++i;
+      continue;
+    }
+
+    if( state == String || state == Symbol ) {
+      code = true;
+      if( c == '\\' ) i += 2;
+      else {
+        if( c == (state == String ? '"' : '\'') ) state = Code;
+        ++i;
+      }
+      continue;
+    }
+
+    if( c == '/' && next == '/' ) break;
+    if( c == '/' && next == '*' ) {
+      if( stateStart ) *stateStart = i;
+      state = Comment;
+      i += 2;
+      continue;
+    }
+
+    if( !data[i].isSpace() ) code = true;
+
+    switch( c ) {
+      case '"':
+        state = String;
+        if( stateStart ) *stateStart = i;
+        break;
+      case '\'':
+        state = Symbol;
+        if( stateStart ) *stateStart = i;
+        break;
+      case '$':
+        // a character literal: $c, or an escaped one like $\t
+        i += next == '\\' ? 3 : 2;
+        continue;
+      case '(': case ')':
+      case '[': case ']':
+      case '{': case '}':
+        brackets->append( Bracket( i, (char) c ) );
+        break;
+      default:
+        break;
+    }
+    ++i;
+  }
+
+  if( hasCode ) *hasCode = code;
+  return state;
+}
@@ -0,0 +1,73 @@
+/*
+#
+# Copyright 2010-2011 Jakob Leben (jakob.leben@gmail.com)
+#
+# This file is part of Scate - a SuperCollider plugin for Kate
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+*/
+
+#ifndef SCATE_LEXER_H
+#define SCATE_LEXER_H
+
+#include <QString>
+#include <QVector>
+
+// Splits SuperCollider code into the parts that matter for its structure:
+// brackets, and everything that may contain brackets without them counting
+// - comments (block comments nest), strings, quoted symbols and character
+// literals such as $( .
+// Code is lexed one line at a time; the state at the end of a line is
+// passed on to the next one, so that a change to a line only needs lines
+// below it to be lexed again until their state is the same as before.
+
+class ScateLexer
+{
+  public:
+    // The state at a line boundary. Values from Comment on give the depth
+    // of nested block comments.
+    enum State {
+      Code = 0,
+      String,
+      Symbol,
+      Comment
+    };
+
+    struct Bracket {
+      Bracket() : column(0), ch(0) {}
+      Bracket( int col, char c ) : column(col), ch(c) {}
+      int column;
+      char ch;
+      inline bool isOpening() const { return ch == '(' || ch == '[' || ch == '{'; }
+    };
+
+    // Lexes a line starting in 'state', appends its brackets to 'brackets'
+    // and returns the state at its end. If 'hasCode' is given, it is set to
+    // whether the line contains anything but whitespace and comments. If
+    // 'stateStart' is given, it is set to the column where the state at the
+    // end of the line was entered, or -1 if that was on an earlier line.
+    static int lexLine( const QChar *line, int length, int state, QVector<Bracket> *brackets,
+                        bool *hasCode = 0, int *stateStart = 0 );
+    static inline int lexLine( const QString &line, int state, QVector<Bracket> *brackets,
+                               bool *hasCode = 0 )
+    {
+      return lexLine( line.unicode(), line.size(), state, brackets, hasCode );
+    }
+
+    static inline bool isComment( int state ) { return state >= Comment; }
+    static inline int commentDepth( int state ) { return state >= Comment ? state - Comment + 1 : 0; }
+};
+
+#endif // SCATE_LEXER_H
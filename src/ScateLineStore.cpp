@@ -0,0 +1,349 @@
+/*
+#
+# Copyright 2010-2011 Jakob Leben (jakob.leben@gmail.com)
+#
+# This file is part of Scate - a SuperCollider plugin for Kate
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+*/
+
+#include "ScateLineStore.hpp"
+
+#include <QtAlgorithms>
+
+static const int chunkSize = 64 * 1024;
+static const uchar foldedFlag = 0x80;
+// lines are broken after this many bytes
+static const int maxLineBytes = 16 * chunkSize;
+
+ScateLineStore::ScateLineStore( QObject *parent ) :
+  ScateLineSource( parent ),
+  groupOffset( 0 ),
+  _generation( 0 ),
+  end( 0 ),
+  lastOpen( false ),
+  lastContinued( false ),
+  lineLimit( 1000000 ),
+  memoryLimit( 64 * 1024 * 1024 ),
+  memory( 0 ),
+  maxLength( 0 )
+{}
+
+void ScateLineStore::setLimits( qint64 maxLines, qint64 maxBytes )
+{
+  lineLimit = qMax( qint64(1), maxLines );
+  memoryLimit = qMax( qint64(chunkSize), maxBytes );
+  evict();
+  emit changed();
+}
+
+qint64 ScateLineStore::firstLine() const
+{
+  if( chunks.isEmpty() ) return end;
+  return qMax( chunks.first().first, end - lineLimit );
+}
+
+int ScateLineStore::chunkIndex( const QList<Chunk> &chunks, qint64 n )
+{
+  // binary search for the last chunk starting at or before the line
+  int lo = 0, hi = chunks.count() - 1;
+  while( lo < hi ) {
+    int mid = ( lo + hi + 1 ) / 2;
+    if( chunks[mid].first <= n ) lo = mid;
+    else hi = mid - 1;
+  }
+  return lo;
+}
+
+QString ScateLineStore::lineIn( const QList<Chunk> &chunks, qint64 n )
+{
+  const Chunk &c = chunks[ chunkIndex( chunks, n ) ];
+  int i = n - c.first;
+  int begin = i ? c.ends[i-1] : 0;
+  return QString::fromUtf8( c.data.constData() + begin, c.ends[i] - begin );
+}
+
+QString ScateLineStore::line( qint64 n ) const
+{
+  if( n < firstLine() || n >= end ) return QString();
+  return lineIn( chunks, n );
+}
+
+QString ScateLineStore::Snapshot::line( qint64 n ) const
+{
+  if( n < first || n >= end ) return QString();
+  return lineIn( chunks, n );
+}
+
+ScateLineStore::Snapshot ScateLineStore::snapshot() const
+{
+  Snapshot s;
+  s.chunks = chunks;
+  s.first = firstLine();
+  s.end = end;
+  return s;
+}
+
+const QVector<qint64> &ScateLineStore::linesOfKind( ScatePostLine::Kind kind ) const
+{
+  return kind == ScatePostLine::Warning ? warningLines : errorLines;
+}
+
+void ScateLineStore::index( qint64 n, ScatePostLine::Kind kind )
+{
+  if( kind == ScatePostLine::Error ) errorLines.append( n );
+  else if( kind == ScatePostLine::Warning ) warningLines.append( n );
+}
+
+void ScateLineStore::unindex( qint64 n, ScatePostLine::Kind kind )
+{
+  QVector<qint64> *lines = kind == ScatePostLine::Error ? &errorLines
+    : kind == ScatePostLine::Warning ? &warningLines : 0;
+  if( lines && !lines->isEmpty() && lines->last() == n ) lines->pop_back();
+}
+
+ScatePostLine::Kind ScateLineStore::kind( qint64 n ) const
+{
+  if( n < firstLine() || n >= end ) return ScatePostLine::Normal;
+  const Chunk &c = chunks[ chunkIndex( chunks, n ) ];
+  return (ScatePostLine::Kind) ( c.kinds[ n - c.first ] & ~foldedFlag );
+}
+
+bool ScateLineStore::isFolded( qint64 n ) const
+{
+  if( n < firstLine() || n >= end ) return false;
+  const Chunk &c = chunks[ chunkIndex( chunks, n ) ];
+  return c.kinds[ n - c.first ] & foldedFlag;
+}
+
+void ScateLineStore::setFolded( qint64 n, bool folded )
+{
+  if( folded ) {
+    if( !groups.isEmpty() && groups.last().end == n )
+      ++groups.last().end;
+    else
+      groups.append( Group( n - 1, n + 1 ) );
+  }
+  else if( !groups.isEmpty() && groups.last().end == n + 1 ) {
+    // only ever called for the last line
+    if( --groups.last().end == groups.last().header + 1 )
+      groups.removeLast();
+  }
+}
+
+void ScateLineStore::append( const ScatePostBatch &batch )
+{
+  if( batch.isEmpty() ) return;
+
+  for( int i = 0; i < batch.lines.count(); ++i ) {
+    if( !batch.acks.isEmpty() ) appendNotes( batch, i );
+    const ScatePostLine &line = batch.lines[i];
+    QByteArray bytes = line.text.toUtf8();
+    int pos = 0;
+    forever {
+      int room = maxLineBytes - ( lastOpen ? openLength() : 0 );
+      int take = bytes.size() - pos;
+      bool full = take > room;
+      if( full ) {
+        // not within a multi-byte sequence
+        int cut = pos + qMax( 0, room );
+        while( cut > pos && ( bytes[cut] & 0xC0 ) == 0x80 ) --cut;
+        take = cut - pos;
+      }
+      QByteArray piece = pos == 0 && take == bytes.size() ? bytes : bytes.mid( pos, take );
+      bool folded = line.folded || lastContinued;
+      if( lastOpen ) {
+        if( take ) extendLine( piece, line.kind, folded );
+      }
+      else {
+        appendLine( piece, line.kind, folded );
+      }
+      pos += take;
+      if( !full ) break;
+      // the rest continues on a line folded into this one
+      lastOpen = false;
+      lastContinued = true;
+    }
+    lastOpen = !line.complete;
+    if( !lastOpen ) lastContinued = false;
+  }
+  if( !batch.acks.isEmpty() ) appendNotes( batch, batch.lines.count() );
+
+  evict();
+  emit changed();
+}
+
+void ScateLineStore::appendNotes( const ScatePostBatch &batch, int after )
+{
+  // notes of acknowledgements go to the line preceding them
+  if( end == firstLine() ) return;
+  foreach( const ScateEvalAck &ack, batch.acks ) {
+    if( ack.after != after || ack.note.isEmpty() ) continue;
+    if( !notes.isEmpty() && notes.last().line == end - 1 )
+      notes.last().text = ack.note;
+    else
+      notes.append( Note( end - 1, ack.note ) );
+  }
+}
+
+QString ScateLineStore::note( qint64 n ) const
+{
+  QVector<Note>::const_iterator it = qLowerBound( notes.begin(), notes.end(), Note( n ) );
+  if( it != notes.end() && it->line == n ) return it->text;
+  return QString();
+}
+
+void ScateLineStore::clear()
+{
+  chunks.clear();
+  notes.clear();
+  groupOffset += groups.count();
+  groups.clear();
+  errorLines.clear();
+  warningLines.clear();
+  ++_generation;
+  memory = 0;
+  maxLength = 0;
+  lastOpen = false;
+  lastContinued = false;
+  emit changed();
+}
+
+ScateLineStore::Chunk &ScateLineStore::newChunk( int size )
+{
+  Chunk c;
+  c.capacity = qMax( size, chunkSize );
+  c.data.reserve( c.capacity );
+  c.first = end;
+  chunks.append( c );
+  memory += chunkMemory( chunks.last() );
+  return chunks.last();
+}
+
+int ScateLineStore::chunkMemory( const Chunk &c )
+{
+  return c.data.capacity() + c.ends.capacity() * sizeof(quint32) + c.kinds.capacity();
+}
+
+void ScateLineStore::appendLine( const QByteArray &bytes, ScatePostLine::Kind kind,
+                                 bool folded )
+{
+  if( chunks.isEmpty()
+      || chunks.last().data.size() + bytes.size() > chunks.last().capacity )
+    newChunk( bytes.size() );
+
+  Chunk &c = chunks.last();
+  memory -= chunkMemory( c );
+  // a snapshot may have taken a share of the data
+  if( c.data.capacity() < c.capacity ) c.data.reserve( c.capacity );
+  c.data.append( bytes );
+  c.ends.append( c.data.size() );
+  c.kinds.append( folded ? kind | foldedFlag : kind );
+  memory += chunkMemory( c );
+
+  if( folded ) setFolded( end, true );
+  index( end, kind );
+
+  maxLength = qMax( maxLength, bytes.size() );
+  ++end;
+}
+
+int ScateLineStore::openLength() const
+{
+  const Chunk &c = chunks.last();
+  int i = c.ends.count() - 1;
+  return c.ends[i] - ( i ? c.ends[i-1] : 0 );
+}
+
+void ScateLineStore::extendLine( const QByteArray &bytes, ScatePostLine::Kind kind,
+                                 bool folded )
+{
+  Chunk &c = chunks.last();
+  int i = c.ends.count() - 1;
+  bool wasFolded = c.kinds[i] & foldedFlag;
+  ScatePostLine::Kind oldKind = (ScatePostLine::Kind) ( c.kinds[i] & ~foldedFlag );
+  int begin = i ? c.ends[i-1] : 0;
+  int length = c.ends[i] - begin + bytes.size();
+
+  if( c.data.size() + bytes.size() <= c.capacity ) {
+    memory -= chunkMemory( c );
+    if( c.data.capacity() < c.capacity ) c.data.reserve( c.capacity );
+    c.data.append( bytes );
+    c.ends[i] = c.data.size();
+    c.kinds[i] = folded ? kind | foldedFlag : kind;
+    memory += chunkMemory( c );
+    if( folded != wasFolded ) setFolded( end - 1, folded );
+    if( kind != oldKind ) {
+      unindex( end - 1, oldKind );
+      index( end - 1, kind );
+    }
+    maxLength = qMax( maxLength, length );
+    return;
+  }
+
+  if( wasFolded ) setFolded( end - 1, false );
+  unindex( end - 1, oldKind );
+
+  // move the line to a chunk that can hold all of it
+  QByteArray whole = c.data.mid( begin ) + bytes;
+  memory -= chunkMemory( c );
+  c.data.truncate( begin );
+  c.ends.resize( i );
+  c.kinds.resize( i );
+  memory += chunkMemory( c );
+  if( c.ends.isEmpty() ) {
+    memory -= chunkMemory( c );
+    chunks.removeLast();
+  }
+
+  --end;
+  // with room to grow, so that a line arriving in many pieces is not copied
+  // again for each of them
+  if( chunks.isEmpty() || chunks.last().data.size() + whole.size() > chunks.last().capacity )
+    newChunk( 2 * whole.size() );
+  appendLine( whole, kind, folded );
+}
+
+void ScateLineStore::dropChunk()
+{
+  memory -= chunkMemory( chunks.first() );
+  chunks.removeFirst();
+}
+
+void ScateLineStore::evict()
+{
+  while( chunks.count() > 1 &&
+         ( memory > memoryLimit || end - chunks[1].first >= lineLimit ) )
+    dropChunk();
+
+  qint64 first = firstLine();
+  while( !groups.isEmpty() && groups.first().end <= first ) {
+    groups.removeFirst();
+    ++groupOffset;
+  }
+
+  if( !notes.isEmpty() && notes.first().line < first )
+    notes.erase( notes.begin(), qLowerBound( notes.begin(), notes.end(), Note( first ) ) );
+
+  QVector<qint64> *indexes[] = { &errorLines, &warningLines };
+  for( int k = 0; k < 2; ++k ) {
+    QVector<qint64> &lines = *indexes[k];
+    // drop in bulk, rather than on every eviction
+    if( lines.count() > 1024 && lines[ lines.count() / 2 ] < first ) {
+      QVector<qint64>::iterator it = qLowerBound( lines.begin(), lines.end(), first );
+      lines.erase( lines.begin(), it );
+    }
+  }
+}
@@ -0,0 +1,190 @@
+/*
+#
+# Copyright 2010-2011 Jakob Leben (jakob.leben@gmail.com)
+#
+# This file is part of Scate - a SuperCollider plugin for Kate
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+*/
+
+#ifndef SCATE_LINE_STORE_H
+#define SCATE_LINE_STORE_H
+
+#include "ScatePost.hpp"
+
+#include <QObject>
+#include <QByteArray>
+#include <QVector>
+#include <QList>
+
+// Lines of interpreter output, as displayed by ScateTerminal.
+// Lines are addressed by absolute numbers. Consecutive lines folded into an
+// error are tracked as groups, which views can collapse to the error line.
+
+class ScateLineSource : public QObject
+{
+  Q_OBJECT
+  public:
+    struct Group {
+      Group( qint64 h = 0, qint64 e = 0 ) : header( h ), end( e ) {}
+      // the error line; the folded lines follow it up to 'end'
+      qint64 header;
+      qint64 end;
+    };
+
+    ScateLineSource( QObject *parent = 0 ) : QObject( parent ) {}
+
+    // number of the oldest line kept
+    virtual qint64 firstLine() const = 0;
+    // one past the number of the newest line
+    virtual qint64 endLine() const = 0;
+    inline qint64 count() const { return endLine() - firstLine(); }
+    inline bool isEmpty() const { return count() == 0; }
+
+    virtual QString line( qint64 n ) const = 0;
+    virtual ScatePostLine::Kind kind( qint64 n ) const = 0;
+    virtual bool isFolded( qint64 ) const { return false; }
+    // a short remark to show next to a line, like the latency of an
+    // evaluation whose result it is
+    virtual QString note( qint64 ) const { return QString(); }
+    virtual bool hasNotes() const { return false; }
+
+    // Groups are numbered absolutely, like lines.
+    virtual qint64 groupsBegin() const { return 0; }
+    virtual qint64 groupsEnd() const { return 0; }
+    virtual Group group( qint64 ) const { return Group(); }
+    // changes whenever lines are removed by other means than eviction
+    virtual int generation() const { return 0; }
+
+    // length of the longest line, in bytes
+    virtual int maxLineLength() const = 0;
+
+  signals:
+    void changed();
+};
+
+// Scrollback of the SC Terminal.
+// Lines are kept as packed UTF-8 text in fixed-size chunks, each with an index
+// of line end offsets and line kinds. When the configured number of lines or
+// amount of memory is exceeded, whole chunks are dropped from the front, so
+// memory stays bounded no matter how long the interpreter runs. A line
+// longer than a fixed limit, like output posted without line breaks, is
+// continued on lines folded into its first, so that it can be dropped in
+// parts too.
+// Line numbers keep counting up as old lines are dropped.
+// Error and warning lines are indexed as they arrive, for filtered views.
+// A Snapshot shares the chunks of the store, so it can be read from another
+// thread while the store keeps changing.
+
+class ScateLineStore : public ScateLineSource
+{
+  Q_OBJECT
+  public:
+    struct Chunk {
+      Chunk() : first( 0 ), capacity( 0 ) {}
+      QByteArray data;
+      QVector<quint32> ends;
+      QVector<uchar> kinds;
+      qint64 first;
+      int capacity;
+    };
+
+    class Snapshot {
+      public:
+        Snapshot() : first( 0 ), end( 0 ) {}
+        QString line( qint64 n ) const;
+        inline qint64 firstLine() const { return first; }
+        inline qint64 endLine() const { return end; }
+        inline const QList<Chunk> &chunkList() const { return chunks; }
+      private:
+        friend class ScateLineStore;
+        QList<Chunk> chunks;
+        qint64 first;
+        qint64 end;
+    };
+
+    ScateLineStore( QObject *parent = 0 );
+
+    void setLimits( qint64 maxLines, qint64 maxBytes );
+
+    qint64 firstLine() const;
+    inline qint64 endLine() const { return end; }
+    // true if the newest line is still incomplete
+    inline bool hasOpenLine() const { return lastOpen; }
+
+    QString line( qint64 n ) const;
+    ScatePostLine::Kind kind( qint64 n ) const;
+    bool isFolded( qint64 n ) const;
+    QString note( qint64 n ) const;
+    bool hasNotes() const { return !notes.isEmpty(); }
+
+    // Ascending numbers of error or warning lines; may include
+    // numbers of lines that have already been dropped.
+    const QVector<qint64> &linesOfKind( ScatePostLine::Kind ) const;
+
+    Snapshot snapshot() const;
+
+    qint64 groupsBegin() const { return groupOffset; }
+    qint64 groupsEnd() const { return groupOffset + groups.count(); }
+    Group group( qint64 i ) const { return groups[ i - groupOffset ]; }
+    int generation() const { return _generation; }
+
+    int maxLineLength() const { return maxLength; }
+    inline qint64 memoryUsage() const { return memory; }
+
+  public slots:
+    void append( const ScatePostBatch & );
+    void clear();
+
+  private:
+    struct Note {
+      Note( qint64 l = 0, const QString &t = QString() ) : line( l ), text( t ) {}
+      bool operator < ( const Note &o ) const { return line < o.line; }
+      qint64 line;
+      QString text;
+    };
+
+    void appendNotes( const ScatePostBatch &, int after );
+    void appendLine( const QByteArray &, ScatePostLine::Kind, bool folded );
+    void extendLine( const QByteArray &, ScatePostLine::Kind, bool folded );
+    int openLength() const;
+    void setFolded( qint64 line, bool folded );
+    void index( qint64 line, ScatePostLine::Kind );
+    void unindex( qint64 line, ScatePostLine::Kind );
+    Chunk &newChunk( int size );
+    void dropChunk();
+    void evict();
+    static int chunkIndex( const QList<Chunk> &, qint64 line );
+    static QString lineIn( const QList<Chunk> &, qint64 line );
+    static int chunkMemory( const Chunk & );
+
+    QList<Chunk> chunks;
+    QList<Group> groups;
+    QVector<Note> notes;
+    QVector<qint64> errorLines;
+    QVector<qint64> warningLines;
+    qint64 groupOffset;
+    int _generation;
+    qint64 end;
+    bool lastOpen;
+    // the newest line continues a line that reached the length limit
+    bool lastContinued;
+    qint64 lineLimit;
+    qint64 memoryLimit;
+    qint64 memory;
+    int maxLength;
+};
+
+#endif // SCATE_LINE_STORE_H
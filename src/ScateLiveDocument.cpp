@@ -0,0 +1,262 @@
+/*
+#
+# Copyright 2010-2011 Jakob Leben (jakob.leben@gmail.com)
+#
+# This file is part of Scate - a SuperCollider plugin for Kate
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+*/
+
+#include "ScateLiveDocument.hpp"
+#include "ScateSession.hpp"
+#include "ScateRegionIndex.hpp"
+#include "ScateEvalQueue.hpp"
+#include "ScateEvalTracker.hpp"
+
+#include <ktexteditor/document.h>
+#include <ktexteditor/view.h>
+#include <ktexteditor/markinterface.h>
+#include <ktexteditor/texthintinterface.h>
+#include <ktexteditor/configinterface.h>
+#include <kicon.h>
+#include <klocalizedstring.h>
+
+#include <QTimer>
+#include <QCryptographicHash>
+
+using KTextEditor::MarkInterface;
+
+// mark type for each State
+static const MarkInterface::MarkTypes stateMarks[] = {
+  MarkInterface::markType28,
+  MarkInterface::markType29,
+  MarkInterface::markType30,
+  MarkInterface::markType31
+};
+
+static const uint allStateMarks = MarkInterface::markType28 | MarkInterface::markType29
+                                | MarkInterface::markType30 | MarkInterface::markType31;
+
+ScateLiveDocument *ScateLiveDocument::of( KTextEditor::Document *doc )
+{
+  return doc->findChild<ScateLiveDocument*>();
+}
+
+ScateLiveDocument::ScateLiveDocument( KTextEditor::Document *doc_, ScateSession *session_ ) :
+  QObject( doc_ ),
+  doc( doc_ ),
+  session( 0 ),
+  index( ScateRegionIndex::of( doc_ ) )
+{
+  refreshTimer = new QTimer( this );
+  refreshTimer->setSingleShot( true );
+  refreshTimer->setInterval( 300 );
+  connect( refreshTimer, SIGNAL(timeout()), this, SLOT(refresh()) );
+
+  connect( doc, SIGNAL(textChanged(KTextEditor::Document*)), refreshTimer, SLOT(start()) );
+  connect( doc, SIGNAL(documentSavedOrUploaded(KTextEditor::Document*, bool)),
+           this, SLOT(evaluateChanged()) );
+  connect( doc, SIGNAL(viewCreated(KTextEditor::Document*, KTextEditor::View*)),
+           this, SLOT(addView(KTextEditor::Document*, KTextEditor::View*)) );
+  setSession( session_ );
+
+  MarkInterface *marks = qobject_cast<MarkInterface*>( doc );
+  if( marks ) {
+    marks->setMarkPixmap( stateMarks[Changed], KIcon("document-edit").pixmap( 16, 16 ) );
+    marks->setMarkPixmap( stateMarks[Pending], KIcon("view-refresh").pixmap( 16, 16 ) );
+    marks->setMarkPixmap( stateMarks[Clean], KIcon("dialog-ok-apply").pixmap( 16, 16 ) );
+    marks->setMarkPixmap( stateMarks[Failed], KIcon("dialog-error").pixmap( 16, 16 ) );
+    marks->setMarkDescription( stateMarks[Changed], i18n("Changed since evaluated") );
+    marks->setMarkDescription( stateMarks[Pending], i18n("Being evaluated") );
+    marks->setMarkDescription( stateMarks[Clean], i18n("Evaluated") );
+    marks->setMarkDescription( stateMarks[Failed], i18n("Evaluation failed") );
+  }
+
+  foreach( KTextEditor::View *view, doc->views() )
+    addView( doc, view );
+
+  refresh();
+}
+
+void ScateLiveDocument::setSession( ScateSession *s )
+{
+  if( s == session ) return;
+  if( session ) {
+    disconnect( session, 0, this, 0 );
+    disconnect( session->evalQueue(), 0, this, 0 );
+  }
+  session = s;
+  connect( session, SIGNAL(evalFinished(int, qint64, bool)),
+           this, SLOT(onEvalFinished(int, qint64, bool)) );
+  connect( session->evalQueue(), SIGNAL(cancelled(int)), this, SLOT(onEvalCancelled(int)) );
+  connect( session, SIGNAL(langSwitched(bool)), this, SLOT(reset()) );
+  connect( session, SIGNAL(destroyed()), this, SLOT(disable()) );
+  // nothing was evaluated by the new session yet
+  reset();
+}
+
+void ScateLiveDocument::disable()
+{
+  clearMarks();
+  // not to be found by of() anymore
+  setParent( 0 );
+  deleteLater();
+}
+
+void ScateLiveDocument::addView( KTextEditor::Document *, KTextEditor::View *view )
+{
+  // the marks are shown in the icon border
+  KTextEditor::ConfigInterface *config = qobject_cast<KTextEditor::ConfigInterface*>( view );
+  if( config ) config->setConfigValue( "icon-bar", true );
+
+  KTextEditor::TextHintInterface *hints = qobject_cast<KTextEditor::TextHintInterface*>( view );
+  if( hints ) {
+    hints->enableTextHints( 500 );
+    connect( view, SIGNAL(needTextHint(const KTextEditor::Cursor&, QString&)),
+             this, SLOT(textHint(const KTextEditor::Cursor&, QString&)) );
+  }
+}
+
+void ScateLiveDocument::scan()
+{
+  blocks.clear();
+  foreach( const KTextEditor::Range &range, index->blocks() ) {
+    Block block;
+    block.range = range;
+    block.hash = QCryptographicHash::hash( doc->text( range ).toUtf8(), QCryptographicHash::Md5 );
+    blocks.append( block );
+  }
+}
+
+void ScateLiveDocument::refresh()
+{
+  scan();
+  updateMarks();
+}
+
+void ScateLiveDocument::evaluateChanged()
+{
+  refreshTimer->stop();
+  scan();
+
+  // only the results of blocks still in the document are kept
+  QHash<QByteArray, Result> current;
+  bool running = true;
+  foreach( const Block &block, blocks ) {
+    Result result = results.value( block.hash );
+    if( result.state == Changed && running ) {
+      ScateSyntaxCheck::Error error;
+      int id = session->eval( doc->text( block.range ), false, &error );
+      if( id >= 0 ) {
+        pending.insert( id, block.hash );
+        result.state = Pending;
+      }
+      else if( error.isValid() ) {
+        error.moveBy( block.range.start().line(), block.range.start().column() );
+        session->sysMsg( error.text() );
+        result.state = Failed;
+        result.error = error.text();
+      }
+      else
+        running = false;
+    }
+    current.insert( block.hash, result );
+  }
+  results = current;
+
+  updateMarks();
+}
+
+void ScateLiveDocument::reset()
+{
+  results.clear();
+  pending.clear();
+  updateMarks();
+}
+
+void ScateLiveDocument::onEvalFinished( int id, qint64 latency, bool failed )
+{
+  QByteArray hash = pending.take( id );
+  if( hash.isEmpty() || !results.contains( hash ) ) return;
+  results[hash] = Result( failed ? Failed : Clean, latency );
+  // otherwise the marks will be updated when the blocks are found again
+  if( !refreshTimer->isActive() ) updateMarks();
+}
+
+void ScateLiveDocument::onEvalCancelled( int id )
+{
+  QByteArray hash = pending.take( id );
+  if( hash.isEmpty() || !results.contains( hash ) ) return;
+  results[hash] = Result( Changed );
+  if( !refreshTimer->isActive() ) updateMarks();
+}
+
+void ScateLiveDocument::clearMarks()
+{
+  MarkInterface *marks = qobject_cast<MarkInterface*>( doc );
+  if( !marks ) return;
+
+  QList<int> lines;
+  foreach( KTextEditor::Mark *mark, marks->marks() )
+    if( mark->type & allStateMarks ) lines.append( mark->line );
+  foreach( int line, lines )
+    marks->removeMark( line, allStateMarks );
+}
+
+void ScateLiveDocument::updateMarks()
+{
+  MarkInterface *marks = qobject_cast<MarkInterface*>( doc );
+  if( !marks ) return;
+
+  clearMarks();
+  foreach( const Block &block, blocks )
+    marks->addMark( block.range.start().line(), stateMarks[ results.value( block.hash ).state ] );
+}
+
+void ScateLiveDocument::textHint( const KTextEditor::Cursor &cursor, QString &text )
+{
+  if( !text.isEmpty() || refreshTimer->isActive() ) return;
+
+  // the last block starting at or before the line
+  int lo = 0;
+  int hi = blocks.count();
+  while( lo < hi ) {
+    int mid = (lo + hi) / 2;
+    if( blocks[mid].range.start().line() <= cursor.line() ) lo = mid + 1;
+    else hi = mid;
+  }
+  if( lo == 0 ) return;
+  const Block &block = blocks[lo - 1];
+  if( block.range.end().line() < cursor.line() ) return;
+
+  Result result = results.value( block.hash );
+  switch( result.state ) {
+    case Changed:
+      text = i18n("Changed since evaluated");
+      break;
+    case Pending:
+      text = i18n("Being evaluated");
+      break;
+    case Clean:
+      text = i18n("Evaluated in %1", ScateEvalTracker::formatLatency( result.latency ));
+      break;
+    case Failed:
+      if( !result.error.isEmpty() )
+        text = result.error;
+      else
+        text = i18n("Failed after %1", ScateEvalTracker::formatLatency( result.latency ));
+      break;
+  }
+}
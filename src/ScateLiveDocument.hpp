@@ -0,0 +1,114 @@
+/*
+#
+# Copyright 2010-2011 Jakob Leben (jakob.leben@gmail.com)
+#
+# This file is part of Scate - a SuperCollider plugin for Kate
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+*/
+
+#ifndef SCATE_LIVE_DOCUMENT_H
+#define SCATE_LIVE_DOCUMENT_H
+
+#include <ktexteditor/range.h>
+
+#include <QObject>
+#include <QHash>
+#include <QList>
+#include <QByteArray>
+
+namespace KTextEditor {
+  class Document;
+  class View;
+}
+class ScateSession;
+class ScateRegionIndex;
+class QTimer;
+
+// Live mode of a document: only the top-level blocks that changed since
+// they were last evaluated are evaluated, when the document is saved or on
+// demand. Blocks are told apart by a hash of their text, so moving a block
+// around does not make it count as changed.
+// Blocks are evaluated by the session the document is bound to.
+// The state of each block is shown by a mark on its first line, and the
+// time its evaluation took in a tooltip over the block.
+// Live mode is enabled by creating the object, which is owned by the
+// document, and disabled with disable().
+
+class ScateLiveDocument : public QObject
+{
+    Q_OBJECT
+
+  public:
+    enum State {
+      Changed,
+      Pending,
+      Clean,
+      Failed
+    };
+
+    ScateLiveDocument( KTextEditor::Document *, ScateSession * );
+
+    // The live mode of a document, or 0 if it is not enabled.
+    static ScateLiveDocument *of( KTextEditor::Document * );
+
+    // Has the blocks evaluated by another session from now on.
+    void setSession( ScateSession * );
+
+  public slots:
+    // Removes the marks and deletes the object.
+    void disable();
+    // Evaluates the blocks that changed since they were last evaluated.
+    void evaluateChanged();
+    // Considers all blocks changed, e.g. after the interpreter restarted.
+    void reset();
+
+  private slots:
+    void refresh();
+    void onEvalFinished( int id, qint64 latency, bool failed );
+    void onEvalCancelled( int id );
+    void addView( KTextEditor::Document *, KTextEditor::View * );
+    void textHint( const KTextEditor::Cursor &, QString & );
+
+  private:
+    struct Block {
+      KTextEditor::Range range;
+      QByteArray hash;
+    };
+
+    struct Result {
+      Result( State s = Changed, qint64 l = 0 ) : state( s ), latency( l ) {}
+      State state;
+      qint64 latency;
+      // the syntax error that kept the block from being evaluated
+      QString error;
+    };
+
+    void scan();
+    void updateMarks();
+    void clearMarks();
+
+    KTextEditor::Document *doc;
+    ScateSession *session;
+    ScateRegionIndex *index;
+    QList<Block> blocks;
+    // by hash of the text of blocks
+    QHash<QByteArray, Result> results;
+    // hashes of blocks being evaluated, by evaluation id
+    QHash<int, QByteArray> pending;
+    QTimer *refreshTimer;
+};
+
+#endif // SCATE_LIVE_DOCUMENT_H
@@ -0,0 +1,73 @@
+/*
+#
+# Copyright 2010-2011 Jakob Leben (jakob.leben@gmail.com)
+#
+# This file is part of Scate - a SuperCollider plugin for Kate
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+*/
+
+#include "ScateOutputBuffer.hpp"
+
+ScateOutputBuffer::ScateOutputBuffer( QObject *parent )
+  : QObject( parent ),
+    pendingChunks( 0 ),
+    _interval( 0 )
+{
+  timer.setSingleShot( true );
+  connect( &timer, SIGNAL(timeout()), this, SLOT(flush()) );
+}
+
+void ScateOutputBuffer::setInterval( int msecs )
+{
+  _interval = qMax( 0, msecs );
+  timer.setInterval( _interval );
+  if( _interval == 0 ) flush();
+}
+
+void ScateOutputBuffer::append( const ScatePostBatch &batch )
+{
+  if( batch.isEmpty() ) return;
+
+  pending.append( batch );
+  ++pendingChunks;
+  ++_stats.chunks;
+  _stats.bytes += batch.bytes;
+  _stats.stderrBytes += batch.stderrBytes;
+  _stats.decodeTime += batch.decodeTime;
+  _stats.dropped += batch.dropped;
+  _stats.spilled += batch.spilled;
+  _stats.blockedTime += batch.blockedTime;
+
+  if( _interval == 0 )
+    flush();
+  else if( !timer.isActive() )
+    timer.start();
+}
+
+void ScateOutputBuffer::flush()
+{
+  timer.stop();
+  if( pending.isEmpty() ) return;
+
+  ++_stats.flushes;
+  _stats.maxChunksPerFlush = qMax( _stats.maxChunksPerFlush, pendingChunks );
+
+  ScatePostBatch batch = pending;
+  pending = ScatePostBatch();
+  pendingChunks = 0;
+
+  emit flushed( batch );
+}
@@ -0,0 +1,71 @@
+/*
+#
+# Copyright 2010-2011 Jakob Leben (jakob.leben@gmail.com)
+#
+# This file is part of Scate - a SuperCollider plugin for Kate
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+*/
+
+#ifndef SCATE_OUTPUT_BUFFER_H
+#define SCATE_OUTPUT_BUFFER_H
+
+#include "ScatePost.hpp"
+
+#include <QObject>
+#include <QTimer>
+
+// Collects interpreter output as it arrives from the process and hands it on
+// at most once per refresh interval, so that a flood of small chunks costs the
+// terminal a single insertion per frame instead of one per chunk.
+
+class ScateOutputBuffer : public QObject
+{
+  Q_OBJECT
+  public:
+    struct Stats {
+      Stats() : chunks(0), bytes(0), stderrBytes(0), decodeTime(0), flushes(0), maxChunksPerFlush(0),
+        dropped(0), spilled(0), blockedTime(0) {}
+      quint64 chunks;
+      quint64 bytes;
+      quint64 stderrBytes;
+      qint64 decodeTime;
+      quint64 flushes;
+      int maxChunksPerFlush;
+      quint64 dropped;
+      quint64 spilled;
+      qint64 blockedTime;
+    };
+
+    ScateOutputBuffer( QObject *parent = 0 );
+    // 0 disables coalescing: every chunk is flushed immediately.
+    void setInterval( int msecs );
+    inline int interval() const { return _interval; }
+    inline const Stats & stats() const { return _stats; }
+    inline bool isEmpty() const { return pending.isEmpty(); }
+  signals:
+    void flushed( const ScatePostBatch & );
+  public slots:
+    void append( const ScatePostBatch & );
+    void flush();
+  private:
+    ScatePostBatch pending;
+    int pendingChunks;
+    int _interval;
+    QTimer timer;
+    Stats _stats;
+};
+
+#endif // SCATE_OUTPUT_BUFFER_H
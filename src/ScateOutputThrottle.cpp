@@ -0,0 +1,127 @@
+/*
+#
+# Copyright 2010-2011 Jakob Leben (jakob.leben@gmail.com)
+#
+# This file is part of Scate - a SuperCollider plugin for Kate
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+*/
+
+#include "ScateOutputThrottle.hpp"
+
+static const int measureInterval = 250;
+static const int quietTicksToResume = 4;
+// bytes per line assumed for the rate of bytes
+static const int typicalLineBytes = 80;
+
+ScateOutputThrottle::ScateOutputThrottle( QObject *parent )
+  : QObject( parent ),
+    windowLines( 0 ),
+    windowBytes( 0 ),
+    lineRate( 0 ),
+    byteRate( 0 ),
+    threshold( 0 ),
+    armed( true ),
+    paused( false ),
+    quietTicks( 0 ),
+    suppressed( 0 ),
+    total( 0 )
+{
+  ticker.setInterval( measureInterval );
+  connect( &ticker, SIGNAL(timeout()), this, SLOT(measure()) );
+  window.start();
+}
+
+void ScateOutputThrottle::setThreshold( int linesPerSecond )
+{
+  threshold = qMax( 0, linesPerSecond );
+  if( threshold == 0 ) resume();
+}
+
+bool ScateOutputThrottle::pass( const ScatePostBatch &batch )
+{
+  if( window.elapsed() > 4 * measureInterval && !paused ) {
+    // output after a quiet period; start measuring afresh
+    window.restart();
+    windowLines = windowBytes = 0;
+  }
+
+  int lines = 0;
+  foreach( const ScatePostLine &line, batch.lines )
+    if( line.complete ) ++lines;
+  windowLines += lines;
+  windowBytes += batch.bytes;
+
+  if( window.elapsed() >= measureInterval ) measure();
+
+  if( !paused ) return true;
+  suppressed += batch.lines.count();
+  total += batch.lines.count();
+  return false;
+}
+
+void ScateOutputThrottle::measure()
+{
+  qint64 elapsed = window.restart();
+  if( elapsed <= 0 ) return;
+  lineRate = windowLines * 1000.0 / elapsed;
+  byteRate = windowBytes * 1000.0 / elapsed;
+  windowLines = windowBytes = 0;
+
+  if( threshold == 0 ) return;
+
+  if( !paused ) {
+    if( !isFlooding( 1.0 ) ) {
+      armed = true;
+      return;
+    }
+    if( !armed ) return;
+    paused = true;
+    suppressed = 0;
+    quietTicks = 0;
+    ticker.start();
+  }
+
+  emit suppressing( suppressed, lineRate, byteRate );
+
+  if( !isFlooding( 0.5 ) ) {
+    if( ++quietTicks >= quietTicksToResume ) finishPause();
+  }
+  else
+    quietTicks = 0;
+}
+
+bool ScateOutputThrottle::isFlooding( double share ) const
+{
+  return lineRate >= share * threshold
+    || byteRate >= share * threshold * typicalLineBytes;
+}
+
+void ScateOutputThrottle::resume()
+{
+  if( !paused ) return;
+  // let the user see the output, even if it keeps flooding
+  armed = false;
+  finishPause();
+}
+
+void ScateOutputThrottle::finishPause()
+{
+  paused = false;
+  ticker.stop();
+  qint64 lines = suppressed;
+  suppressed = 0;
+  emit resumed( lines );
+}
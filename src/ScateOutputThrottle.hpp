@@ -0,0 +1,79 @@
+/*
+#
+# Copyright 2010-2011 Jakob Leben (jakob.leben@gmail.com)
+#
+# This file is part of Scate - a SuperCollider plugin for Kate
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+*/
+
+#ifndef SCATE_OUTPUT_THROTTLE_H
+#define SCATE_OUTPUT_THROTTLE_H
+
+#include "ScatePost.hpp"
+
+#include <QObject>
+#include <QTimer>
+#include <QElapsedTimer>
+
+// Measures the rate of interpreter output and pauses its display while the
+// rate exceeds a threshold, so that a runaway loop does not keep the
+// terminal busy. The threshold is in lines, but output posted without line
+// breaks is caught by its rate of bytes, against the threshold in lines of
+// a typical length. While paused, output is counted as suppressed instead
+// of displayed, each fragment of an open line as a line. Display resumes by itself once the rate has stayed well below
+// the threshold for a second, or when resume() is called; after a manual
+// resume, display is not paused again until the rate has dropped.
+
+class ScateOutputThrottle : public QObject
+{
+  Q_OBJECT
+  public:
+    ScateOutputThrottle( QObject *parent = 0 );
+    // 0 never pauses.
+    void setThreshold( int linesPerSecond );
+    // Accounts for a batch of output and tells whether to display it.
+    bool pass( const ScatePostBatch & );
+    inline bool isPaused() const { return paused; }
+    inline quint64 totalSuppressed() const { return total; }
+  public slots:
+    void resume();
+  signals:
+    // emitted regularly while paused
+    void suppressing( qint64 lines, double linesPerSecond, double bytesPerSecond );
+    void resumed( qint64 lines );
+  private slots:
+    void measure();
+  private:
+    void finishPause();
+    // the rate of lines or of bytes is at or above the given share of the
+    // threshold
+    bool isFlooding( double share ) const;
+
+    QTimer ticker;
+    QElapsedTimer window;
+    qint64 windowLines;
+    qint64 windowBytes;
+    double lineRate;
+    double byteRate;
+    int threshold;
+    bool armed;
+    bool paused;
+    int quietTicks;
+    qint64 suppressed;
+    quint64 total;
+};
+
+#endif // SCATE_OUTPUT_THROTTLE_H
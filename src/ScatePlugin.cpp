@@ -20,30 +20,30 @@
 */
 
 #include "ScatePlugin.hpp"
+#include "ScateSession.hpp"
+#include "ScateSettings.hpp"
+#include "ScateHelpIndex.hpp"
+#include "ScateHelpSearch.hpp"
+#include "ScateHelpRenderer.hpp"
+#include "ScateHelpBundle.hpp"
 #include "ScateView.hpp"
 #include "ScateConfigPage.hpp"
+#include "ScateLiveDocument.hpp"
+#include "ScateEvalTracker.hpp"
 
 #include <kaboutdata.h>
 #include <kstandarddirs.h>
-#include <kconfiggroup.h>
 #include <kate/application.h>
 #include <kate/documentmanager.h>
 
-#include <cstdio>
+#include <QStringList>
+#include <QFile>
+#include <QtConcurrentRun>
 
-SCProcess::SCProcess( QObject *parent ) : QProcess( parent )
-{
-  connect( this, SIGNAL( readyRead() ), this, SLOT( onReadyRead() ) );
-}
-
-void SCProcess::onReadyRead()
-{
-  QByteArray bytes = readAll();
-  if( bytes.isEmpty() ) return;
-  emit scSays( QString::fromUtf8(bytes) );
-}
+#include <unistd.h>
 
 K_PLUGIN_FACTORY_DEFINITION(ScatePluginFactory, registerPlugin<ScatePlugin>();)
+
 K_EXPORT_PLUGIN( ScatePluginFactory( KAboutData("katescateplugin", 0,
                                                 ki18n("Scate"),
                                                 "0.9.5-dev",
@@ -51,25 +51,40 @@ K_EXPORT_PLUGIN( ScatePluginFactory( KAboutData("katescateplugin", 0,
 
 ScatePlugin::ScatePlugin( QObject* parent, const QList<QVariant>& )
     : Kate::Plugin( (Kate::Application*)parent, "kate-scate-plugin" ),
-    scProcess( new SCProcess( this ) ),
+    _settings( 0 ),
+    _helpIndex( 0 ),
+    _helpSearch( 0 ),
+    _helpRenderer( 0 ),
+    _helpBundle( 0 ),
     _iconPath( KStandardDirs::locate( "data", "kate/plugins/katescate/supercollider.png" ) ),
-    restart( false )
+    memoryBefore( residentMemory() )
 {
-  connect( scProcess, SIGNAL( started() ), this, SLOT( scStarted() ) );
-  connect( scProcess, SIGNAL( finished( int, QProcess::ExitStatus ) ),
-           this, SLOT( scFinished( int, QProcess::ExitStatus ) ) );
-  connect( scProcess, SIGNAL( scSays( const QString& ) ),
-           this, SIGNAL( scSaid( const QString& ) ) );
+  qint64 start = ScateEvalTracker::now();
+  for( int i = 0; i < StartupPartCount; ++i ) {
+    startupTime[i] = startupMemory[i] = 0;
+    startupCount[i] = 0;
+  }
+
+  qRegisterMetaType<ScatePostBatch>( "ScatePostBatch" );
+  _settings = new ScateSettings( this );
+  connect( _settings, SIGNAL(sessionsChanged()), this, SLOT(updateSessions()) );
+  connect( &helpJob, SIGNAL(finished()), this, SLOT(onHelpJobFinished()) );
+  updateSessions();
   connect( application()->documentManager(), SIGNAL(documentCreated (KTextEditor::Document *)),
            this, SLOT(onDocumentCreated(KTextEditor::Document *)) );
-  KConfigGroup config(KGlobal::config(), "Scate");
-  bool b_startLang = config.readEntry( "StartLang", false );
-  if( b_startLang )
-    startLang();
+  foreach( KTextEditor::Document *doc, application()->documentManager()->documents() )
+    connect( doc, SIGNAL(documentSavedOrUploaded(KTextEditor::Document*, bool)),
+             this, SLOT(onDocumentSaved(KTextEditor::Document*)) );
+  if( _settings->startLang() )
+    defaultSession()->startLang();
+
+  addStartupCost( PluginPart, ScateEvalTracker::now() - start, residentMemory() - memoryBefore );
 }
 
 ScatePlugin::~ScatePlugin()
 {
+  // the bundle being written is left complete
+  helpJob.waitForFinished();
 }
 
 Kate::PluginView *ScatePlugin::createView( Kate::MainWindow *mainWindow )
@@ -95,165 +110,178 @@ Kate::PluginConfigPage * ScatePlugin::configPage (uint number=0, QWidget *parent
 
 void ScatePlugin::applyConfig()
 {
-  Q_EMIT( configChanged() );
+  _settings->load();
 }
 
-void ScatePlugin::startLang()
+ScateHelpIndex *ScatePlugin::helpIndex()
 {
-  QProcess::ProcessState state = scProcess->state();
-  if( state == QProcess::Starting ) {
-      printf("\nInterpreter already starting.\n\n");
-      return;
-  }
-  else if( state == QProcess::Running ) {
-      printf("\nInterpreter already running.\n\n");
-      return;
-  }
-  else if( state != QProcess::NotRunning ) {
-    return;
-  }
-
-  sysMsg( "Interpreter starting." );
-
-  KConfigGroup config(KGlobal::config(), "Scate");
-  QString exe = config.readEntry( "ScLangExecutable", QString() );
-  QString rtDir = config.readEntry( "RuntimeDataDir", QString() );
-
-  QString cmd = exe.isEmpty() ? tr( "sclang" ) : exe;
-  cmd += tr( " -i scate" );
-  if( !rtDir.isEmpty() ) cmd.append( " -d " ).append( rtDir );
-
-  printf("Trying to start with command:\n");
-  printf( "%s\n", cmd.toStdString().c_str() );
-
-  scProcess->start( cmd );
+  if( !_helpIndex ) _helpIndex = new ScateHelpIndex( _settings, this );
+  return _helpIndex;
 }
 
-void ScatePlugin::stopLang()
+ScateHelpSearch *ScatePlugin::helpSearch()
 {
-  scProcess->closeWriteChannel();
+  if( !_helpSearch ) _helpSearch = new ScateHelpSearch( helpIndex(), this );
+  return _helpSearch;
 }
 
-void ScatePlugin::sysMsg( const QString &msg )
+ScateHelpRenderer *ScatePlugin::helpRenderer()
 {
-  emit scSaid(tr("\n") + msg + tr("\n\n"));
+  if( !_helpRenderer ) _helpRenderer = new ScateHelpRenderer( helpIndex(), this );
+  return _helpRenderer;
 }
 
-void ScatePlugin::scStarted()
+ScateHelpBundle *ScatePlugin::helpBundle()
 {
-  emit langSwitched( true );
-}
-
-void ScatePlugin::scFinished( int exitCode, QProcess::ExitStatus exitStatus )
-{
-  Q_UNUSED( exitCode );
-  QString msg;
-  switch( exitStatus ) {
-    /*case QProcess::CrashExit:
-      msg = "ERROR: Interpreter crashed!"; break;*/
-    case QProcess::NormalExit:
-    default:
-      msg = "Interpreter stopped.";
-  }
-
-  sysMsg( msg );
-  emit( langSwitched( false ) );
-  emit( serverSwitched( false ) );
-
-  if( restart ) {
-    restart = false;
-    startLang();
+  if( !_helpBundle ) {
+    _helpBundle = new ScateHelpBundle( ScateHelpBundle::defaultFileName(), this );
+    _helpBundle->open();
   }
+  return _helpBundle;
 }
 
-void ScatePlugin::startServer()
+bool ScatePlugin::packHelpFiles( bool compress )
 {
-  eval( "Server.default.boot;", true );
-  emit( serverSwitched( true ) );
+  if( helpJob.isRunning() ) return false;
+  helpJob.setFuture( QtConcurrent::run( ScateHelpBundle::pack, _settings->helpDirs(),
+                                        ScateHelpBundle::defaultFileName(), compress ) );
+  return true;
 }
 
-void ScatePlugin::stopServer()
+bool ScatePlugin::benchmarkHelpLoading( const QStringList &pages )
 {
-  eval( "Server.default.quit;", true );
-  emit( serverSwitched( false ) );
+  if( helpJob.isRunning() ) return false;
+  helpJob.setFuture( QtConcurrent::run( ScateHelpBundle::benchmark, pages,
+                                        ScateHelpBundle::defaultFileName() ) );
+  return true;
 }
 
-void ScatePlugin::startSwingOSC()
+void ScatePlugin::onHelpJobFinished()
 {
-  KConfigGroup config(KGlobal::config(), "Scate");
-  QString swingosc = config.readEntry( "SwingOscProgram", QString() );
-  eval( QString("SwingOSC.program=\"%1\";").arg( swingosc ), true );
-  eval( "SwingOSC.default.boot;", true );
+  // a new bundle replaced the file
+  helpBundle()->open();
+  emit helpJobFinished( helpJob.result() );
 }
 
-void ScatePlugin::stopSwingOSC()
+QString ScatePlugin::helpStatistics() const
 {
-  eval( "SwingOSC.default.quit;", true );
+  if( !_helpIndex ) return QString("Help index: not used yet");
+  QString msg = _helpIndex->statistics();
+  if( _helpSearch ) msg += "\n" + _helpSearch->statistics();
+  if( _helpRenderer ) msg += "\n" + _helpRenderer->statistics();
+  if( _helpBundle ) msg += "\n" + _helpBundle->statistics();
+  return msg;
 }
 
-void ScatePlugin::onDocumentCreated( KTextEditor::Document *doc )
+void ScatePlugin::updateSessions()
 {
-  if( doc->highlightingMode() == "None" )
-    doc->setHighlightingMode("SuperCollider");
+  QStringList names = _settings->sessions();
+  names.prepend( ScateSession::defaultName() );
+
+  QList<ScateSession*> sessions;
+  foreach( const QString &name, names ) {
+    ScateSession *s = session( name );
+    if( !s ) s = new ScateSession( name, _settings, this );
+    sessions.append( s );
+  }
+  QList<ScateSession*> removed;
+  foreach( ScateSession *s, _sessions )
+    if( !sessions.contains( s ) ) removed.append( s );
+  bool changed = sessions != _sessions;
+  _sessions = sessions;
+
+  // documents of a removed session go back to the default one
+  foreach( KTextEditor::Document *doc, application()->documentManager()->documents() ) {
+    QString name = doc->property( "ScateSession" ).toString();
+    if( !name.isEmpty() && !session( name ) ) bind( doc, defaultSession() );
+  }
+  if( changed ) emit sessionsChanged();
+  foreach( ScateSession *s, removed ) {
+    s->stopLang();
+    s->deleteLater();
+  }
 }
 
-void ScatePlugin::switchLang( bool on )
+ScateSession *ScatePlugin::session( const QString &name ) const
 {
-  restart = false;
-  if( on ) startLang();
-  else stopLang();
+  foreach( ScateSession *s, _sessions )
+    if( s->name() == name ) return s;
+  return 0;
 }
 
-void ScatePlugin::switchServer( bool on )
+ScateSession *ScatePlugin::sessionOf( KTextEditor::Document *doc ) const
 {
-  if( on ) startServer();
-  else stopServer();
+  ScateSession *s = doc ? session( doc->property( "ScateSession" ).toString() ) : 0;
+  return s ? s : defaultSession();
 }
 
-void ScatePlugin::switchSwingOsc( bool on )
+void ScatePlugin::bind( KTextEditor::Document *doc, ScateSession *s )
 {
-  if( on ) startSwingOSC();
-  else stopSwingOSC();
+  doc->setProperty( "ScateSession", s->name() );
+  ScateLiveDocument *live = ScateLiveDocument::of( doc );
+  if( live ) live->setSession( s );
+  emit documentBound( doc );
 }
 
-void ScatePlugin::stopProcessing()
+void ScatePlugin::addStartupCost( StartupPart part, qint64 nsecs, qint64 memory )
 {
-  eval( "thisProcess.stop;", true );
-  sysMsg( "All processing stopped." );
+  startupTime[part] += nsecs;
+  startupMemory[part] += memory;
+  ++startupCount[part];
 }
 
-void ScatePlugin::switchToQt() {
-  eval( "GUI.qt" );
-}
-
-void ScatePlugin::switchToSwing() {
-  eval( "GUI.swing" );
-}
-
-void ScatePlugin::eval( const QString& cmd, bool silent )
+QString ScatePlugin::startupStatistics() const
 {
-  if( !langRunning() ) {
-    sysMsg( "Interpreter not running!" );
-    return;
+  const char *names[] = { "plugin", "main windows", "SC Terminal", "SC Help" };
+  int windows = startupCount[WindowPart];
+  QString msg("Startup cost (time, resident memory added):\n");
+  for( int i = 0; i < StartupPartCount; ++i ) {
+    msg += QString("  %1: ").arg( names[i] );
+    if( i == TerminalPart || i == HelpPart )
+      msg += QString("created for %1 of %2 windows when first shown")
+        .arg( startupCount[i] ).arg( windows );
+    else if( i == WindowPart )
+      msg += QString("%1 set up").arg( windows );
+    else
+      msg += "loaded";
+    if( startupCount[i] ) {
+      msg += QString(", %1, %2 KiB")
+        .arg( ScateEvalTracker::formatLatency( startupTime[i] ) )
+        .arg( startupMemory[i] / 1024 );
+    }
+    msg += "\n";
   }
-
-  QString str = cmd + ( silent ? "\x1b" : "\x0c" );
-  scProcess->write( str.toUtf8() );
+  if( memoryBefore >= 0 ) {
+    msg += QString("  resident memory before the plugin was set up: %1 MiB, now: %2 MiB")
+      .arg( memoryBefore / 1048576.0, 0, 'f', 1 )
+      .arg( residentMemory() / 1048576.0, 0, 'f', 1 );
+  }
+  else
+    msg.chop( 1 );
+  return msg;
 }
 
-void ScatePlugin::restartLang()
+qint64 ScatePlugin::residentMemory()
 {
-  restart = true;
-  stopLang();
+  // the second field is the resident set size in pages
+  QFile statm( "/proc/self/statm" );
+  if( !statm.open( QIODevice::ReadOnly ) ) return -1;
+  QList<QByteArray> fields = statm.readAll().split( ' ' );
+  if( fields.count() < 2 ) return -1;
+  return fields[1].toLongLong() * ::sysconf( _SC_PAGESIZE );
 }
 
-void ScatePlugin::recompileLibrary()
+void ScatePlugin::onDocumentSaved( KTextEditor::Document *doc )
 {
-  scProcess->write( "\x18" );
+  if( doc->url().fileName().endsWith( ".sc" ) ) {
+    foreach( ScateSession *s, _sessions ) s->classFileSaved();
+  }
 }
 
-bool ScatePlugin::langRunning()
-{ return scProcess->state() != QProcess::NotRunning; }
-
-bool ScatePlugin::serverRunning()
-{ return false; }
+void ScatePlugin::onDocumentCreated( KTextEditor::Document *doc )
+{
+  connect( doc, SIGNAL(documentSavedOrUploaded(KTextEditor::Document*, bool)),
+           this, SLOT(onDocumentSaved(KTextEditor::Document*)) );
+  if( doc->highlightingMode() == "None" )
+    doc->setHighlightingMode("SuperCollider");
+}
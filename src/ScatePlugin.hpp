@@ -27,9 +27,16 @@
 #include <kate/plugin.h>
 #include <kate/pluginconfigpageinterface.h>
 
-#include <QProcess>
+#include <QList>
+#include <QStringList>
+#include <QFutureWatcher>
 
-class SCProcess;
+class ScateSession;
+class ScateSettings;
+class ScateHelpIndex;
+class ScateHelpSearch;
+class ScateHelpRenderer;
+class ScateHelpBundle;
 
 class  ScatePlugin :
   public Kate::Plugin,
@@ -49,55 +56,82 @@ class  ScatePlugin :
     QString configPageName (uint number) const;
     Kate::PluginConfigPage * configPage (uint number, QWidget *parent, const char *name);
 
+    // Reloads the settings after the configuration changed.
     void applyConfig();
 
-    bool langRunning();
-    bool serverRunning();
     inline QString iconPath() { return _iconPath; }
+    inline ScateSettings *settings() const { return _settings; }
+    // The help file index, built when first asked for.
+    ScateHelpIndex *helpIndex();
+    // The full text search over the help files, built when first asked for.
+    ScateHelpSearch *helpSearch();
+    // Renders .schelp help sources, created when first asked for.
+    ScateHelpRenderer *helpRenderer();
+    // The packed help files, opened when first asked for.
+    ScateHelpBundle *helpBundle();
+    // Pack the help directories into the help bundle, or time loading the
+    // given help pages from the bundle and from their files, in the
+    // background. Return false without starting if either is running
+    // already; helpJobFinished() is emitted when done.
+    bool packHelpFiles( bool compress );
+    bool benchmarkHelpLoading( const QStringList &pages );
+    inline bool isHelpJobRunning() const { return helpJob.isRunning(); }
+    QString helpStatistics() const;
+
+    inline const QList<ScateSession*> &sessions() const { return _sessions; }
+    inline ScateSession *defaultSession() const { return _sessions.first(); }
+    // The session of the given name, or 0.
+    ScateSession *session( const QString &name ) const;
+    // The session a document is bound to; the default one unless bound
+    // otherwise.
+    ScateSession *sessionOf( KTextEditor::Document * ) const;
+    // Has the code of a document evaluated by a session.
+    void bind( KTextEditor::Document *, ScateSession * );
+
+    // What setting up parts of the plugin cost, measured to keep Kate's
+    // startup lean.
+    enum StartupPart {
+      PluginPart,
+      WindowPart,
+      TerminalPart,
+      HelpPart,
+      StartupPartCount
+    };
+    void addStartupCost( StartupPart, qint64 nsecs, qint64 memory );
+    QString startupStatistics() const;
+    // Resident memory of Kate in bytes, or -1 if unknown.
+    static qint64 residentMemory();
 
   signals:
-    void scSaid( const QString& );
-    void langSwitched( bool );
-    void serverSwitched( bool );
-    void swingOscSwitched( bool );
-    void configChanged();
+    // sessions were added or removed
+    void sessionsChanged();
+    void documentBound( KTextEditor::Document * );
+    // Packing or benchmarking the help bundle is done, with a message
+    // telling how it went; the bundle was opened again.
+    void helpJobFinished( const QString &message );
 
   public slots:
     void onDocumentCreated(KTextEditor::Document *);
-    void switchLang( bool );
-    void switchServer( bool );
-    void switchSwingOsc( bool );
-    void restartLang();
-    void recompileLibrary();
-    void startServer();
-    void stopServer();
-    void startSwingOSC();
-    void stopSwingOSC();
-    void eval( const QString&, bool silent = false );
-    void stopProcessing();
-    void switchToQt();
-    void switchToSwing();
   private slots:
-    void scStarted();
-    void scFinished( int, QProcess::ExitStatus );
+    void onDocumentSaved( KTextEditor::Document * );
+    // Creates and removes sessions to match the settings.
+    void updateSessions();
+    void onHelpJobFinished();
   private:
-    void startLang();
-    void stopLang();
-    void sysMsg( const QString & );
-    SCProcess *scProcess;
+    ScateSettings *_settings;
+    ScateHelpIndex *_helpIndex;
+    ScateHelpSearch *_helpSearch;
+    ScateHelpRenderer *_helpRenderer;
+    ScateHelpBundle *_helpBundle;
+    // packing or benchmarking the help bundle
+    QFutureWatcher<QString> helpJob;
+    QList<ScateSession*> _sessions;
     QString _iconPath;
-    bool restart;
-};
-
-class SCProcess : public QProcess
-{
-  Q_OBJECT
-  public:
-    SCProcess( QObject *parent = 0 );
-  signals:
-    void scSays( const QString& str );
-  private slots:
-    void onReadyRead();
+    // resident memory before the plugin was set up
+    qint64 memoryBefore;
+    qint64 startupTime[StartupPartCount];
+    qint64 startupMemory[StartupPartCount];
+    int startupCount[StartupPartCount];
 };
 
 K_PLUGIN_FACTORY_DECLARATION( ScatePluginFactory );
@@ -0,0 +1,165 @@
+/*
+#
+# Copyright 2010-2011 Jakob Leben (jakob.leben@gmail.com)
+#
+# This file is part of Scate - a SuperCollider plugin for Kate
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+*/
+
+#include "ScatePost.hpp"
+
+#include <QStringList>
+
+void ScatePostBatch::append( const ScatePostBatch &other )
+{
+  bytes += other.bytes;
+  decodeTime += other.decodeTime;
+  stderrBytes += other.stderrBytes;
+  dropped += other.dropped;
+  spilled += other.spilled;
+  blockedTime += other.blockedTime;
+  if( other.lines.isEmpty() && other.acks.isEmpty() ) return;
+
+  QList<ScatePostLine>::const_iterator it = other.lines.constBegin();
+  int offset = lines.count();
+  if( !lines.isEmpty() && !lines.last().complete && it != other.lines.constEnd() ) {
+    ScatePostLine &open = lines.last();
+    open.text += it->text;
+    open.kind = it->kind;
+    open.folded = it->folded;
+    open.complete = it->complete;
+    ++it;
+    --offset;
+  }
+  for( ; it != other.lines.constEnd(); ++it )
+    lines.append( *it );
+
+  foreach( ScateEvalAck ack, other.acks ) {
+    ack.after = qMax( 0, ack.after + offset );
+    acks.append( ack );
+  }
+}
+
+QString ScatePostBatch::text() const
+{
+  QString str;
+  foreach( const ScatePostLine &line, lines ) {
+    str += line.text;
+    if( line.complete ) str += QChar('\n');
+  }
+  return str;
+}
+
+ScatePostBatch ScatePostBatch::fromText( const QString &str, ScatePostLine::Kind kind )
+{
+  ScatePostBatch batch;
+  QStringList parts = str.split( QChar('\n') );
+  int last = parts.count() - 1;
+  for( int i = 0; i < last; ++i )
+    batch.lines.append( ScatePostLine( parts[i], kind, true ) );
+  if( !parts[last].isEmpty() )
+    batch.lines.append( ScatePostLine( parts[last], kind, false ) );
+  return batch;
+}
+
+static bool startsWith( const QChar *str, int length, const char *prefix )
+{
+  int i = 0;
+  for( ; prefix[i]; ++i ) {
+    if( i == length || str[i].toUpper() != QLatin1Char( prefix[i] ) )
+      return false;
+  }
+  return true;
+}
+
+static bool isSeparator( const QChar *str, int length )
+{
+  if( length < 5 ) return false;
+  for( int i = 0; i < length; ++i )
+    if( str[i] != QLatin1Char('-') ) return false;
+  return true;
+}
+
+// Lines of an error dump: the receiver, arguments and call stack, and
+// whatever is indented below them, e.g. the source of a parse error.
+static bool isDumpLine( const QChar *str, int length )
+{
+  static const char *headers[] = {
+    "RECEIVER:", "ARGS:", "KEYWORD ARGS:", "PATH:", "CALL STACK:",
+    "PROTECTED CALL STACK:", "INSTANCE OF ", "CLASS ", "META_", "}",
+    "PERHAPS YOU ", 0
+  };
+  if( length == 0 || str[0] == QLatin1Char(' ') || str[0] == QLatin1Char('\t') )
+    return true;
+  for( int i = 0; headers[i]; ++i )
+    if( startsWith( str, length, headers[i] ) ) return true;
+  return false;
+}
+
+static ScatePostLine::Kind plainKind( const QChar *str, int length )
+{
+  if( startsWith( str, length, "ERROR" ) )
+    return ScatePostLine::Error;
+  if( startsWith( str, length, "WARNING" ) )
+    return ScatePostLine::Warning;
+  if( startsWith( str, length, "-> " ) )
+    return ScatePostLine::Result;
+  if( startsWith( str, length, "LATE " ) || startsWith( str, length, "LATE:" ) )
+    return ScatePostLine::Late;
+  return ScatePostLine::Normal;
+}
+
+void ScatePostClassifier::classify( const QChar *str, int length, ScatePostLine &line )
+{
+  State next = state;
+  line.folded = false;
+
+  if( state == AfterDump && startsWith( str, length, "RECEIVER:" ) ) {
+    // summary of the receiver after the end of the dump
+    line.kind = ScatePostLine::Error;
+    line.folded = true;
+    next = Plain;
+  }
+  else if( state == InError
+           && !startsWith( str, length, "ERROR" )
+           && !startsWith( str, length, "WARNING" )
+           && !startsWith( str, length, "-> " )
+           // an error without a dump ends with the first line not fitting one
+           && ( reasonLines > 0 || isDumpLine( str, length )
+                || startsWith( str, length, "^^" ) || isSeparator( str, length ) ) )
+  {
+    line.folded = true;
+    if( line.complete && reasonLines > 0 ) --reasonLines;
+    if( startsWith( str, length, "^^" ) ) {
+      // "^^ The preceding error dump is for ERROR: ..."
+      line.kind = ScatePostLine::Error;
+      next = AfterDump;
+    }
+    else {
+      line.kind = ScatePostLine::Backtrace;
+      // parse errors end with a line of dashes
+      if( isSeparator( str, length ) ) next = Plain;
+    }
+  }
+  else {
+    line.kind = plainKind( str, length );
+    next = line.kind == ScatePostLine::Error ? InError : Plain;
+    // a failed primitive tells the reason on the next line
+    reasonLines = startsWith( str, length, "ERROR: PRIMITIVE" ) ? 1 : 0;
+  }
+
+  if( line.complete ) state = next;
+}
@@ -0,0 +1,130 @@
+/*
+#
+# Copyright 2010-2011 Jakob Leben (jakob.leben@gmail.com)
+#
+# This file is part of Scate - a SuperCollider plugin for Kate
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+*/
+
+#ifndef SCATE_POST_H
+#define SCATE_POST_H
+
+#include <QString>
+#include <QList>
+#include <QMetaType>
+
+// A line of interpreter output, or a fragment of one.
+// Lines are classified as a whole: when a line arrives in several fragments,
+// every fragment carries the kind of the line as known so far.
+
+struct ScatePostLine
+{
+  enum Kind {
+    Normal,
+    Warning,
+    Error,
+    Late,       // "late 0.123" messages about scheduling
+    Backtrace,  // lines of an error dump following the error message
+    Result,     // "-> " echo of an evaluation result
+    Stderr      // other output to standard error
+  };
+
+  ScatePostLine() : kind( Normal ), folded( false ), complete( true ) {}
+  ScatePostLine( const QString &text_, Kind kind_, bool complete_ = true )
+    : text( text_ ), kind( kind_ ), folded( false ), complete( complete_ ) {}
+
+  QString text;
+  Kind kind;
+  // true if the line belongs to the dump of the nearest preceding error
+  bool folded;
+  // false if the line continues in the next fragment
+  bool complete;
+};
+
+// Acknowledgement of an evaluation, found in the interpreter's output.
+
+struct ScateEvalAck
+{
+  ScateEvalAck( int id_ = 0, qint64 time_ = 0, int after_ = 0 )
+    : id( id_ ), time( time_ ), after( after_ ) {}
+  int id;
+  // monotonic time of arrival, in nanoseconds (see ScateEvalTracker::now())
+  qint64 time;
+  // number of lines of the batch that precede the acknowledgement
+  int after;
+  // text to show next to the line that precedes it
+  QString note;
+};
+
+struct ScatePostBatch
+{
+  ScatePostBatch() : bytes( 0 ), decodeTime( 0 ), stderrBytes( 0 ), dropped( 0 ), spilled( 0 ), blockedTime( 0 ) {}
+
+  // Appends the lines of another batch, joining a trailing fragment
+  // of this batch with the leading fragment of the other one.
+  void append( const ScatePostBatch & );
+  // The plain text of the batch, with line breaks restored.
+  QString text() const;
+  inline bool isEmpty() const { return lines.isEmpty() && acks.isEmpty(); }
+
+  static ScatePostBatch fromText( const QString &,
+                                  ScatePostLine::Kind kind = ScatePostLine::Normal );
+
+  QList<ScatePostLine> lines;
+  QList<ScateEvalAck> acks;
+  // amount of raw interpreter output the batch was decoded from
+  int bytes;
+  // nanoseconds spent decoding it
+  qint64 decodeTime;
+  // part of 'bytes' that was read from standard error
+  int stderrBytes;
+  // lines dropped because the receiver did not keep up
+  int dropped;
+  // bytes that were passed through a temporary file for the same reason
+  qint64 spilled;
+  // nanoseconds the interpreter's output was left unread for the same reason
+  qint64 blockedTime;
+};
+
+Q_DECLARE_METATYPE( ScatePostBatch )
+
+// Classifies lines of interpreter output in a single pass, as they arrive.
+// Error messages are followed by a dump of the receiver, arguments and call
+// stack, which is recognized up to its end and marked as folded into the
+// error. An error without a dump ends at the first line that is not part
+// of one, so that later output is not folded into it.
+
+class ScatePostClassifier
+{
+  public:
+    ScatePostClassifier() : state( Plain ), reasonLines( 0 ) {}
+    // Sets kind and folded of a line. For incomplete lines, the state is
+    // left untouched, so that the line can be classified again when complete.
+    void classify( const QChar *text, int length, ScatePostLine &line );
+    inline void reset() { state = Plain; }
+  private:
+    enum State {
+      Plain,
+      InError,
+      AfterDump
+    };
+    State state;
+    // lines after the error message that belong to it without being part
+    // of a dump
+    int reasonLines;
+};
+
+#endif // SCATE_POST_H
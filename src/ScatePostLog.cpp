@@ -0,0 +1,312 @@
+/*
+#
+# Copyright 2010-2011 Jakob Leben (jakob.leben@gmail.com)
+#
+# This file is part of Scate - a SuperCollider plugin for Kate
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+*/
+
+#include "ScatePostLog.hpp"
+
+#include <kstandarddirs.h>
+
+#include <QDir>
+#include <QDateTime>
+#include <QStringList>
+
+#include <cstring>
+
+static const uchar foldedFlag = 0x80;
+static const int kindShift = 56;
+static const quint64 offsetMask = ( quint64(1) << kindShift ) - 1;
+
+ScatePostLog::ScatePostLog( const QString &subdir ) :
+  dir( subdir.isEmpty() ? directory()
+       : KStandardDirs::locateLocal( "data", "kate/plugins/katescate/logs/"
+                                     + QString( subdir ).replace( QChar('/'), QChar('_') )
+                                     + '/' ) ),
+  openTime( 0 ),
+  hasOpenLine( false ),
+  enabled( true ),
+  failed( false ),
+  maxSize( 32 * 1024 * 1024 ),
+  maxFiles( 10 )
+{}
+
+ScatePostLog::~ScatePostLog()
+{
+  close();
+}
+
+QString ScatePostLog::directory()
+{
+  return KStandardDirs::locateLocal( "data", "kate/plugins/katescate/logs/" );
+}
+
+QString ScatePostLog::indexFileName( const QString &logFileName )
+{
+  QString name = logFileName;
+  if( name.endsWith( ".log" ) ) name.chop( 4 );
+  return name + ".idx";
+}
+
+void ScatePostLog::setEnabled( bool b )
+{
+  enabled = b;
+  failed = false;
+  if( !enabled ) close();
+}
+
+void ScatePostLog::setLimits( qint64 maxFileSize, int files )
+{
+  maxSize = qMax( qint64(64 * 1024), maxFileSize );
+  maxFiles = qMax( 1, files );
+  failed = false;
+}
+
+bool ScatePostLog::open()
+{
+  prune( maxFiles - 1 );
+
+  // a counter of fixed width tells apart logs opened in the same second and
+  // keeps them sorting by name in the order they were opened; past the
+  // last one, that log is appended to
+  QString base = dir + "post-" + QDateTime::currentDateTime().toString( "yyyyMMdd-hhmmss" );
+  QString name;
+  for( int i = 1; i <= 99; ++i ) {
+    name = base + QString("-%1.log").arg( i, 2, 10, QChar('0') );
+    if( !QFile::exists( name ) ) break;
+  }
+
+  log.setFileName( name );
+  index.setFileName( indexFileName( name ) );
+  if( !log.open( QIODevice::WriteOnly | QIODevice::Append ) ||
+      !index.open( QIODevice::WriteOnly | QIODevice::Truncate ) )
+  {
+    qWarning( "Scate: Could not open post log %s", qPrintable( name ) );
+    close();
+    return false;
+  }
+  return true;
+}
+
+void ScatePostLog::close()
+{
+  log.close();
+  index.close();
+}
+
+void ScatePostLog::prune( int keep )
+{
+  QDir logDir( dir );
+  // names start with the date and end with a counter of fixed width, so
+  // they sort from oldest to newest
+  QStringList logs = logDir.entryList( QStringList("post-*.log"), QDir::Files, QDir::Name );
+  for( int i = 0; i < logs.count() - keep; ++i ) {
+    logDir.remove( logs[i] );
+    logDir.remove( indexFileName( logs[i] ) );
+  }
+}
+
+void ScatePostLog::write( const ScatePostBatch &batch )
+{
+  if( !enabled || failed || batch.isEmpty() ) return;
+  if( !log.isOpen() && !open() ) {
+    failed = true;
+    return;
+  }
+
+  qint64 now = QDateTime::currentMSecsSinceEpoch();
+  qint64 offset = log.size();
+  QByteArray text;
+  QVector<quint64> entries;
+  uchar kind = 0;
+
+  foreach( const ScatePostLine &line, batch.lines ) {
+    if( !hasOpenLine ) {
+      openTime = now;
+      hasOpenLine = true;
+    }
+    openText += line.text.toUtf8();
+    if( !line.complete ) continue;
+
+    // the kind of the last fragment is the kind of the whole line
+    kind = line.kind | ( line.folded ? foldedFlag : 0 );
+    entries.append( quint64( offset + text.size() ) | ( quint64(kind) << kindShift ) );
+    text += QByteArray::number( openTime );
+    text += '\t';
+    text += QByteArray::number( kind );
+    text += '\t';
+    text += openText;
+    text += '\n';
+    openText.clear();
+    hasOpenLine = false;
+  }
+
+  if( entries.isEmpty() ) return;
+
+  // the log is written before the index, so an index never refers to
+  // lines missing from the log
+  log.write( text );
+  log.flush();
+  index.write( (const char*) entries.constData(), entries.count() * sizeof(quint64) );
+  index.flush();
+
+  if( log.size() >= maxSize ) close();
+}
+
+ScatePostLogFile::ScatePostLogFile( QObject *parent ) :
+  ScateLineSource( parent ),
+  data( 0 ),
+  size( 0 ),
+  entries( 0 ),
+  lines( 0 ),
+  maxLength( 0 )
+{}
+
+bool ScatePostLogFile::open( const QString &fileName )
+{
+  log.setFileName( fileName );
+  if( !log.open( QIODevice::ReadOnly ) ) return false;
+  size = log.size();
+  if( size > 0 ) {
+    data = (const char*) log.map( 0, size );
+    if( !data ) return false;
+  }
+
+  index.setFileName( ScatePostLog::indexFileName( fileName ) );
+  if( !mapIndex() && !( buildIndex() && mapIndex() ) ) return false;
+
+  scan();
+  return true;
+}
+
+inline qint64 ScatePostLogFile::offset( qint64 n ) const
+{
+  return entries[n] & offsetMask;
+}
+
+bool ScatePostLogFile::mapIndex()
+{
+  index.close();
+  entries = 0;
+  lines = 0;
+  if( !index.open( QIODevice::ReadOnly ) ) return false;
+  qint64 indexSize = index.size();
+  if( indexSize % sizeof(quint64) ) return false;
+  qint64 n = indexSize / sizeof(quint64);
+  if( n == 0 ) {
+    if( size > 0 && memchr( data, '\n', size ) ) return false;
+    size = 0;
+    return true;
+  }
+
+  const quint64 *e = (const quint64*) index.map( 0, indexSize );
+  if( !e ) return false;
+
+  // The index must cover every complete line of the log: the line of the
+  // last entry must end with the last line break in the log.
+  qint64 last = e[n-1] & offsetMask;
+  if( ( e[0] & offsetMask ) != 0 || last >= size ) return false;
+  const char *lf = (const char*) memchr( data + last, '\n', size - last );
+  if( !lf ) return false;
+  qint64 end = lf - data + 1;
+  if( end < size && memchr( data + end, '\n', size - end ) ) return false;
+
+  entries = e;
+  lines = n;
+  // ignore an incomplete trailing line
+  size = end;
+  return true;
+}
+
+bool ScatePostLogFile::buildIndex()
+{
+  index.close();
+  if( !index.open( QIODevice::WriteOnly | QIODevice::Truncate ) ) return false;
+
+  QVector<quint64> buffer;
+  buffer.reserve( 8192 );
+  qint64 pos = 0;
+  while( pos < size ) {
+    const char *begin = data + pos;
+    const char *lf = (const char*) memchr( begin, '\n', size - pos );
+    if( !lf ) break;
+
+    uchar kind = 0;
+    const char *tab = (const char*) memchr( begin, '\t', lf - begin );
+    if( tab ) {
+      for( const char *c = tab + 1; c < lf && *c >= '0' && *c <= '9'; ++c )
+        kind = kind * 10 + ( *c - '0' );
+    }
+    buffer.append( quint64(pos) | ( quint64(kind) << kindShift ) );
+    if( buffer.count() == 8192 ) {
+      index.write( (const char*) buffer.constData(), buffer.count() * sizeof(quint64) );
+      buffer.clear();
+    }
+    pos = lf - data + 1;
+  }
+  index.write( (const char*) buffer.constData(), buffer.count() * sizeof(quint64) );
+  index.close();
+  return true;
+}
+
+void ScatePostLogFile::scan()
+{
+  // Only the index is read here, not the log.
+  groups.clear();
+  maxLength = 0;
+  for( qint64 n = 0; n < lines; ++n ) {
+    qint64 end = n + 1 < lines ? offset( n + 1 ) : size;
+    maxLength = qMax( maxLength, int( end - offset( n ) ) );
+    if( n > 0 && isFolded( n ) ) {
+      if( !groups.isEmpty() && groups.last().end == n )
+        ++groups.last().end;
+      else
+        groups.append( Group( n - 1, n + 1 ) );
+    }
+  }
+}
+
+QString ScatePostLogFile::line( qint64 n ) const
+{
+  if( n < 0 || n >= lines ) return QString();
+  const char *begin = data + offset( n );
+  // exclude the line break
+  const char *end = data + ( n + 1 < lines ? offset( n + 1 ) : size ) - 1;
+
+  const char *tab = (const char*) memchr( begin, '\t', end - begin );
+  if( !tab ) return QString::fromUtf8( begin, end - begin );
+  qint64 msecs = QByteArray( begin, tab - begin ).toLongLong();
+  const char *text = (const char*) memchr( tab + 1, '\t', end - tab - 1 );
+  text = text ? text + 1 : tab + 1;
+
+  return QDateTime::fromMSecsSinceEpoch( msecs ).toString( "hh:mm:ss.zzz  " )
+    + QString::fromUtf8( text, end - text );
+}
+
+ScatePostLine::Kind ScatePostLogFile::kind( qint64 n ) const
+{
+  if( n < 0 || n >= lines ) return ScatePostLine::Normal;
+  int k = ( entries[n] >> kindShift ) & ~foldedFlag;
+  return k <= ScatePostLine::Stderr ? (ScatePostLine::Kind) k : ScatePostLine::Normal;
+}
+
+bool ScatePostLogFile::isFolded( qint64 n ) const
+{
+  if( n < 0 || n >= lines ) return false;
+  return ( entries[n] >> kindShift ) & foldedFlag;
+}
@@ -0,0 +1,114 @@
+/*
+#
+# Copyright 2010-2011 Jakob Leben (jakob.leben@gmail.com)
+#
+# This file is part of Scate - a SuperCollider plugin for Kate
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+*/
+
+#ifndef SCATE_POST_LOG_H
+#define SCATE_POST_LOG_H
+
+#include "ScateLineStore.hpp"
+
+#include <QFile>
+#include <QVector>
+
+// Appends interpreter output to a log file on disk, one line per line of
+// output, prefixed with the time it arrived and its kind:
+//   <msecs since epoch> TAB <kind> TAB <text> LF
+// Next to each log, an index file holds the offset of every line, with the
+// line's kind in the top byte, so that a log can be reopened and browsed
+// without reading it as a whole.
+// A new log is started whenever the current one exceeds the size limit, and
+// the oldest logs are removed to keep at most the given number of them.
+// Each session logs to a directory of its own, so that pruning the logs of
+// one session never removes those of another.
+
+class ScatePostLog
+{
+  public:
+    // Logs to the given subdirectory of directory(), or to directory()
+    // itself if none is given.
+    ScatePostLog( const QString &subdir = QString() );
+    ~ScatePostLog();
+    void setEnabled( bool );
+    inline bool isEnabled() const { return enabled; }
+    void setLimits( qint64 maxFileSize, int maxFiles );
+    // Only complete lines are written; a trailing fragment is held back
+    // until the rest of the line arrives.
+    void write( const ScatePostBatch & );
+    inline QString fileName() const { return log.fileName(); }
+    inline const QString &logDirectory() const { return dir; }
+
+    // The directory of the post logs of the default session, which holds
+    // those of the other sessions in subdirectories.
+    static QString directory();
+    static QString indexFileName( const QString &logFileName );
+  private:
+    bool open();
+    void close();
+    void prune( int keep );
+
+    QString dir;
+    QFile log;
+    QFile index;
+    QByteArray openText;
+    qint64 openTime;
+    bool hasOpenLine;
+    bool enabled;
+    bool failed;
+    qint64 maxSize;
+    int maxFiles;
+};
+
+// A log written by ScatePostLog, mapped into memory for browsing in a
+// ScateTerminal. The index is rebuilt if it is missing or does not match
+// the log, e.g. after a crash.
+
+class ScatePostLogFile : public ScateLineSource
+{
+  Q_OBJECT
+  public:
+    ScatePostLogFile( QObject *parent = 0 );
+    bool open( const QString &fileName );
+
+    qint64 firstLine() const { return 0; }
+    qint64 endLine() const { return lines; }
+    QString line( qint64 n ) const;
+    ScatePostLine::Kind kind( qint64 n ) const;
+    bool isFolded( qint64 n ) const;
+    qint64 groupsBegin() const { return 0; }
+    qint64 groupsEnd() const { return groups.count(); }
+    Group group( qint64 i ) const { return groups[i]; }
+    int maxLineLength() const { return maxLength; }
+  private:
+    bool mapIndex();
+    bool buildIndex();
+    void scan();
+    inline qint64 offset( qint64 n ) const;
+
+    QFile log;
+    QFile index;
+    const char *data;
+    qint64 size;
+    const quint64 *entries;
+    qint64 lines;
+    QVector<Group> groups;
+    int maxLength;
+};
+
+#endif // SCATE_POST_LOG_H
@@ -0,0 +1,470 @@
+/*
+#
+# Copyright 2010-2011 Jakob Leben (jakob.leben@gmail.com)
+#
+# This file is part of Scate - a SuperCollider plugin for Kate
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+*/
+
+#include "ScatePostReader.hpp"
+#include "ScateEvalTracker.hpp"
+
+#include <QElapsedTimer>
+#include <QDir>
+#include <QFile>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <sys/uio.h>
+#include <string.h>
+
+static const int readSize = 64 * 1024;
+static const int maxBatchBytes = 256 * 1024;
+static const int maxDrainReads = 64;
+
+static const char ackPrefix[] = "@@scate:ack:";
+static const int ackPrefixLength = sizeof(ackPrefix) - 1;
+// prefix, up to 10 digits and the terminating ';'
+static const int ackMaxLength = ackPrefixLength + 11;
+
+// The size of text encoded in UTF-8, as it was read, to weigh it against
+// the limit, which is in bytes.
+static int utf8Size( const QString &text )
+{
+  int size = 0;
+  const QChar *c = text.constData();
+  const QChar *end = c + text.size();
+  for( ; c < end; ++c ) {
+    ushort u = c->unicode();
+    // each half of a surrogate pair stands for two of its four bytes
+    if( u < 0x80 ) size += 1;
+    else if( u < 0x800 || ( u >= 0xD800 && u <= 0xDFFF ) ) size += 2;
+    else size += 3;
+  }
+  return size;
+}
+
+ScatePostReader::ScatePostReader( QObject *parent )
+  : QThread( parent ),
+    inFlight( 0 ),
+    limit( 16 * 1024 * 1024 ),
+    overflow( Block ),
+    heldBytes( 0 ),
+    continues( false ),
+    dropAt( 0 ),
+    drainReads( 0 ),
+    spillFd( -1 ),
+    spillBegin( 0 ),
+    spillEnd( 0 )
+{
+  wakeFds[0] = wakeFds[1] = -1;
+}
+
+ScatePostReader::~ScatePostReader()
+{
+  stop();
+  wait();
+  for( int c = 0; c < ChannelCount; ++c )
+    if( streams[c].fd != -1 ) ::close( streams[c].fd );
+  if( wakeFds[0] != -1 ) ::close( wakeFds[0] );
+  if( wakeFds[1] != -1 ) ::close( wakeFds[1] );
+  if( spillFd != -1 ) ::close( spillFd );
+}
+
+bool ScatePostReader::open( int outFd, int errFd )
+{
+  if( ::pipe( wakeFds ) == -1 ) return false;
+  streams[Out].fd = outFd;
+  streams[Err].fd = errFd;
+  return true;
+}
+
+void ScatePostReader::wake( char c )
+{
+  if( wakeFds[1] == -1 ) return;
+  ssize_t n;
+  do { n = ::write( wakeFds[1], &c, 1 ); } while( n == -1 && errno == EINTR );
+}
+
+void ScatePostReader::stop()
+{
+  wake( 's' );
+}
+
+void ScatePostReader::setLimit( int bytes, Overflow policy )
+{
+  limit = qMax( readSize, bytes );
+  overflow = policy;
+  wake( 'r' );
+}
+
+void ScatePostReader::release( int bytes )
+{
+  if( bytes <= 0 ) return;
+  int before = inFlight.fetchAndAddOrdered( -bytes );
+  if( before - bytes < 0 ) inFlight.fetchAndAddOrdered( bytes - before );
+  // resume a reader waiting for room
+  if( before >= (int) limit && before - bytes < (int) limit ) wake( 'r' );
+}
+
+bool ScatePostReader::readWake()
+{
+  char buf[64];
+  ssize_t n = ::read( wakeFds[0], buf, sizeof(buf) );
+  for( ssize_t i = 0; i < n; ++i )
+    if( buf[i] == 's' ) return true;
+  return false;
+}
+
+void ScatePostReader::run()
+{
+  char buf[readSize];
+  struct pollfd fds[ChannelCount + 1];
+  fds[ChannelCount].fd = wakeFds[0];
+  fds[ChannelCount].events = POLLIN;
+
+  for( int c = 0; c < ChannelCount; ++c )
+    if( streams[c].fd == -1 ) streams[c].eof = true;
+
+  bool stopping = false;
+  QElapsedTimer blocked;
+
+  forever {
+    bool readable[ChannelCount] = { false, false };
+
+    if( !stopping ) {
+      // While blocked, the pipes are left alone, so the interpreter stalls
+      // as soon as one of them is full.
+      bool full = isFull();
+      bool block = full && (int) overflow == Block;
+      if( block && !blocked.isValid() ) blocked.start();
+      bool replay = hasSpill() && !full;
+      for( int c = 0; c < ChannelCount; ++c ) {
+        fds[c].fd = ( block || streams[c].eof ) ? -1 : streams[c].fd;
+        fds[c].events = POLLIN;
+        fds[c].revents = 0;
+      }
+      fds[ChannelCount].revents = 0;
+      int r = ::poll( fds, ChannelCount + 1, replay ? 0 : -1 );
+      if( r == -1 ) {
+        if( errno == EINTR ) continue;
+        break;
+      }
+      if( fds[ChannelCount].revents && readWake() ) {
+        // drain whatever the interpreter has left, then finish
+        stopping = true;
+        for( int c = 0; c < ChannelCount; ++c ) {
+          int fd = streams[c].fd;
+          if( fd != -1 ) ::fcntl( fd, F_SETFL, ::fcntl( fd, F_GETFL ) | O_NONBLOCK );
+        }
+      }
+      if( blocked.isValid() && ( stopping || !isFull() ) ) {
+        batch.blockedTime += blocked.nsecsElapsed();
+        blocked.invalidate();
+      }
+      for( int c = 0; c < ChannelCount; ++c )
+        readable[c] = fds[c].revents != 0;
+    }
+
+    for( int c = 0; c < ChannelCount; ++c )
+      if( !streams[c].eof && ( stopping || readable[c] ) )
+        readStream( c, buf, stopping );
+
+    if( hasSpill() && ( stopping || !isFull() ) ) {
+      int channel = Out;
+      int n = spillRead( channel, buf, readSize );
+      if( n <= 0 || ( stopping && ++drainReads >= maxDrainReads ) ) {
+        // give up on the rest of the spill
+        spillBegin = spillEnd = 0;
+      }
+      if( n > 0 ) consume( channel, buf, n );
+    }
+
+    if( streams[Out].eof && streams[Err].eof && !hasSpill() ) break;
+
+    if( ( stopping || !isFull() ) && ( batch.bytes >= maxBatchBytes || !hasPendingInput() ) )
+      emitBatch();
+  }
+
+  emitBatch( true );
+}
+
+void ScatePostReader::readStream( int channel, char *buf, bool stopping )
+{
+  Stream &s = streams[channel];
+  ssize_t n;
+  do { n = ::read( s.fd, buf, readSize ); } while( n == -1 && errno == EINTR );
+  if( n <= 0 || ( stopping && ++drainReads >= maxDrainReads ) ) s.eof = true;
+  if( n <= 0 ) return;
+
+  // once output is spilled, everything after it has to go the same way
+  bool spill = hasSpill() || ( isFull() && !stopping && (int) overflow == Spill );
+  if( !spill || !spillWrite( channel, buf, n ) ) {
+    consume( channel, buf, n );
+    if( isFull() && !stopping ) dropOldest();
+  }
+}
+
+bool ScatePostReader::hasPendingInput()
+{
+  if( hasSpill() ) return true;
+  struct pollfd fds[ChannelCount];
+  for( int c = 0; c < ChannelCount; ++c ) {
+    fds[c].fd = streams[c].eof ? -1 : streams[c].fd;
+    fds[c].events = POLLIN;
+    fds[c].revents = 0;
+  }
+  return ::poll( fds, ChannelCount, 0 ) > 0;
+}
+
+void ScatePostReader::consume( int channel, const char *data, int size )
+{
+  QElapsedTimer timer;
+  timer.start();
+
+  if( channel == Out )
+    consumeOut( data, size );
+  else
+    decode( channel, data, size );
+
+  batch.bytes += size;
+  if( channel == Err ) batch.stderrBytes += size;
+  batch.decodeTime += timer.nsecsElapsed();
+}
+
+void ScatePostReader::consumeOut( const char *data, int size )
+{
+  Stream &s = streams[Out];
+  QByteArray joined;
+  if( !s.held.isEmpty() ) {
+    joined = s.held;
+    joined.append( data, size );
+    s.held.clear();
+    data = joined.constData();
+    size = joined.size();
+  }
+
+  const char *end = data + size;
+  while( data < end ) {
+    const char *mark = (const char*) memmem( data, end - data, ackPrefix, ackPrefixLength );
+    if( !mark ) {
+      // keep back what could be the start of an acknowledgement
+      const char *tail = end;
+      for( const char *c = qMax( data, end - ackPrefixLength + 1 ); c < end; ++c ) {
+        if( *c == '@' && !memcmp( c, ackPrefix, end - c ) ) {
+          tail = c;
+          break;
+        }
+      }
+      decode( Out, data, tail - data );
+      s.held = QByteArray( tail, end - tail );
+      return;
+    }
+
+    const char *c = mark + ackPrefixLength;
+    int id = 0;
+    while( c < end && *c >= '0' && *c <= '9' && c - mark < ackMaxLength )
+      id = id * 10 + ( *c++ - '0' );
+    if( c == end && c - mark < ackMaxLength ) {
+      decode( Out, data, mark - data );
+      s.held = QByteArray( mark, end - mark );
+      return;
+    }
+    if( c == end || *c != ';' ) {
+      // not an acknowledgement after all
+      decode( Out, data, c - data );
+      data = c;
+      continue;
+    }
+
+    decode( Out, data, mark - data );
+    batch.acks.append( ScateEvalAck( id, ScateEvalTracker::now(), batch.lines.count() ) );
+    data = c + 1;
+    // an acknowledgement posted on a line of its own leaves no empty line
+    if( data < end && *data == '\n' && s.decoder.lineLength() == 0 ) ++data;
+  }
+}
+
+void ScatePostReader::decode( int channel, const char *data, int size )
+{
+  Stream &s = streams[channel];
+  const char *end = data + size;
+  while( s.decoder.decode( data, end ) ) {
+    if( channel == Err ) breakOpenLine();
+    ScatePostLine line;
+    s.classifier.classify( s.decoder.line(), s.decoder.lineLength(), line );
+    if( channel == Err && line.kind == ScatePostLine::Normal )
+      line.kind = ScatePostLine::Stderr;
+    line.text = s.decoder.takeFragment();
+    heldBytes += utf8Size( line.text );
+    batch.lines.append( line );
+    s.decoder.nextLine();
+  }
+}
+
+void ScatePostReader::breakOpenLine()
+{
+  // Ends the line of standard output in progress, if any, so that a line of
+  // standard error can follow it. The rest of the line will start a new one.
+  Stream &out = streams[Out];
+  if( !out.decoder.hasFragment() && !( continues && batch.lines.isEmpty() ) ) return;
+
+  ScatePostLine line;
+  // classify without changing state; the line will be classified again
+  // when complete
+  line.complete = false;
+  out.classifier.classify( out.decoder.line(), out.decoder.lineLength(), line );
+  line.complete = true;
+  line.text = out.decoder.takeFragment();
+  heldBytes += utf8Size( line.text );
+  batch.lines.append( line );
+}
+
+void ScatePostReader::dropOldest()
+{
+  if( (int) overflow != DropOldest ) return;
+
+  // Keep the rest of an emitted open line, so it is completed properly,
+  // and drop the lines after it.
+  dropAt = continues ? 1 : 0;
+  int budget = limit;
+  int removed = 0;
+  while( heldBytes > budget && batch.lines.count() > dropAt + 1 ) {
+    heldBytes -= utf8Size( batch.lines[dropAt].text );
+    batch.lines.removeAt( dropAt );
+    ++removed;
+  }
+  batch.dropped += removed;
+  for( int i = 0; i < batch.acks.count(); ++i ) {
+    int &after = batch.acks[i].after;
+    if( after > dropAt ) after = qMax( dropAt, after - removed );
+  }
+}
+
+void ScatePostReader::emitBatch( bool final )
+{
+  Stream &out = streams[Out];
+  if( final && !out.held.isEmpty() ) {
+    // no acknowledgement after all
+    decode( Out, out.held.constData(), out.held.size() );
+    out.held.clear();
+  }
+
+  Stream &err = streams[Err];
+  if( final && err.decoder.hasFragment() ) {
+    // the last line of standard error lacks a line break
+    breakOpenLine();
+    ScatePostLine line;
+    err.classifier.classify( err.decoder.line(), err.decoder.lineLength(), line );
+    if( line.kind == ScatePostLine::Normal ) line.kind = ScatePostLine::Stderr;
+    line.text = err.decoder.takeFragment();
+    batch.lines.append( line );
+  }
+
+  if( out.decoder.hasFragment() ) {
+    // publish the open line as far as it has been decoded
+    ScatePostLine line;
+    line.complete = false;
+    out.classifier.classify( out.decoder.line(), out.decoder.lineLength(), line );
+    line.text = out.decoder.takeFragment();
+    batch.lines.append( line );
+  }
+
+  if( batch.isEmpty() ) return;
+
+  if( batch.dropped ) {
+    batch.lines.insert( dropAt, ScatePostLine(
+      QString("[%1 lines of output dropped]").arg( batch.dropped ),
+      ScatePostLine::Warning ) );
+    for( int i = 0; i < batch.acks.count(); ++i )
+      if( batch.acks[i].after > dropAt ) ++batch.acks[i].after;
+  }
+
+  if( !batch.lines.isEmpty() ) continues = !batch.lines.last().complete;
+  inFlight.fetchAndAddOrdered( batch.bytes );
+  emit posted( batch );
+  batch = ScatePostBatch();
+  heldBytes = 0;
+}
+
+// The spill file holds records of a channel number and a length, followed
+// by that many bytes read from the channel.
+
+struct SpillHeader {
+  int channel;
+  int size;
+};
+
+bool ScatePostReader::spillWrite( int channel, const char *data, int size )
+{
+  if( spillFd == -1 ) {
+    QByteArray path = QFile::encodeName( QDir::tempPath() + "/scate-spill-XXXXXX" );
+    spillFd = ::mkstemp( path.data() );
+    if( spillFd == -1 ) return false;
+    // the file disappears as soon as it is closed
+    ::unlink( path.constData() );
+  }
+
+  SpillHeader header = { channel, size };
+  struct iovec parts[2] = {
+    { &header, sizeof(header) },
+    { (void*) data, (size_t) size }
+  };
+  int total = sizeof(header) + size;
+  qint64 offset = spillEnd;
+  int written = 0;
+  while( written < total ) {
+    ssize_t n = ::pwritev( spillFd, parts, 2, offset + written );
+    if( n == -1 ) {
+      if( errno == EINTR ) continue;
+      // forget the partial write; the caller takes the data directly
+      return false;
+    }
+    written += n;
+    // skip what has been written
+    for( int i = 0; i < 2; ++i ) {
+      size_t skip = qMin( (size_t) n, parts[i].iov_len );
+      parts[i].iov_base = (char*) parts[i].iov_base + skip;
+      parts[i].iov_len -= skip;
+      n -= skip;
+    }
+  }
+  batch.spilled += size;
+  spillEnd = offset + total;
+  return true;
+}
+
+int ScatePostReader::spillRead( int &channel, char *buf, int size )
+{
+  SpillHeader header;
+  ssize_t r;
+  do { r = ::pread( spillFd, &header, sizeof(header), spillBegin ); } while( r == -1 && errno == EINTR );
+  if( r != sizeof(header) || header.size > size ) return -1;
+  do { r = ::pread( spillFd, buf, header.size, spillBegin + sizeof(header) ); } while( r == -1 && errno == EINTR );
+  if( r != header.size ) return -1;
+
+  channel = header.channel;
+  spillBegin += sizeof(header) + header.size;
+  if( spillBegin == spillEnd ) {
+    // start over at the beginning of the file
+    spillBegin = spillEnd = 0;
+    ::ftruncate( spillFd, 0 );
+  }
+  return r;
+}
@@ -0,0 +1,121 @@
+/*
+#
+# Copyright 2010-2011 Jakob Leben (jakob.leben@gmail.com)
+#
+# This file is part of Scate - a SuperCollider plugin for Kate
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+*/
+
+#ifndef SCATE_POST_READER_H
+#define SCATE_POST_READER_H
+
+#include "ScatePost.hpp"
+#include "ScateStreamDecoder.hpp"
+
+#include <QThread>
+#include <QAtomicInt>
+
+// Reads interpreter output from pipes on its own thread, splits it into
+// lines, decodes and classifies them, and emits them in batches.
+// A batch is emitted whenever the pipes have been drained, or when it grows
+// large during a flood, so the GUI thread never touches the pipes.
+// Standard output and standard error are read from separate pipes; lines of
+// standard error are marked as such. An incomplete line of standard output
+// is broken when a line of standard error arrives, like in a terminal.
+// Acknowledgements of evaluations (see ScateEvalTracker) are taken out of
+// standard output and emitted along with the lines.
+//
+// The amount of output emitted but not yet released by the receiver is
+// limited. When the limit is reached, the reader either stops reading, so
+// that the interpreter stalls on a full pipe, drops the oldest output it
+// holds, or keeps reading into a temporary file and replays it later.
+
+class ScatePostReader : public QThread
+{
+  Q_OBJECT
+  public:
+    enum Overflow {
+      Block,
+      DropOldest,
+      Spill
+    };
+
+    ScatePostReader( QObject *parent = 0 );
+    ~ScatePostReader();
+    // Takes ownership of the read ends of two pipes.
+    bool open( int outFd, int errFd );
+    // Reads what is left in the pipes without blocking, and finishes.
+    void stop();
+    // May be called from any thread.
+    void setLimit( int bytes, Overflow );
+    // Marks emitted output as consumed; may be called from any thread.
+    void release( int bytes );
+  signals:
+    void posted( const ScatePostBatch & );
+  protected:
+    void run();
+  private:
+    enum Channel {
+      Out,
+      Err,
+      ChannelCount
+    };
+
+    struct Stream {
+      Stream() : fd( -1 ), eof( false ) {}
+      int fd;
+      bool eof;
+      ScateStreamDecoder decoder;
+      ScatePostClassifier classifier;
+      // start of an acknowledgement cut by the end of a read
+      QByteArray held;
+    };
+
+    void wake( char );
+    bool readWake();
+    inline bool isFull() const { return (int) inFlight >= (int) limit; }
+    void readStream( int channel, char *buf, bool stopping );
+    bool hasPendingInput();
+    void consume( int channel, const char *data, int size );
+    void consumeOut( const char *data, int size );
+    void decode( int channel, const char *data, int size );
+    void breakOpenLine();
+    void dropOldest();
+    void emitBatch( bool final = false );
+    bool spillWrite( int channel, const char *data, int size );
+    int spillRead( int &channel, char *buf, int size );
+    inline bool hasSpill() const { return spillBegin < spillEnd; }
+
+    Stream streams[ChannelCount];
+    int wakeFds[2];
+    QAtomicInt inFlight;
+    QAtomicInt limit;
+    QAtomicInt overflow;
+
+    // reader thread only:
+    ScatePostBatch batch;
+    // bytes of text held in the batch, in UTF-8
+    int heldBytes;
+    // whether the batch starts with the rest of an emitted open line
+    bool continues;
+    int dropAt;
+    int drainReads;
+    int spillFd;
+    qint64 spillBegin;
+    qint64 spillEnd;
+};
+
+#endif // SCATE_POST_READER_H
@@ -0,0 +1,305 @@
+/*
+#
+# Copyright 2010-2011 Jakob Leben (jakob.leben@gmail.com)
+#
+# This file is part of Scate - a SuperCollider plugin for Kate
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+*/
+
+#include "ScateRegionIndex.hpp"
+
+#include <ktexteditor/document.h>
+
+static const int NoMin = 1 << 29;
+
+ScateRegionIndex::Line::Line() :
+  exit( -1 ),
+  sum( 0 ),
+  min( NoMin ),
+  blank( true ),
+  code( false )
+{}
+
+ScateRegionIndex *ScateRegionIndex::of( KTextEditor::Document *doc )
+{
+  ScateRegionIndex *index = doc->findChild<ScateRegionIndex*>();
+  if( !index ) index = new ScateRegionIndex( doc );
+  return index;
+}
+
+ScateRegionIndex::ScateRegionIndex( KTextEditor::Document *doc_ ) :
+  QObject( doc_ ),
+  doc( doc_ ),
+  leaves( 0 ),
+  treeValid( false )
+{
+  connect( doc, SIGNAL(textInserted(KTextEditor::Document*, const KTextEditor::Range&)),
+           this, SLOT(textInserted(KTextEditor::Document*, const KTextEditor::Range&)) );
+  connect( doc, SIGNAL(textRemoved(KTextEditor::Document*, const KTextEditor::Range&)),
+           this, SLOT(textRemoved(KTextEditor::Document*, const KTextEditor::Range&)) );
+  connect( doc, SIGNAL(reloaded(KTextEditor::Document*)), this, SLOT(rebuild()) );
+  rebuild();
+}
+
+void ScateRegionIndex::rebuild()
+{
+  lines.clear();
+  lines.resize( doc->lines() );
+  treeValid = false;
+  relex( 0, lines.count() - 1 );
+}
+
+void ScateRegionIndex::textInserted( KTextEditor::Document *, const KTextEditor::Range &range )
+{
+  int first = range.start().line();
+  int added = range.end().line() - first;
+  if( first >= lines.count() || lines.count() + added != doc->lines() ) {
+    rebuild();
+    return;
+  }
+  if( added > 0 ) {
+    lines.insert( first + 1, added, Line() );
+    treeValid = false;
+  }
+  relex( first, range.end().line() );
+}
+
+void ScateRegionIndex::textRemoved( KTextEditor::Document *, const KTextEditor::Range &range )
+{
+  int first = range.start().line();
+  int removed = range.end().line() - first;
+  if( first + removed >= lines.count() || lines.count() - removed != doc->lines() ) {
+    rebuild();
+    return;
+  }
+  if( removed > 0 ) {
+    lines.remove( first + 1, removed );
+    treeValid = false;
+  }
+  relex( first, first );
+}
+
+void ScateRegionIndex::relex( int first, int last )
+{
+  int state = first > 0 ? lines[first-1].exit : ScateLexer::Code;
+  if( state < 0 ) state = ScateLexer::Code;
+
+  for( int i = first; i < lines.count(); ++i ) {
+    Line &line = lines[i];
+    int previous = line.exit;
+
+    QString text = doc->line(i);
+    line.brackets.resize( 0 );
+    state = line.exit = ScateLexer::lexLine( text, state, &line.brackets, &line.code );
+    line.blank = text.trimmed().isEmpty();
+
+    line.sum = 0;
+    line.min = NoMin;
+    for( int b = 0; b < line.brackets.count(); ++b ) {
+      line.sum += delta( line.brackets[b] );
+      line.min = qMin( line.min, line.sum );
+    }
+    update( i );
+
+    // lines below are unaffected once the state is the same as before
+    if( i >= last && state == previous ) break;
+  }
+}
+
+void ScateRegionIndex::update( int line )
+{
+  if( !treeValid ) return;
+  int p = leaves + line;
+  tree[p].sum = lines[line].sum;
+  tree[p].min = lines[line].min;
+  for( p /= 2; p > 0; p /= 2 ) {
+    const Node &l = tree[2*p];
+    const Node &r = tree[2*p+1];
+    tree[p].sum = l.sum + r.sum;
+    tree[p].min = qMin( l.min, l.sum + r.min );
+  }
+}
+
+void ScateRegionIndex::buildTree()
+{
+  leaves = 1;
+  while( leaves < lines.count() ) leaves *= 2;
+
+  Node empty = { 0, NoMin };
+  tree.fill( empty, 2 * leaves );
+  for( int i = 0; i < lines.count(); ++i ) {
+    tree[leaves+i].sum = lines[i].sum;
+    tree[leaves+i].min = lines[i].min;
+  }
+  for( int p = leaves - 1; p > 0; --p ) {
+    const Node &l = tree[2*p];
+    const Node &r = tree[2*p+1];
+    tree[p].sum = l.sum + r.sum;
+    tree[p].min = qMin( l.min, l.sum + r.min );
+  }
+  treeValid = true;
+}
+
+int ScateRegionIndex::depthBefore( int line ) const
+{
+  int depth = 0;
+  int lo = leaves;
+  int hi = leaves + line;
+  while( lo < hi ) {
+    if( lo & 1 ) depth += tree[lo++].sum;
+    if( hi & 1 ) depth += tree[--hi].sum;
+    lo /= 2;
+    hi /= 2;
+  }
+  return depth;
+}
+
+// The last line before 'limit' with a bracket after which the depth is 0 or
+// below. 'start' is the depth before line 'lo'.
+int ScateRegionIndex::lastAtTop( int node, int lo, int hi, int start, int limit ) const
+{
+  if( lo >= limit || start + tree[node].min > 0 ) return -1;
+  if( hi - lo == 1 ) return lo;
+  int mid = (lo + hi) / 2;
+  int line = lastAtTop( 2*node+1, mid, hi, start + tree[2*node].sum, limit );
+  if( line != -1 ) return line;
+  return lastAtTop( 2*node, lo, mid, start, limit );
+}
+
+// The first line from 'from' on with a bracket after which the depth is 0
+// or below.
+int ScateRegionIndex::firstAtTop( int node, int lo, int hi, int start, int from ) const
+{
+  if( hi <= from || start + tree[node].min > 0 ) return -1;
+  if( hi - lo == 1 ) return lo;
+  int mid = (lo + hi) / 2;
+  int line = firstAtTop( 2*node, lo, mid, start, from );
+  if( line != -1 ) return line;
+  return firstAtTop( 2*node+1, mid, hi, start + tree[2*node].sum, from );
+}
+
+KTextEditor::Range ScateRegionIndex::regionAt( const KTextEditor::Cursor &cursor )
+{
+  int row = cursor.line();
+  if( row < 0 || row >= lines.count() ) return KTextEditor::Range::invalid();
+  if( !treeValid ) buildTree();
+
+  const QVector<ScateLexer::Bracket> &here = lines[row].brackets;
+  const int base = depthBefore( row );
+
+  // depth at the cursor, and how many brackets of its line come before it
+  int at = 0;
+  int depth = base;
+  while( at < here.count() && here[at].column < cursor.column() )
+    depth += delta( here[at++] );
+  if( depth <= 0 ) {
+    at = here.count();
+    depth = base + lines[row].sum;
+    if( depth <= 0 ) return KTextEditor::Range::invalid();
+  }
+
+  // The region opens with the bracket following the last one before the
+  // cursor that leaves the depth at 0.
+  int openRow = -1;
+  int openIndex = 0;
+  int d = base;
+  for( int i = 0; i < at; ++i ) {
+    d += delta( here[i] );
+    if( d <= 0 ) {
+      openRow = row;
+      openIndex = i + 1;
+    }
+  }
+  if( openRow == -1 ) {
+    int r = lastAtTop( 1, 0, leaves, 0, row );
+    if( r != -1 ) {
+      const QVector<ScateLexer::Bracket> &brackets = lines[r].brackets;
+      d = depthBefore( r );
+      for( int i = 0; i < brackets.count(); ++i ) {
+        d += delta( brackets[i] );
+        if( d <= 0 ) {
+          openRow = r;
+          openIndex = i + 1;
+        }
+      }
+    }
+    else openRow = 0;
+  }
+  while( openIndex >= lines[openRow].brackets.count() ) {
+    if( ++openRow > row ) return KTextEditor::Range::invalid();
+    openIndex = 0;
+  }
+  const ScateLexer::Bracket &open = lines[openRow].brackets[openIndex];
+  if( open.ch != '(' ) return KTextEditor::Range::invalid();
+
+  // It closes with the first bracket after the cursor that brings the
+  // depth back to 0.
+  int closeRow = -1;
+  int closeIndex = 0;
+  d = depth;
+  for( int i = at; i < here.count(); ++i ) {
+    d += delta( here[i] );
+    if( d <= 0 ) {
+      closeRow = row;
+      closeIndex = i;
+      break;
+    }
+  }
+  if( closeRow == -1 ) {
+    closeRow = firstAtTop( 1, 0, leaves, 0, row + 1 );
+    if( closeRow == -1 ) return KTextEditor::Range::invalid();
+    const QVector<ScateLexer::Bracket> &brackets = lines[closeRow].brackets;
+    d = depthBefore( closeRow );
+    while( closeIndex < brackets.count() ) {
+      d += delta( brackets[closeIndex] );
+      if( d <= 0 ) break;
+      ++closeIndex;
+    }
+  }
+
+  return KTextEditor::Range( openRow, open.column,
+                             closeRow, lines[closeRow].brackets[closeIndex].column + 1 );
+}
+
+QList<KTextEditor::Range> ScateRegionIndex::blocks() const
+{
+  QList<KTextEditor::Range> result;
+  int depth = 0;
+  int start = -1;
+  bool code = false;
+
+  for( int i = 0; i <= lines.count(); ++i ) {
+    bool separator = true;
+    if( i < lines.count() ) {
+      int state = i > 0 ? lines[i-1].exit : ScateLexer::Code;
+      separator = lines[i].blank && depth <= 0 && state == ScateLexer::Code;
+    }
+
+    if( separator ) {
+      if( start != -1 && code )
+        result.append( KTextEditor::Range( start, 0, i - 1, doc->lineLength( i - 1 ) ) );
+      start = -1;
+      code = false;
+    }
+    else {
+      if( start == -1 ) start = i;
+      code = code || lines[i].code;
+      depth += lines[i].sum;
+    }
+  }
+
+  return result;
+}
@@ -0,0 +1,107 @@
+/*
+#
+# Copyright 2010-2011 Jakob Leben (jakob.leben@gmail.com)
+#
+# This file is part of Scate - a SuperCollider plugin for Kate
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+*/
+
+#ifndef SCATE_REGION_INDEX_H
+#define SCATE_REGION_INDEX_H
+
+#include "ScateLexer.hpp"
+
+#include <ktexteditor/range.h>
+
+#include <QObject>
+#include <QVector>
+#include <QList>
+
+namespace KTextEditor { class Document; }
+
+// An index of the brackets of a document, kept up to date as it is edited,
+// to find the region (the outermost pair of parentheses) around a cursor
+// without scanning the document.
+// The brackets of each line are kept along with the lexer state at its end,
+// so an edit only needs the changed lines lexed again, plus the lines below
+// as long as their state changes (e.g. after opening a string).
+// A segment tree over the lines holds the change in bracket depth over each
+// span of lines and the lowest depth reached within it, so the brackets
+// that open and close the region can be found in O(log n). The tree is
+// updated in place when lines change, and rebuilt on first use after lines
+// have been added or removed.
+
+class ScateRegionIndex : public QObject
+{
+    Q_OBJECT
+
+  public:
+    // The index of a document, created on first use and owned by it.
+    static ScateRegionIndex *of( KTextEditor::Document * );
+
+    // Returns the range from the outermost opening parenthesis enclosing
+    // the cursor to the bracket closing it, or an invalid range if there is
+    // none. A cursor outside of brackets picks a region opened on its line.
+    KTextEditor::Range regionAt( const KTextEditor::Cursor & );
+    // The top-level blocks of the document: runs of lines separated by
+    // blank lines outside of brackets, comments and strings. Blocks with
+    // nothing but comments are left out.
+    QList<KTextEditor::Range> blocks() const;
+
+  private slots:
+    void textInserted( KTextEditor::Document *, const KTextEditor::Range & );
+    void textRemoved( KTextEditor::Document *, const KTextEditor::Range & );
+    void rebuild();
+
+  private:
+    ScateRegionIndex( KTextEditor::Document * );
+
+    struct Line {
+      Line();
+      QVector<ScateLexer::Bracket> brackets;
+      // lexer state at the end of the line; -1 if not lexed yet
+      int exit;
+      // brackets opened minus brackets closed
+      int sum;
+      // lowest depth after any bracket, relative to the start of the line
+      int min;
+      bool blank;
+      // whether there is anything but whitespace and comments
+      bool code;
+    };
+
+    struct Node {
+      int sum;
+      int min;
+    };
+
+    static inline int delta( const ScateLexer::Bracket &b ) { return b.isOpening() ? 1 : -1; }
+
+    void relex( int first, int last );
+    void update( int line );
+    void buildTree();
+    int depthBefore( int line ) const;
+    int lastAtTop( int node, int lo, int hi, int start, int limit ) const;
+    int firstAtTop( int node, int lo, int hi, int start, int from ) const;
+
+    KTextEditor::Document *doc;
+    QVector<Line> lines;
+    QVector<Node> tree;
+    int leaves;
+    bool treeValid;
+};
+
+#endif // SCATE_REGION_INDEX_H
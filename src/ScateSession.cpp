@@ -0,0 +1,900 @@
+/*
+#
+# Copyright 2010-2011 Jakob Leben (jakob.leben@gmail.com)
+#
+# This file is part of Scate - a SuperCollider plugin for Kate
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+*/
+
+#include "ScateSession.hpp"
+#include "ScateSettings.hpp"
+#include "ScateOutputBuffer.hpp"
+#include "ScatePostReader.hpp"
+#include "ScateLineStore.hpp"
+#include "ScatePostLog.hpp"
+#include "ScateOutputThrottle.hpp"
+#include "ScateEvalTracker.hpp"
+#include "ScateEvalQueue.hpp"
+#include "ScateEvalFiles.hpp"
+
+#include <QDirIterator>
+#include <QTimer>
+#include <QFile>
+#include <QStringList>
+
+#include <cstdio>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+
+// id of the acknowledgement that tells an interpreter accepts input;
+// ScateEvalTracker never uses it
+static const int ProbeId = 0;
+
+// how often the interpreter is asked to acknowledge, in milliseconds
+static const int HeartbeatInterval = 1000;
+
+SCProcess::SCProcess( QObject *parent ) :
+  QProcess( parent ),
+  reader( 0 ),
+  outputLimit( 16 * 1024 * 1024 ),
+  overflow( ScatePostReader::Block ),
+  childOut( -1 ),
+  childErr( -1 ),
+  exitCode( 0 ),
+  exitStatus( QProcess::NormalExit )
+{
+  connect( this, SIGNAL( finished( int, QProcess::ExitStatus ) ),
+           this, SLOT( onFinished( int, QProcess::ExitStatus ) ) );
+  connect( this, SIGNAL( error( QProcess::ProcessError ) ),
+           this, SLOT( onError( QProcess::ProcessError ) ) );
+}
+
+SCProcess::~SCProcess()
+{
+  stopReader();
+}
+
+bool SCProcess::launch( const QString &command )
+{
+  stopReader();
+
+  int out[2], err[2];
+  if( ::pipe( out ) == -1 ) return false;
+  if( ::pipe( err ) == -1 ) {
+    ::close( out[0] );
+    ::close( out[1] );
+    return false;
+  }
+  for( int i = 0; i < 2; ++i ) {
+    ::fcntl( out[i], F_SETFD, FD_CLOEXEC );
+    ::fcntl( err[i], F_SETFD, FD_CLOEXEC );
+  }
+
+  reader = new ScatePostReader( this );
+  if( !reader->open( out[0], err[0] ) ) {
+    delete reader;
+    reader = 0;
+    for( int i = 0; i < 2; ++i ) {
+      ::close( out[i] );
+      ::close( err[i] );
+    }
+    return false;
+  }
+  connect( reader, SIGNAL( posted( const ScatePostBatch& ) ),
+           this, SIGNAL( scSays( const ScatePostBatch& ) ) );
+  reader->setLimit( outputLimit, overflow );
+  reader->start();
+
+  childOut = out[1];
+  childErr = err[1];
+  start( command );
+  ::close( childOut );
+  ::close( childErr );
+  childOut = childErr = -1;
+
+  return true;
+}
+
+void SCProcess::setOutputLimit( int bytes, ScatePostReader::Overflow policy )
+{
+  outputLimit = bytes;
+  overflow = policy;
+  if( reader ) reader->setLimit( outputLimit, overflow );
+}
+
+void SCProcess::release( int bytes )
+{
+  if( reader ) reader->release( bytes );
+}
+
+void SCProcess::setupChildProcess()
+{
+  // runs in the child process, after QProcess has set up its own channels
+  if( childOut != -1 ) ::dup2( childOut, STDOUT_FILENO );
+  if( childErr != -1 ) ::dup2( childErr, STDERR_FILENO );
+}
+
+void SCProcess::stopReader()
+{
+  if( !reader ) return;
+  reader->stop();
+  reader->wait();
+  delete reader;
+  reader = 0;
+}
+
+void SCProcess::onFinished( int code, QProcess::ExitStatus status )
+{
+  exitCode = code;
+  exitStatus = status;
+  stopReader();
+  // the reader's last batches are queued; make sure they are delivered first
+  QMetaObject::invokeMethod( this, "notifyFinished", Qt::QueuedConnection );
+}
+
+void SCProcess::onError( QProcess::ProcessError err )
+{
+  if( err == QProcess::FailedToStart ) stopReader();
+}
+
+void SCProcess::notifyFinished()
+{
+  emit langFinished( exitCode, exitStatus );
+}
+
+
+ScateSession::ScateSession( const QString &name, ScateSettings *settings_, QObject *parent ) :
+  QObject( parent ),
+  _name( name ),
+  settings( settings_ ),
+  scProcess( new SCProcess( this ) ),
+  outputBuffer( new ScateOutputBuffer( this ) ),
+  lineStore( new ScateLineStore( this ) ),
+  postLog( new ScatePostLog( name == defaultName() ? QString() : name ) ),
+  throttle( new ScateOutputThrottle( this ) ),
+  evalTracker( new ScateEvalTracker ),
+  _evalQueue( new ScateEvalQueue( scProcess, this ) ),
+  evalFiles( new ScateEvalFiles ),
+  evalError( false ),
+  checkCount( 0 ),
+  checkFailures( 0 ),
+  checkTime( 0 ),
+  standby( 0 ),
+  standbyReady( false ),
+  standbyLaunched( 0 ),
+  startRequested( 0 ),
+  startAction( "start" ),
+  lastStartTime( -1 ),
+  heartbeat( new QTimer( this ) ),
+  heartbeatSent( 0 ),
+  probesPending( 0 ),
+  lastHeartbeat( -1 ),
+  maxHeartbeat( 0 ),
+  stalled( false ),
+  stallCount( 0 ),
+  restart( false )
+{
+  attachProcess( scProcess );
+  connect( outputBuffer, SIGNAL( flushed( const ScatePostBatch& ) ),
+           this, SLOT( flushOutput( const ScatePostBatch& ) ) );
+  connect( throttle, SIGNAL( suppressing( qint64, double, double ) ),
+           this, SIGNAL( outputSuppressed( qint64, double, double ) ) );
+  connect( throttle, SIGNAL( resumed( qint64 ) ), this, SLOT( onOutputResumed( qint64 ) ) );
+  connect( _evalQueue, SIGNAL( cancelled( int ) ), this, SLOT( onEvalCancelled( int ) ) );
+
+  connect( settings, SIGNAL( terminalFrameRateChanged() ), this, SLOT( applyFrameRate() ) );
+  connect( settings, SIGNAL( terminalMaxRowsChanged() ), this, SLOT( applyTerminalLimits() ) );
+  connect( settings, SIGNAL( terminalMemoryChanged() ), this, SLOT( applyTerminalLimits() ) );
+  connect( settings, SIGNAL( terminalPauseRateChanged() ), this, SLOT( applyPauseRate() ) );
+  connect( settings, SIGNAL( outputBufferSizeChanged() ), this, SLOT( applyOutputLimits() ) );
+  connect( settings, SIGNAL( outputOverflowChanged() ), this, SLOT( applyOutputLimits() ) );
+  connect( settings, SIGNAL( postLogChanged() ), this, SLOT( applyPostLog() ) );
+  connect( settings, SIGNAL( postLogFileSizeChanged() ), this, SLOT( applyPostLog() ) );
+  connect( settings, SIGNAL( postLogFilesChanged() ), this, SLOT( applyPostLog() ) );
+  connect( settings, SIGNAL( standbyLangChanged() ), this, SLOT( applyStandby() ) );
+  applyFrameRate();
+  applyTerminalLimits();
+  applyPauseRate();
+  applyOutputLimits();
+  applyPostLog();
+
+  heartbeat->setInterval( HeartbeatInterval );
+  connect( heartbeat, SIGNAL( timeout() ), this, SLOT( checkHeartbeat() ) );
+  heartbeat->start();
+}
+
+ScateSession::~ScateSession()
+{
+  delete postLog;
+  delete evalTracker;
+  delete evalFiles;
+}
+
+QString ScateSession::postLogDirectory() const
+{
+  return postLog->logDirectory();
+}
+
+void ScateSession::classFileSaved()
+{
+  // a standby that compiled the class library before a class file
+  // changed would bring back the old class
+  if( standby ) {
+    stopStandby();
+    startStandby();
+  }
+}
+
+void ScateSession::applyFrameRate()
+{
+  int fps = settings->terminalFrameRate();
+  outputBuffer->setInterval( fps > 0 ? 1000 / fps : 0 );
+}
+
+void ScateSession::applyTerminalLimits()
+{
+  lineStore->setLimits( settings->terminalMaxRows(), settings->terminalMemory() );
+}
+
+void ScateSession::applyPauseRate()
+{
+  throttle->setThreshold( settings->terminalPauseRate() );
+}
+
+void ScateSession::applyOutputLimits()
+{
+  applyOutputLimit( scProcess );
+  if( standby ) applyOutputLimit( standby );
+}
+
+void ScateSession::applyPostLog()
+{
+  postLog->setEnabled( settings->postLog() );
+  postLog->setLimits( settings->postLogFileSize(), settings->postLogFiles() );
+}
+
+void ScateSession::applyStandby()
+{
+  if( settings->standbyLang() ) startStandby();
+  else stopStandby();
+}
+
+void ScateSession::applyOutputLimit( SCProcess *process )
+{
+  process->setOutputLimit( settings->outputBufferSize(),
+                           (ScatePostReader::Overflow) settings->outputOverflow() );
+}
+
+QString ScateSession::langCommand()
+{
+  ScateSettings::Interpreter interpreter = settings->interpreter( _name );
+  const QString &exe = interpreter.executable;
+  const QString &rtDir = interpreter.runtimeDataDir;
+
+  QString cmd = exe.isEmpty() ? tr( "sclang" ) : exe;
+  cmd += tr( " -i scate" );
+  if( !rtDir.isEmpty() ) cmd.append( " -d " ).append( rtDir );
+  return cmd;
+}
+
+void ScateSession::attachProcess( SCProcess *process )
+{
+  scProcess = process;
+  connect( scProcess, SIGNAL( started() ), this, SLOT( scStarted() ) );
+  connect( scProcess, SIGNAL( langFinished( int, QProcess::ExitStatus ) ),
+           this, SLOT( scFinished( int, QProcess::ExitStatus ) ) );
+  connect( scProcess, SIGNAL( scSays( const ScatePostBatch& ) ),
+           outputBuffer, SLOT( append( const ScatePostBatch& ) ) );
+  _evalQueue->setDevice( scProcess );
+}
+
+void ScateSession::retireProcess( SCProcess *process )
+{
+  disconnect( process, 0, this, 0 );
+  disconnect( process, 0, outputBuffer, 0 );
+  if( process->state() == QProcess::NotRunning ) {
+    process->deleteLater();
+    return;
+  }
+
+  // its output is still read, so that it does not wait on it to quit
+  connect( process, SIGNAL( scSays( const ScatePostBatch& ) ),
+           this, SLOT( discardOutput( const ScatePostBatch& ) ) );
+  connect( process, SIGNAL( langFinished( int, QProcess::ExitStatus ) ),
+           process, SLOT( deleteLater() ) );
+  process->closeWriteChannel();
+  QTimer::singleShot( 5000, process, SLOT( kill() ) );
+}
+
+void ScateSession::discardOutput( const ScatePostBatch &batch )
+{
+  SCProcess *process = qobject_cast<SCProcess*>( sender() );
+  if( process ) process->release( batch.bytes );
+}
+
+void ScateSession::sendProbe()
+{
+  _evalQueue->enqueue( ScateEvalTracker::command( ProbeId ).toUtf8() + "\x1b" );
+  heartbeatSent = ScateEvalTracker::now();
+  ++probesPending;
+}
+
+void ScateSession::checkHeartbeat()
+{
+  // compiling the class library is not a stall
+  int timeout = settings->stallTimeout();
+  if( scProcess->state() != QProcess::Running || startRequested || timeout <= 0 ) return;
+
+  // one at a time, so that a busy interpreter does not pile them up
+  if( !heartbeatSent ) {
+    sendProbe();
+    return;
+  }
+
+  qint64 waiting = ScateEvalTracker::now() - heartbeatSent;
+  if( waiting < timeout * Q_INT64_C(1000000000) ) return;
+  if( !stalled ) {
+    stalled = true;
+    ++stallCount;
+  }
+  emit stalling( waiting );
+}
+
+void ScateSession::endStall()
+{
+  if( !stalled ) return;
+  stalled = false;
+  emit responsive();
+}
+
+void ScateSession::interrupt()
+{
+  if( scProcess->state() == QProcess::NotRunning ) return;
+  // a signal reaches the interpreter even while it does not read its input
+  ::kill( scProcess->pid(), SIGINT );
+  sysMsg( "Interrupt signal sent to the interpreter." );
+}
+
+void ScateSession::startStandby()
+{
+  if( !settings->standbyLang() || standby || scProcess->state() != QProcess::Running ) return;
+
+  standby = new SCProcess( this );
+  standbyReady = false;
+  standbyOutput = ScatePostBatch();
+  standbyLaunched = ScateEvalTracker::now();
+  applyOutputLimit( standby );
+  connect( standby, SIGNAL( started() ), this, SLOT( standbyStarted() ) );
+  connect( standby, SIGNAL( scSays( const ScatePostBatch& ) ),
+           this, SLOT( standbySays( const ScatePostBatch& ) ) );
+  connect( standby, SIGNAL( langFinished( int, QProcess::ExitStatus ) ),
+           this, SLOT( standbyFinished() ) );
+  if( !standby->launch( langCommand() ) ) {
+    delete standby;
+    standby = 0;
+  }
+}
+
+void ScateSession::standbyStarted()
+{
+  // answered once the class library is compiled and input is read
+  standby->write( ScateEvalTracker::command( ProbeId ).toUtf8() + "\x1b" );
+}
+
+void ScateSession::standbySays( const ScatePostBatch &output )
+{
+  standby->release( output.bytes );
+
+  ScatePostBatch batch = output;
+  foreach( const ScateEvalAck &ack, batch.acks ) {
+    if( ack.id == ProbeId && !standbyReady ) {
+      standbyReady = true;
+      sysMsg( QString("Standby interpreter ready, %1 after it was started.")
+              .arg( ScateEvalTracker::formatLatency( ack.time - standbyLaunched ) ) );
+    }
+  }
+  batch.acks.clear();
+
+  // the beginning is kept, which tells how the class library compiled
+  if( standbyOutput.lines.count() < 1000 ) standbyOutput.append( batch );
+}
+
+void ScateSession::standbyFinished()
+{
+  if( !standby ) return;
+  standby->deleteLater();
+  standby = 0;
+  standbyReady = false;
+  standbyOutput = ScatePostBatch();
+  sysMsg( "The standby interpreter stopped." );
+}
+
+void ScateSession::stopStandby()
+{
+  if( !standby ) return;
+  SCProcess *process = standby;
+  standby = 0;
+  standbyReady = false;
+  standbyOutput = ScatePostBatch();
+  retireProcess( process );
+}
+
+void ScateSession::swapToStandby()
+{
+  // what the current interpreter posted still goes through it
+  outputBuffer->flush();
+
+  SCProcess *process = standby;
+  disconnect( process, 0, this, 0 );
+  standby = 0;
+  bool ready = standbyReady;
+  standbyReady = false;
+
+  bool wasRunning = langRunning();
+  retireProcess( scProcess );
+  attachProcess( process );
+  evalTracker->reset();
+  evalFiles->clear();
+  evalError = false;
+  restart = false;
+  heartbeatSent = 0;
+  probesPending = 0;
+  endStall();
+  if( wasRunning ) {
+    emit langSwitched( false );
+    emit serverSwitched( false );
+  }
+
+  // what the standby posted while starting, e.g. about compiling
+  if( !standbyOutput.isEmpty() ) {
+    postLog->write( standbyOutput );
+    display( standbyOutput );
+    standbyOutput = ScatePostBatch();
+  }
+  sysMsg( ready ? "Switched to the standby interpreter."
+                : "Switched to the standby interpreter, which is still starting." );
+
+  startAction = "switch to the standby";
+  emit langSwitched( true );
+  sendProbe();
+  startStandby();
+}
+
+void ScateSession::startLang()
+{
+  QProcess::ProcessState state = scProcess->state();
+  if( state == QProcess::Starting ) {
+      printf("\nInterpreter already starting.\n\n");
+      return;
+  }
+  else if( state == QProcess::Running ) {
+      printf("\nInterpreter already running.\n\n");
+      return;
+  }
+  else if( state != QProcess::NotRunning ) {
+    return;
+  }
+
+  if( !startRequested ) startRequested = ScateEvalTracker::now();
+  if( standby && standby->state() == QProcess::Running ) {
+    swapToStandby();
+    return;
+  }
+
+  sysMsg( "Interpreter starting." );
+
+  QString cmd = langCommand();
+  printf("Trying to start with command:\n");
+  printf( "%s\n", cmd.toStdString().c_str() );
+
+  startAction = "start";
+  if( !scProcess->launch( cmd ) ) {
+    startRequested = 0;
+    sysMsg( "ERROR: Could not set up the interpreter's output channel." );
+  }
+}
+
+void ScateSession::stopLang()
+{
+  stopStandby();
+  scProcess->closeWriteChannel();
+}
+
+void ScateSession::sysMsg( const QString &msg )
+{
+  // keep system messages in order with buffered interpreter output
+  outputBuffer->flush();
+  ScatePostBatch batch = ScatePostBatch::fromText( tr("\n") + msg + tr("\n\n") );
+  postLog->write( batch );
+  display( batch );
+}
+
+void ScateSession::flushOutput( const ScatePostBatch &output )
+{
+  scProcess->release( output.bytes );
+
+  ScatePostBatch batch = output;
+  int line = 0;
+  QString ready;
+  for( int i = 0; i < batch.acks.count(); ++i ) {
+    ScateEvalAck &ack = batch.acks[i];
+    for( ; line < ack.after && line < batch.lines.count(); ++line )
+      if( batch.lines[line].kind == ScatePostLine::Error ) evalError = true;
+
+    if( ack.id == ProbeId ) {
+      if( probesPending > 0 ) --probesPending;
+      if( heartbeatSent ) {
+        lastHeartbeat = ack.time - heartbeatSent;
+        maxHeartbeat = qMax( maxHeartbeat, lastHeartbeat );
+        heartbeatSent = 0;
+      }
+      if( stalled ) {
+        endStall();
+        ready = QString("Interpreter responds again, after %1.")
+          .arg( ScateEvalTracker::formatLatency( lastHeartbeat ) );
+      }
+      // a heartbeat sent before a recompile is answered before it
+      if( startRequested && !probesPending ) {
+        lastStartTime = ack.time - startRequested;
+        startRequested = 0;
+        ready = QString("Interpreter accepts input, %1 after it was asked to %2.")
+          .arg( ScateEvalTracker::formatLatency( lastStartTime ) )
+          .arg( startAction );
+      }
+      evalError = false;
+      continue;
+    }
+
+    qint64 latency = evalTracker->finish( ack );
+    evalFiles->release( ack.id );
+    if( latency >= 0 ) {
+      ack.note = ScateEvalTracker::formatLatency( latency );
+      emit evalFinished( ack.id, latency, evalError );
+    }
+    evalError = false;
+  }
+  for( ; line < batch.lines.count(); ++line )
+    if( batch.lines[line].kind == ScatePostLine::Error ) evalError = true;
+
+  postLog->write( batch );
+  if( throttle->pass( batch ) ) display( batch );
+  if( !ready.isEmpty() ) sysMsg( ready );
+}
+
+void ScateSession::display( const ScatePostBatch &batch )
+{
+  lineStore->append( batch );
+  emit scPosted( batch );
+  emit scSaid( batch.text() );
+}
+
+void ScateSession::resumeOutput()
+{
+  throttle->resume();
+}
+
+void ScateSession::onOutputResumed( qint64 lines )
+{
+  emit outputResumed();
+  if( lines == 0 ) return;
+  QString msg = QString("%1 lines of output were not displayed.").arg( lines );
+  if( postLog->isEnabled() ) msg += " They can be found in the post log.";
+  sysMsg( msg );
+}
+
+void ScateSession::scStarted()
+{
+  evalTracker->reset();
+  evalError = false;
+  emit langSwitched( true );
+  sendProbe();
+  startStandby();
+}
+
+void ScateSession::scFinished( int exitCode, QProcess::ExitStatus exitStatus )
+{
+  Q_UNUSED( exitCode );
+  QString msg;
+  switch( exitStatus ) {
+    /*case QProcess::CrashExit:
+      msg = "ERROR: Interpreter crashed!"; break;*/
+    case QProcess::NormalExit:
+    default:
+      msg = "Interpreter stopped.";
+  }
+
+  _evalQueue->clear();
+  evalFiles->clear();
+  heartbeatSent = 0;
+  probesPending = 0;
+  endStall();
+  if( !restart ) startRequested = 0;
+  sysMsg( msg );
+  emit( langSwitched( false ) );
+  emit( serverSwitched( false ) );
+
+  if( restart ) {
+    restart = false;
+    startLang();
+  }
+}
+
+void ScateSession::startServer()
+{
+  eval( "Server.default.boot;", true );
+  emit( serverSwitched( true ) );
+}
+
+void ScateSession::stopServer()
+{
+  eval( "Server.default.quit;", true );
+  emit( serverSwitched( false ) );
+}
+
+void ScateSession::startSwingOSC()
+{
+  eval( QString("SwingOSC.program=\"%1\";").arg( settings->swingOscProgram() ), true );
+  eval( "SwingOSC.default.boot;", true );
+}
+
+void ScateSession::stopSwingOSC()
+{
+  eval( "SwingOSC.default.quit;", true );
+}
+
+void ScateSession::switchLang( bool on )
+{
+  restart = false;
+  if( on ) startLang();
+  else stopLang();
+}
+
+void ScateSession::switchServer( bool on )
+{
+  if( on ) startServer();
+  else stopServer();
+}
+
+void ScateSession::switchSwingOsc( bool on )
+{
+  if( on ) startSwingOSC();
+  else stopSwingOSC();
+}
+
+void ScateSession::stopProcessing()
+{
+  // don't make stopping wait for evaluations that are still queued
+  _evalQueue->cancelPending();
+  eval( "thisProcess.stop;", true );
+  sysMsg( "All processing stopped." );
+}
+
+void ScateSession::switchToQt() {
+  eval( "GUI.qt" );
+}
+
+void ScateSession::switchToSwing() {
+  eval( "GUI.swing" );
+}
+
+void ScateSession::printStatistics()
+{
+  const ScateOutputBuffer::Stats &out = outputBuffer->stats();
+  QString msg("Output statistics:\n");
+  msg += QString("  chunks received: %1\n").arg( out.chunks );
+  msg += QString("  bytes received: %1 (%2 from standard error)\n")
+    .arg( out.bytes ).arg( out.stderrBytes );
+  if( out.decodeTime > 0 ) {
+    double mbPerSec = out.bytes * 1000.0 / out.decodeTime;
+    msg += QString("  decoding throughput: %1 MB/s\n").arg( mbPerSec, 0, 'f', 1 );
+  }
+  msg += QString("  terminal updates: %1\n").arg( out.flushes );
+  msg += QString("  chunks merged: %1\n").arg( out.chunks - out.flushes );
+  msg += QString("  most chunks in one update: %1\n").arg( out.maxChunksPerFlush );
+  msg += QString("  lines dropped: %1\n").arg( out.dropped );
+  msg += QString("  bytes spilled to disk: %1\n").arg( out.spilled );
+  msg += QString("  interpreter blocked on output: %1 ms\n").arg( out.blockedTime / 1000000 );
+  msg += QString("  lines suppressed: %1\n").arg( throttle->totalSuppressed() );
+  msg += QString("  terminal lines: %1 (%2 KiB)")
+    .arg( lineStore->count() ).arg( lineStore->memoryUsage() / 1024 );
+  if( !postLog->fileName().isEmpty() )
+    msg += QString("\n  post log: %1").arg( postLog->fileName() );
+
+  const ScateEvalQueue::Stats &queue = _evalQueue->stats();
+  msg += QString("\n  evaluations sent: %1 (%2 bytes), cancelled: %3\n")
+    .arg( queue.sent ).arg( queue.bytesSent ).arg( queue.cancelled );
+  msg += QString("  evaluation queue: %1 queued (%2 bytes), %3 bytes in flight")
+    .arg( _evalQueue->depth() ).arg( _evalQueue->queuedBytes() )
+    .arg( _evalQueue->bytesInFlight() );
+  msg += QString("\n  syntax checks: %1 (%2 rejected)").arg( checkCount ).arg( checkFailures );
+  if( checkCount )
+    msg += QString(", %1 us each").arg( checkTime / 1000.0 / checkCount, 0, 'f', 1 );
+  msg += QString("\n  standby interpreter: %1")
+    .arg( !settings->standbyLang() ? "off" : !standby ? "none" : standbyReady ? "ready" : "starting" );
+  if( lastStartTime >= 0 ) {
+    msg += QString("\n  last (re)start: %1 until accepting input")
+      .arg( ScateEvalTracker::formatLatency( lastStartTime ) );
+  }
+  if( lastHeartbeat >= 0 ) {
+    msg += QString("\n  heartbeat: last answered in %1, slowest %2, stalls: %3")
+      .arg( ScateEvalTracker::formatLatency( lastHeartbeat ) )
+      .arg( ScateEvalTracker::formatLatency( maxHeartbeat ) )
+      .arg( stallCount );
+  }
+
+  msg += QString("\n\nEvaluation paths (file above %1 KiB):\n").arg( settings->evalFileThreshold() / 1024 );
+  const char *routeNames[] = { "pipe", "file" };
+  for( int r = 0; r < ScateEvalTracker::RouteCount; ++r ) {
+    const ScateEvalTracker::RouteStats &route =
+      evalTracker->routeStats( (ScateEvalTracker::Route) r );
+    msg += QString("  %1: %2 evaluations, %3 bytes").arg( routeNames[r] )
+      .arg( route.count ).arg( route.bytes );
+    if( route.count ) {
+      msg += QString(", mean latency %1")
+        .arg( ScateEvalTracker::formatLatency( route.latency / route.count ) );
+      if( route.latency > 0 )
+        msg += QString(", %1 MB/s").arg( route.bytes * 1000.0 / route.latency, 0, 'f', 1 );
+    }
+    msg += "\n";
+  }
+  if( evalFiles->writeCount() ) {
+    msg += QString("  time writing files: %1 per evaluation\n")
+      .arg( ScateEvalTracker::formatLatency( evalFiles->writeTime() / evalFiles->writeCount() ) );
+  }
+  msg.chop( 1 );
+
+  msg += QString("\n\nEvaluation latency (last %1 of %2 evaluations, %3 pending):\n")
+    .arg( evalTracker->sampleCount() ).arg( evalTracker->totalCount() )
+    .arg( evalTracker->pendingCount() );
+  if( evalTracker->sampleCount() ) {
+    msg += QString("  p50: %1   p95: %2   p99: %3\n")
+      .arg( ScateEvalTracker::formatLatency( evalTracker->percentile( 0.5 ) ) )
+      .arg( ScateEvalTracker::formatLatency( evalTracker->percentile( 0.95 ) ) )
+      .arg( ScateEvalTracker::formatLatency( evalTracker->percentile( 0.99 ) ) );
+    msg += evalTracker->histogram();
+  }
+  msg.chop( 1 );
+  sysMsg( msg );
+}
+
+int ScateSession::eval( const QString& cmd, bool silent, ScateSyntaxCheck::Error *error )
+{
+  if( !langRunning() ) {
+    sysMsg( "Interpreter not running!" );
+    return -1;
+  }
+
+  // spare the interpreter code it would only answer with a parse error
+  qint64 checkStart = ScateEvalTracker::now();
+  ScateSyntaxCheck::Error syntaxError = ScateSyntaxCheck::check( cmd );
+  checkTime += ScateEvalTracker::now() - checkStart;
+  ++checkCount;
+  if( syntaxError.isValid() ) {
+    ++checkFailures;
+    if( error ) *error = syntaxError;
+    else sysMsg( syntaxError.text() );
+    return -1;
+  }
+
+  QByteArray code = cmd.toUtf8();
+  QString fileName;
+  // large code is passed in a file, so it does not hold up the input
+  int evalFileThreshold = settings->evalFileThreshold();
+  if( evalFileThreshold > 0 && code.size() >= evalFileThreshold )
+    fileName = evalFiles->write( code );
+
+  ScateEvalTracker::Route route = fileName.isEmpty() ? ScateEvalTracker::Pipe
+                                                     : ScateEvalTracker::File;
+  int id = evalTracker->begin( route, code.size() );
+
+  QByteArray str;
+  if( route == ScateEvalTracker::File ) {
+    evalFiles->track( id, fileName );
+    str = ScateEvalFiles::command( fileName ).toUtf8();
+  }
+  else
+    str = code;
+  str += silent ? "\x1b" : "\x0c";
+  // have the interpreter acknowledge the evaluation once it is done with it
+  str += ScateEvalTracker::command( id ).toUtf8() + "\x1b";
+  _evalQueue->enqueue( str, id );
+  return id;
+}
+
+void ScateSession::benchmarkSyntaxCheck( const QString &directory )
+{
+  QStringList names;
+  QStringList sources;
+  qint64 bytes = 0;
+  QDirIterator it( directory, QStringList() << "*.sc", QDir::Files,
+                   QDirIterator::Subdirectories | QDirIterator::FollowSymlinks );
+  while( it.hasNext() ) {
+    QFile file( it.next() );
+    if( !file.open( QIODevice::ReadOnly ) ) continue;
+    QByteArray data = file.readAll();
+    bytes += data.size();
+    names.append( it.filePath() );
+    sources.append( QString::fromUtf8( data ) );
+  }
+  if( sources.isEmpty() ) {
+    sysMsg( QString("No class files found in %1").arg( directory ) );
+    return;
+  }
+
+  // the best of several runs, which leaves out the cost of first
+  // touching the code
+  QStringList rejected;
+  qint64 best = -1;
+  for( int run = 0; run < 5; ++run ) {
+    qint64 start = ScateEvalTracker::now();
+    for( int i = 0; i < sources.count(); ++i ) {
+      ScateSyntaxCheck::Error error = ScateSyntaxCheck::check( sources[i] );
+      if( error.isValid() && run == 0 )
+        rejected.append( QString("  %1: %2").arg( names[i] ).arg( error.text() ) );
+    }
+    qint64 time = ScateEvalTracker::now() - start;
+    if( best < 0 || time < best ) best = time;
+  }
+
+  QString msg = QString("Syntax check of %1 class files (%2 KiB) in %3:\n")
+    .arg( sources.count() ).arg( bytes / 1024 ).arg( directory );
+  msg += QString("  %1 in total, %2 us per file")
+    .arg( ScateEvalTracker::formatLatency( best ) )
+    .arg( best / 1000.0 / sources.count(), 0, 'f', 1 );
+  if( best > 0 ) msg += QString(", %1 MB/s").arg( bytes * 1000.0 / best, 0, 'f', 1 );
+  msg += QString("\n  files rejected: %1").arg( rejected.count() );
+  for( int i = 0; i < rejected.count() && i < 20; ++i )
+    msg += "\n" + rejected[i];
+  sysMsg( msg );
+}
+
+void ScateSession::onEvalCancelled( int id )
+{
+  evalTracker->cancel( id );
+  evalFiles->release( id );
+}
+
+void ScateSession::restartLang()
+{
+  startRequested = ScateEvalTracker::now();
+  if( standby && standby->state() == QProcess::Running ) {
+    swapToStandby();
+    return;
+  }
+  restart = true;
+  stopLang();
+}
+
+void ScateSession::recompileLibrary()
+{
+  // the standby has compiled the class library already
+  if( standby && standby->state() == QProcess::Running ) {
+    restartLang();
+    return;
+  }
+  // the heartbeat pauses until the library is compiled
+  startRequested = ScateEvalTracker::now();
+  startAction = "recompile the class library";
+  _evalQueue->enqueue( "\x18" );
+  sendProbe();
+}
+
+bool ScateSession::langRunning()
+{ return scProcess->state() != QProcess::NotRunning; }
+
+bool ScateSession::serverRunning()
+{ return false; }
@@ -0,0 +1,225 @@
+/*
+#
+# Copyright 2010-2011 Jakob Leben (jakob.leben@gmail.com)
+#
+# This file is part of Scate - a SuperCollider plugin for Kate
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+*/
+
+#ifndef SCATE_SESSION_H
+#define SCATE_SESSION_H
+
+#include "ScatePost.hpp"
+#include "ScatePostReader.hpp"
+#include "ScateSyntaxCheck.hpp"
+
+#include <QObject>
+#include <QProcess>
+
+class SCProcess;
+class ScateSettings;
+class QTimer;
+class ScateLineStore;
+class ScateOutputBuffer;
+class ScatePostLog;
+class ScateOutputThrottle;
+class ScateEvalTracker;
+class ScateEvalQueue;
+class ScateEvalFiles;
+
+// A named interpreter with its own process, terminal output and evaluation
+// queue. Sessions run side by side, so a long job in one does not hold up
+// evaluation in another.
+// Sessions share all settings except for the interpreter command and
+// runtime directory.
+
+class ScateSession : public QObject
+{
+  Q_OBJECT
+
+  public:
+    ScateSession( const QString &name, ScateSettings *, QObject *parent = 0 );
+    ~ScateSession();
+
+    inline QString name() const { return _name; }
+    // Where the post logs of the session are written.
+    QString postLogDirectory() const;
+    inline bool isDefault() const { return _name == defaultName(); }
+    static QString defaultName() { return "Default"; }
+
+    // To be called when a class file was saved.
+    void classFileSaved();
+
+    bool langRunning();
+    bool serverRunning();
+    inline ScateLineStore *terminalLines() { return lineStore; }
+    inline ScateEvalQueue *evalQueue() { return _evalQueue; }
+    // The interpreter has not answered a heartbeat within the timeout.
+    inline bool isStalled() const { return stalled; }
+    // Prints a message to the terminal.
+    void sysMsg( const QString & );
+
+  signals:
+    void scSaid( const QString& );
+    void scPosted( const ScatePostBatch& );
+    void langSwitched( bool );
+    void serverSwitched( bool );
+    void swingOscSwitched( bool );
+    // display of output is paused because there is too much of it
+    void outputSuppressed( qint64 lines, double linesPerSecond, double bytesPerSecond );
+    void outputResumed();
+    // an evaluation was acknowledged; 'failed' if it posted an error
+    void evalFinished( int id, qint64 latency, bool failed );
+    // emitted regularly while the interpreter does not answer
+    void stalling( qint64 nsecs );
+    void responsive();
+
+  public slots:
+    void startLang();
+    void stopLang();
+    void switchLang( bool );
+    void switchServer( bool );
+    void switchSwingOsc( bool );
+    void restartLang();
+    void recompileLibrary();
+    void startServer();
+    void stopServer();
+    void startSwingOSC();
+    void stopSwingOSC();
+    // Returns the id of the evaluation, or -1 if the interpreter is not
+    // running or the code has a syntax error. The error is stored in
+    // 'error' if given, or else printed.
+    int eval( const QString&, bool silent = false, ScateSyntaxCheck::Error *error = 0 );
+    void stopProcessing();
+    void switchToQt();
+    void switchToSwing();
+    void printStatistics();
+    // Times the syntax check on the class files in a directory.
+    void benchmarkSyntaxCheck( const QString &directory );
+    // shows output again after it was suppressed
+    void resumeOutput();
+    // Sends the interpreter an interrupt signal.
+    void interrupt();
+  private slots:
+    void scStarted();
+    void scFinished( int, QProcess::ExitStatus );
+    void flushOutput( const ScatePostBatch& );
+    void onOutputResumed( qint64 lines );
+    void onEvalCancelled( int id );
+    void startStandby();
+    void standbyStarted();
+    void standbySays( const ScatePostBatch & );
+    void standbyFinished();
+    void discardOutput( const ScatePostBatch & );
+    void applyFrameRate();
+    void applyTerminalLimits();
+    void applyPauseRate();
+    void applyOutputLimits();
+    void applyPostLog();
+    void applyStandby();
+    void checkHeartbeat();
+  private:
+    void display( const ScatePostBatch & );
+    void applyOutputLimit( SCProcess * );
+    QString langCommand();
+    void attachProcess( SCProcess * );
+    // Lets a process quit, ignoring it from now on.
+    void retireProcess( SCProcess * );
+    void stopStandby();
+    // Makes the standby interpreter the current one.
+    void swapToStandby();
+    // Has the interpreter acknowledge when it accepts input; serves as
+    // heartbeat too.
+    void sendProbe();
+    void endStall();
+    QString _name;
+    ScateSettings *settings;
+    SCProcess *scProcess;
+    ScateOutputBuffer *outputBuffer;
+    ScateLineStore *lineStore;
+    ScatePostLog *postLog;
+    ScateOutputThrottle *throttle;
+    ScateEvalTracker *evalTracker;
+    ScateEvalQueue *_evalQueue;
+    ScateEvalFiles *evalFiles;
+    // an error was posted since the last acknowledgement
+    bool evalError;
+    quint64 checkCount;
+    quint64 checkFailures;
+    // nanoseconds spent checking syntax
+    qint64 checkTime;
+    // A second interpreter that has already compiled the class library, to
+    // take over on restart.
+    SCProcess *standby;
+    bool standbyReady;
+    qint64 standbyLaunched;
+    // output of the standby while starting, shown when it takes over
+    ScatePostBatch standbyOutput;
+    // when the interpreter was asked to (re)start or recompile, or 0, and
+    // what it was asked to do
+    qint64 startRequested;
+    const char *startAction;
+    // time from the last (re)start to an interpreter accepting input
+    qint64 lastStartTime;
+    QTimer *heartbeat;
+    // when the unanswered heartbeat was sent, or 0
+    qint64 heartbeatSent;
+    // probes sent and not answered yet; starting ends with the last
+    int probesPending;
+    // time the last heartbeat took to be answered, and the longest
+    qint64 lastHeartbeat;
+    qint64 maxHeartbeat;
+    bool stalled;
+    quint64 stallCount;
+    bool restart;
+};
+
+// The interpreter's standard output and standard error are redirected into
+// pipes of our own, which are read by a ScatePostReader thread instead of by
+// QProcess, so that neither piles up unread in QProcess's buffers.
+
+class SCProcess : public QProcess
+{
+  Q_OBJECT
+  public:
+    SCProcess( QObject *parent = 0 );
+    ~SCProcess();
+    bool launch( const QString &command );
+    void setOutputLimit( int bytes, ScatePostReader::Overflow );
+    // to be called when output received through scSays has been consumed
+    void release( int bytes );
+  signals:
+    void scSays( const ScatePostBatch& );
+    // emitted after all the output of the process has been delivered
+    void langFinished( int, QProcess::ExitStatus );
+  protected:
+    void setupChildProcess();
+  private slots:
+    void onFinished( int, QProcess::ExitStatus );
+    void onError( QProcess::ProcessError );
+    void notifyFinished();
+  private:
+    void stopReader();
+    ScatePostReader *reader;
+    int outputLimit;
+    ScatePostReader::Overflow overflow;
+    int childOut;
+    int childErr;
+    int exitCode;
+    QProcess::ExitStatus exitStatus;
+};
+
+#endif // SCATE_SESSION_H
@@ -0,0 +1,147 @@
+/*
+#
+# Copyright 2010-2011 Jakob Leben (jakob.leben@gmail.com)
+#
+# This file is part of Scate - a SuperCollider plugin for Kate
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+*/
+
+#include "ScateSettings.hpp"
+#include "ScateSession.hpp"
+#include "ScatePostReader.hpp"
+
+#include <kglobal.h>
+
+#include <QBitArray>
+
+// Sets a field, telling whether its value changed.
+template <typename T>
+static bool assign( T &field, const T &value )
+{
+  if( field == value ) return false;
+  field = value;
+  return true;
+}
+
+ScateSettings::ScateSettings( QObject *parent ) :
+  QObject( parent ),
+  _startLang( false ),
+  _standbyLang( false ),
+  _evalFileThreshold( 0 ),
+  _stallTimeout( 0 ),
+  _terminalMaxRows( 0 ),
+  _terminalMemory( 0 ),
+  _terminalFrameRate( 0 ),
+  _terminalPauseRate( 0 ),
+  _outputBufferSize( 0 ),
+  _outputOverflow( 0 ),
+  _postLog( false ),
+  _postLogFileSize( 0 ),
+  _postLogFiles( 0 ),
+  _helpFontScale( 1.0 )
+{
+  load();
+}
+
+KConfigGroup ScateSettings::sessionGroup( const QString &session )
+{
+  if( session == ScateSession::defaultName() ) return KConfigGroup( KGlobal::config(), "Scate" );
+  return KConfigGroup( KGlobal::config(), "Scate Session " + session );
+}
+
+ScateSettings::Interpreter ScateSettings::interpreter( const QString &session ) const
+{
+  return interpreters.value( session );
+}
+
+void ScateSettings::load()
+{
+  KConfigGroup config(KGlobal::config(), "Scate");
+  QBitArray changed( FieldCount );
+
+  QStringList sessions;
+  foreach( QString name, config.readEntry( "Sessions", QStringList() ) ) {
+    if( !name.isEmpty() && name != ScateSession::defaultName() && !sessions.contains( name ) )
+      sessions.append( name );
+  }
+  changed.setBit( Sessions, assign( _sessions, sessions ) );
+
+  interpreters.clear();
+  foreach( const QString &name, QStringList( ScateSession::defaultName() ) + _sessions ) {
+    KConfigGroup group = sessionGroup( name );
+    Interpreter interpreter;
+    interpreter.executable = group.readEntry( "ScLangExecutable", QString() );
+    interpreter.runtimeDataDir = group.readEntry( "RuntimeDataDir", QString() );
+    interpreters.insert( name, interpreter );
+  }
+
+  _startLang = config.readEntry( "StartLang", false );
+  changed.setBit( StandbyLang, assign( _standbyLang, config.readEntry( "StandbyLang", false ) ) );
+  _evalFileThreshold = config.readEntry( "EvalFileThreshold", 512 ) * 1024;
+  _swingOscProgram = config.readEntry( "SwingOscProgram", QString() );
+  _stallTimeout = config.readEntry( "StallTimeout", 5 );
+
+  changed.setBit( TerminalMaxRows,
+    assign( _terminalMaxRows, config.readEntry( "TerminalMaxRows", 1000000 ) ) );
+  changed.setBit( TerminalMemory,
+    assign( _terminalMemory, config.readEntry( "TerminalMemory", 64 ) * qint64(1024 * 1024) ) );
+  changed.setBit( TerminalFrameRate,
+    assign( _terminalFrameRate, config.readEntry( "TerminalFrameRate", 60 ) ) );
+  changed.setBit( TerminalPauseRate,
+    assign( _terminalPauseRate, config.readEntry( "TerminalPauseRate", 20000 ) ) );
+  QFont defaultFont("monospace");
+  defaultFont.setStyleHint(QFont::TypeWriter);
+  changed.setBit( TerminalFont,
+    assign( _terminalFont, config.readEntry( "TerminalFont", defaultFont ) ) );
+  changed.setBit( OutputBufferSize,
+    assign( _outputBufferSize, config.readEntry( "OutputBufferSize", 16 ) * 1024 * 1024 ) );
+  int overflow = qBound( 0, config.readEntry( "OutputOverflow", (int) ScatePostReader::Block ), 2 );
+  changed.setBit( OutputOverflow, assign( _outputOverflow, overflow ) );
+  changed.setBit( PostLog, assign( _postLog, config.readEntry( "PostLog", true ) ) );
+  changed.setBit( PostLogFileSize,
+    assign( _postLogFileSize, config.readEntry( "PostLogFileSize", 32 ) * qint64(1024 * 1024) ) );
+  changed.setBit( PostLogFiles, assign( _postLogFiles, config.readEntry( "PostLogFiles", 10 ) ) );
+
+  changed.setBit( HelpDirs,
+    assign( _helpDirs, config.readPathEntry( "HelpDirs", QStringList() ) ) );
+  changed.setBit( HelpFontScale,
+    assign( _helpFontScale, config.readEntry( "HelpFontScale", 1.0 ) ) );
+
+  // only once all fields are up to date
+  for( int i = 0; i < FieldCount; ++i )
+    if( changed.testBit( i ) ) notify( (Field) i );
+}
+
+void ScateSettings::notify( Field field )
+{
+  switch( field ) {
+    case Sessions: emit sessionsChanged(); break;
+    case StandbyLang: emit standbyLangChanged(); break;
+    case TerminalMaxRows: emit terminalMaxRowsChanged(); break;
+    case TerminalMemory: emit terminalMemoryChanged(); break;
+    case TerminalFrameRate: emit terminalFrameRateChanged(); break;
+    case TerminalPauseRate: emit terminalPauseRateChanged(); break;
+    case TerminalFont: emit terminalFontChanged(); break;
+    case OutputBufferSize: emit outputBufferSizeChanged(); break;
+    case OutputOverflow: emit outputOverflowChanged(); break;
+    case PostLog: emit postLogChanged(); break;
+    case PostLogFileSize: emit postLogFileSizeChanged(); break;
+    case PostLogFiles: emit postLogFilesChanged(); break;
+    case HelpDirs: emit helpDirsChanged(); break;
+    case HelpFontScale: emit helpFontScaleChanged(); break;
+    default: break;
+  }
+}
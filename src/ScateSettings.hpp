@@ -0,0 +1,145 @@
+/*
+#
+# Copyright 2010-2011 Jakob Leben (jakob.leben@gmail.com)
+#
+# This file is part of Scate - a SuperCollider plugin for Kate
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+*/
+
+#ifndef SCATE_SETTINGS_H
+#define SCATE_SETTINGS_H
+
+#include <kconfiggroup.h>
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QFont>
+#include <QHash>
+
+// The configuration of Scate, read from KConfig once and kept in typed
+// fields, so that it costs nothing to look up. load() reads it again after
+// the configuration changed, and emits a signal for each field that
+// differs, so that every part of the plugin only reapplies what it uses.
+// Settings that are only read when used have no signal.
+
+class ScateSettings : public QObject
+{
+  Q_OBJECT
+
+  public:
+    // How to start the interpreter of a session.
+    struct Interpreter {
+      bool operator==( const Interpreter &other ) const
+      { return executable == other.executable && runtimeDataDir == other.runtimeDataDir; }
+      QString executable;
+      QString runtimeDataDir;
+    };
+
+    ScateSettings( QObject *parent = 0 );
+    void load();
+    // The group holding the interpreter of a session.
+    static KConfigGroup sessionGroup( const QString &session );
+
+    // sessions besides the default one
+    inline const QStringList &sessions() const { return _sessions; }
+    Interpreter interpreter( const QString &session ) const;
+    inline bool startLang() const { return _startLang; }
+    inline bool standbyLang() const { return _standbyLang; }
+    // in bytes; 0 never
+    inline int evalFileThreshold() const { return _evalFileThreshold; }
+    inline const QString &swingOscProgram() const { return _swingOscProgram; }
+    // seconds without an answer to a heartbeat until the interpreter counts
+    // as stalled; 0 never
+    inline int stallTimeout() const { return _stallTimeout; }
+
+    inline int terminalMaxRows() const { return _terminalMaxRows; }
+    // in bytes
+    inline qint64 terminalMemory() const { return _terminalMemory; }
+    // 0 unlimited
+    inline int terminalFrameRate() const { return _terminalFrameRate; }
+    // lines per second; 0 never
+    inline int terminalPauseRate() const { return _terminalPauseRate; }
+    inline const QFont &terminalFont() const { return _terminalFont; }
+    // in bytes
+    inline int outputBufferSize() const { return _outputBufferSize; }
+    inline int outputOverflow() const { return _outputOverflow; }
+    inline bool postLog() const { return _postLog; }
+    // in bytes
+    inline qint64 postLogFileSize() const { return _postLogFileSize; }
+    inline int postLogFiles() const { return _postLogFiles; }
+
+    inline const QStringList &helpDirs() const { return _helpDirs; }
+    inline double helpFontScale() const { return _helpFontScale; }
+
+  signals:
+    void sessionsChanged();
+    void standbyLangChanged();
+    void terminalMaxRowsChanged();
+    void terminalMemoryChanged();
+    void terminalFrameRateChanged();
+    void terminalPauseRateChanged();
+    void terminalFontChanged();
+    void outputBufferSizeChanged();
+    void outputOverflowChanged();
+    void postLogChanged();
+    void postLogFileSizeChanged();
+    void postLogFilesChanged();
+    void helpDirsChanged();
+    void helpFontScaleChanged();
+
+  private:
+    enum Field {
+      Sessions,
+      StandbyLang,
+      TerminalMaxRows,
+      TerminalMemory,
+      TerminalFrameRate,
+      TerminalPauseRate,
+      TerminalFont,
+      OutputBufferSize,
+      OutputOverflow,
+      PostLog,
+      PostLogFileSize,
+      PostLogFiles,
+      HelpDirs,
+      HelpFontScale,
+      FieldCount
+    };
+    void notify( Field );
+
+    QStringList _sessions;
+    QHash<QString, Interpreter> interpreters;
+    bool _startLang;
+    bool _standbyLang;
+    int _evalFileThreshold;
+    QString _swingOscProgram;
+    int _stallTimeout;
+    int _terminalMaxRows;
+    qint64 _terminalMemory;
+    int _terminalFrameRate;
+    int _terminalPauseRate;
+    QFont _terminalFont;
+    int _outputBufferSize;
+    int _outputOverflow;
+    bool _postLog;
+    qint64 _postLogFileSize;
+    int _postLogFiles;
+    QStringList _helpDirs;
+    double _helpFontScale;
+};
+
+#endif // SCATE_SETTINGS_H
@@ -0,0 +1,158 @@
+/*
+#
+# Copyright 2010-2011 Jakob Leben (jakob.leben@gmail.com)
+#
+# This file is part of Scate - a SuperCollider plugin for Kate
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+*/
+
+#include "ScateStreamDecoder.hpp"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+static const ushort replacementChar = 0xFFFD;
+
+// room for SIMD stores past the end of the decoded text
+static const int slack = 20;
+
+ScateStreamDecoder::ScateStreamDecoder()
+{
+  buf.resize( 256 );
+  reset();
+}
+
+void ScateStreamDecoder::reset()
+{
+  length = taken = 0;
+  partial = minValue = 0;
+  need = 0;
+}
+
+QString ScateStreamDecoder::takeFragment()
+{
+  int end = length;
+  // a carriage return may still turn out to be part of a line break
+  if( end > taken && buf[end-1] == '\r' ) --end;
+  QString text( line() + taken, end - taken );
+  taken = end;
+  return text;
+}
+
+inline ushort *ScateStreamDecoder::finishSequence( ushort *out )
+{
+  uint c = partial;
+  if( c < minValue || c > 0x10FFFF || ( c >= 0xD800 && c <= 0xDFFF ) ) {
+    *out++ = replacementChar;
+  }
+  else if( c >= 0x10000 ) {
+    c -= 0x10000;
+    *out++ = 0xD800 | ( c >> 10 );
+    *out++ = 0xDC00 | ( c & 0x3FF );
+  }
+  else {
+    *out++ = c;
+  }
+  return out;
+}
+
+bool ScateStreamDecoder::decode( const char *&data, const char *end )
+{
+  const uchar *p = (const uchar*) data;
+  const uchar *e = (const uchar*) end;
+
+  // every input byte yields at most one UTF-16 unit
+  int required = length + ( e - p ) + slack;
+  if( buf.size() < required )
+    buf.resize( qMax( required, buf.size() * 2 ) );
+
+  ushort *start = buf.data();
+  ushort *out = start + length;
+
+#ifdef __SSE2__
+  const __m128i newline = _mm_set1_epi8( '\n' );
+  const __m128i zero = _mm_setzero_si128();
+#endif
+
+  for(;;) {
+    // continue a multi-byte sequence
+    while( need && p < e ) {
+      uchar b = *p;
+      if( ( b & 0xC0 ) != 0x80 ) {
+        // truncated sequence; the byte is decoded on its own
+        *out++ = replacementChar;
+        need = 0;
+        break;
+      }
+      partial = ( partial << 6 ) | ( b & 0x3F );
+      ++p;
+      if( --need == 0 ) out = finishSequence( out );
+    }
+
+#ifdef __SSE2__
+    // ASCII fast path: widen 16 bytes at a time up to the first
+    // line break or non-ASCII byte
+    while( e - p >= 16 ) {
+      __m128i v = _mm_loadu_si128( (const __m128i*) p );
+      int special = _mm_movemask_epi8( _mm_or_si128( _mm_cmpeq_epi8( v, newline ), v ) );
+      _mm_storeu_si128( (__m128i*) out, _mm_unpacklo_epi8( v, zero ) );
+      _mm_storeu_si128( (__m128i*) ( out + 8 ), _mm_unpackhi_epi8( v, zero ) );
+      if( !special ) {
+        p += 16;
+        out += 16;
+        continue;
+      }
+      int n = __builtin_ctz( special );
+      p += n;
+      out += n;
+      break;
+    }
+#endif
+
+    if( p == e ) break;
+
+    uchar b = *p++;
+
+    if( b == '\n' ) {
+      length = out - start;
+      if( length && start[length-1] == '\r' ) --length;
+      if( taken > length ) taken = length;
+      data = (const char*) p;
+      return true;
+    }
+
+    if( b < 0x80 ) {
+      *out++ = b;
+    }
+    else if( b >= 0xC2 && b <= 0xDF ) {
+      partial = b & 0x1F; minValue = 0x80; need = 1;
+    }
+    else if( b >= 0xE0 && b <= 0xEF ) {
+      partial = b & 0x0F; minValue = 0x800; need = 2;
+    }
+    else if( b >= 0xF0 && b <= 0xF4 ) {
+      partial = b & 0x07; minValue = 0x10000; need = 3;
+    }
+    else {
+      *out++ = replacementChar;
+    }
+  }
+
+  length = out - start;
+  data = end;
+  return false;
+}
@@ -0,0 +1,70 @@
+/*
+#
+# Copyright 2010-2011 Jakob Leben (jakob.leben@gmail.com)
+#
+# This file is part of Scate - a SuperCollider plugin for Kate
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+*/
+
+#ifndef SCATE_STREAM_DECODER_H
+#define SCATE_STREAM_DECODER_H
+
+#include <QString>
+#include <QVector>
+
+// Incremental UTF-8 decoder that splits its input into lines.
+// The state of a multi-byte sequence cut by the end of a chunk is kept until
+// the next chunk arrives. The line being decoded lives in a buffer that is
+// reused from line to line, so decoding itself does not allocate; runs of
+// ASCII text are scanned and widened 16 bytes at a time where SSE2 is
+// available.
+
+class ScateStreamDecoder
+{
+  public:
+    ScateStreamDecoder();
+
+    // Decodes input from 'data' up to the next line break, or to 'end'.
+    // Returns true if a line was completed, in which case 'data' points just
+    // past the line break; otherwise all input has been consumed.
+    bool decode( const char *&data, const char *end );
+
+    // The current line, as far as decoded (without the line break).
+    // Valid until the next call to decode() or nextLine().
+    inline const QChar *line() const { return (const QChar*) buf.constData(); }
+    inline int lineLength() const { return length; }
+
+    // Returns the text of the current line that has not been taken yet.
+    QString takeFragment();
+    inline bool hasFragment() const { return length > taken; }
+
+    // Starts a new line, after the current one has been completed.
+    inline void nextLine() { length = taken = 0; }
+    void reset();
+
+  private:
+    ushort *finishSequence( ushort *out );
+
+    QVector<ushort> buf;
+    int length;
+    int taken;
+
+    uint partial;
+    uint minValue;
+    int need;
+};
+
+#endif // SCATE_STREAM_DECODER_H
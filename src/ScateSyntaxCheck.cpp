@@ -0,0 +1,127 @@
+/*
+#
+# Copyright 2010-2011 Jakob Leben (jakob.leben@gmail.com)
+#
+# This file is part of Scate - a SuperCollider plugin for Kate
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+*/
+
+#include "ScateSyntaxCheck.hpp"
+#include "ScateLexer.hpp"
+
+#include <QVarLengthArray>
+#include <QVector>
+
+namespace {
+
+struct Open {
+  int line;
+  int column;
+  char ch;
+};
+
+inline char opening( char closing )
+{
+  switch( closing ) {
+    case ')': return '(';
+    case ']': return '[';
+    default: return '{';
+  }
+}
+
+ScateSyntaxCheck::Error error( int line, int column, const QString &message )
+{
+  ScateSyntaxCheck::Error e;
+  e.line = line;
+  e.column = column;
+  e.message = message;
+  return e;
+}
+
+}
+
+void ScateSyntaxCheck::Error::moveBy( int l, int c )
+{
+  if( line == 0 ) column += c;
+  line += l;
+}
+
+QString ScateSyntaxCheck::Error::text() const
+{
+  return QString("Syntax error at line %1, column %2: %3")
+    .arg( line + 1 ).arg( column + 1 ).arg( message );
+}
+
+ScateSyntaxCheck::Error ScateSyntaxCheck::check( const QString &code )
+{
+  QVarLengthArray<Open, 64> open;
+  QVector<ScateLexer::Bracket> brackets;
+  // keeps its capacity when resized to 0
+  brackets.reserve( 64 );
+
+  const QChar *data = code.unicode();
+  const int n = code.size();
+  int state = ScateLexer::Code;
+  // where the current string, symbol or comment started
+  int stateLine = 0;
+  int stateColumn = 0;
+
+  int line = 0;
+  for( int start = 0; start <= n; ++line ) {
+    int end = start;
+    while( end < n && data[end] != QLatin1Char('\n') ) ++end;
+
+    int stateStart;
+    brackets.resize( 0 );
+    state = ScateLexer::lexLine( data + start, end - start, state, &brackets, 0, &stateStart );
+    if( stateStart != -1 ) {
+      stateLine = line;
+      stateColumn = stateStart;
+    }
+
+    for( int i = 0; i < brackets.count(); ++i ) {
+      const ScateLexer::Bracket &b = brackets[i];
+      if( b.isOpening() ) {
+        Open o = { line, b.column, b.ch };
+        open.append( o );
+        continue;
+      }
+      if( open.isEmpty() )
+        return error( line, b.column, QString("unexpected '%1'").arg( b.ch ) );
+      const Open &o = open[open.size() - 1];
+      if( o.ch != opening( b.ch ) ) {
+        return error( line, b.column, QString("'%1' does not match '%2' at line %3, column %4")
+                      .arg( b.ch ).arg( o.ch ).arg( o.line + 1 ).arg( o.column + 1 ) );
+      }
+      open.removeLast();
+    }
+
+    start = end + 1;
+  }
+
+  if( state == ScateLexer::String )
+    return error( stateLine, stateColumn, "unterminated string" );
+  if( state == ScateLexer::Symbol )
+    return error( stateLine, stateColumn, "unterminated symbol" );
+  if( ScateLexer::isComment( state ) )
+    return error( stateLine, stateColumn, "unterminated comment" );
+  if( !open.isEmpty() ) {
+    const Open &o = open[open.size() - 1];
+    return error( o.line, o.column, QString("'%1' is not closed").arg( o.ch ) );
+  }
+
+  return Error();
+}
@@ -0,0 +1,53 @@
+/*
+#
+# Copyright 2010-2011 Jakob Leben (jakob.leben@gmail.com)
+#
+# This file is part of Scate - a SuperCollider plugin for Kate
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+*/
+
+#ifndef SCATE_SYNTAX_CHECK_H
+#define SCATE_SYNTAX_CHECK_H
+
+#include <QString>
+
+// Checks code for the mistakes most often made when editing it - unbalanced
+// or mismatched brackets, and unterminated strings, symbols and comments -
+// before it is sent to the interpreter, which would otherwise answer with a
+// parse error dump. Anything else is left for the interpreter to find.
+
+class ScateSyntaxCheck
+{
+  public:
+    struct Error {
+      Error() : line( -1 ), column( -1 ) {}
+      // zero-based position within the code
+      int line;
+      int column;
+      QString message;
+
+      inline bool isValid() const { return line >= 0; }
+      // Makes the position relative to a document where the code starts at
+      // the given position.
+      void moveBy( int line, int column );
+      QString text() const;
+    };
+
+    // Returns an invalid Error if no mistake was found.
+    static Error check( const QString &code );
+};
+
+#endif // SCATE_SYNTAX_CHECK_H
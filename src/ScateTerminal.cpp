@@ -0,0 +1,612 @@
+/*
+#
+# Copyright 2010-2011 Jakob Leben (jakob.leben@gmail.com)
+#
+# This file is part of Scate - a SuperCollider plugin for Kate
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+*/
+
+#include "ScateTerminal.hpp"
+#include "ScateLineStore.hpp"
+
+#include <QPainter>
+#include <QScrollBar>
+#include <QMouseEvent>
+#include <QKeyEvent>
+#include <QContextMenuEvent>
+#include <QMenu>
+#include <QApplication>
+#include <QClipboard>
+#include <QtAlgorithms>
+
+static const int margin = 2;
+static const int tabWidth = 20;
+
+ScateTerminal::ScateTerminal( ScateLineSource *store_, QWidget *parent ) :
+  QAbstractScrollArea( parent ),
+  store( store_ ),
+  filter( 0 ),
+  allExpanded( false ),
+  syncedGroups( 0 ),
+  lastGroupHeader( -1 ),
+  syncedGeneration( -1 ),
+  topLine( store_->firstLine() ),
+  follow( true ),
+  updatingScrollBars( false ),
+  selecting( false )
+{
+  setFocusPolicy( Qt::StrongFocus );
+  viewport()->setCursor( Qt::IBeamCursor );
+  viewport()->setBackgroundRole( QPalette::Base );
+  viewport()->setAutoFillBackground( true );
+
+  connect( store, SIGNAL(changed()), this, SLOT(onStoreChanged()) );
+  connect( verticalScrollBar(), SIGNAL(valueChanged(int)), this, SLOT(onScrolled(int)) );
+
+  syncFolds( true );
+  updateScrollBars();
+}
+
+/*************************** FOLDING ******************************/
+
+void ScateTerminal::syncFolds( bool rebuild )
+{
+  qint64 begin = store->groupsBegin();
+  qint64 end = store->groupsEnd();
+
+  if( !rebuild ) {
+    rebuild = store->generation() != syncedGeneration
+      || syncedGroups > end
+      || syncedGroups < begin
+      || ( syncedGroups > begin && store->group( syncedGroups - 1 ).header != lastGroupHeader )
+      || folds.count() > 2 * ( end - begin ) + 64;
+  }
+
+  if( rebuild ) {
+    folds.clear();
+    syncedGroups = begin;
+    lastGroupHeader = -1;
+    syncedGeneration = store->generation();
+
+    qint64 first = store->firstLine();
+    QSet<qint64>::iterator it = toggled.begin();
+    while( it != toggled.end() ) {
+      if( *it < first ) it = toggled.erase( it );
+      else ++it;
+    }
+  }
+  else if( syncedGroups > begin && !folds.isEmpty()
+           && folds.last().first == lastGroupHeader + 1 ) {
+    // the last group may have grown or shrunk since
+    folds.last().end = store->group( syncedGroups - 1 ).end;
+  }
+
+  for( ; syncedGroups < end; ++syncedGroups ) {
+    ScateLineSource::Group g = store->group( syncedGroups );
+    lastGroupHeader = g.header;
+    if( allExpanded != toggled.contains( g.header ) ) continue;
+
+    Fold f;
+    f.first = g.header + 1;
+    f.end = g.end;
+    f.hiddenBefore = folds.isEmpty() ? 0
+      : folds.last().hiddenBefore + folds.last().end - folds.last().first;
+    folds.append( f );
+  }
+}
+
+int ScateTerminal::foldAt( qint64 header ) const
+{
+  int lo = 0, hi = folds.count() - 1;
+  while( lo <= hi ) {
+    int mid = ( lo + hi ) / 2;
+    qint64 first = folds[mid].first;
+    if( first == header + 1 ) return mid;
+    if( first < header + 1 ) lo = mid + 1;
+    else hi = mid - 1;
+  }
+  return -1;
+}
+
+int ScateTerminal::foldContaining( qint64 line ) const
+{
+  int lo = 0, hi = folds.count() - 1, found = -1;
+  while( lo <= hi ) {
+    int mid = ( lo + hi ) / 2;
+    if( folds[mid].first <= line ) { found = mid; lo = mid + 1; }
+    else hi = mid - 1;
+  }
+  if( found != -1 && line < folds[found].end ) return found;
+  return -1;
+}
+
+qint64 ScateTerminal::hiddenBefore( qint64 line ) const
+{
+  // last fold starting before the line
+  int lo = 0, hi = folds.count() - 1, found = -1;
+  while( lo <= hi ) {
+    int mid = ( lo + hi ) / 2;
+    if( folds[mid].first < line ) { found = mid; lo = mid + 1; }
+    else hi = mid - 1;
+  }
+  if( found == -1 ) return 0;
+  const Fold &f = folds[found];
+  return f.hiddenBefore + qMin( f.end, line ) - f.first;
+}
+
+int ScateTerminal::filterOffset() const
+{
+  return qLowerBound( filter->constBegin(), filter->constEnd(), store->firstLine() )
+    - filter->constBegin();
+}
+
+qint64 ScateTerminal::rowOf( qint64 line ) const
+{
+  if( filter ) {
+    return ( qLowerBound( filter->constBegin(), filter->constEnd(), line )
+             - filter->constBegin() ) - filterOffset();
+  }
+
+  qint64 first = store->firstLine();
+  if( line <= first ) return 0;
+  return ( line - hiddenBefore( line ) ) - ( first - hiddenBefore( first ) );
+}
+
+qint64 ScateTerminal::rowCount() const
+{
+  return rowOf( store->endLine() );
+}
+
+qint64 ScateTerminal::lineAt( qint64 row ) const
+{
+  if( filter ) {
+    qint64 i = filterOffset() + qMax( qint64(0), row );
+    return i < filter->count() ? filter->at( i ) : store->endLine();
+  }
+
+  qint64 first = store->firstLine();
+  qint64 target = first - hiddenBefore( first ) + qMax( qint64(0), row );
+
+  // last fold with at most 'target' visible lines before it
+  int lo = 0, hi = folds.count() - 1, found = -1;
+  while( lo <= hi ) {
+    int mid = ( lo + hi ) / 2;
+    if( folds[mid].first - folds[mid].hiddenBefore <= target ) { found = mid; lo = mid + 1; }
+    else hi = mid - 1;
+  }
+  if( found == -1 ) return target;
+  const Fold &f = folds[found];
+  return target + f.hiddenBefore + f.end - f.first;
+}
+
+void ScateTerminal::setFilter( const QVector<qint64> *lines )
+{
+  filter = lines;
+  follow = true;
+  updateFilter();
+}
+
+void ScateTerminal::updateFilter()
+{
+  updateScrollBars();
+  viewport()->update();
+}
+
+bool ScateTerminal::isShown( qint64 line ) const
+{
+  if( filter )
+    return qBinaryFind( filter->constBegin(), filter->constEnd(), line ) != filter->constEnd();
+  return foldContaining( line ) == -1;
+}
+
+qint64 ScateTerminal::currentLine() const
+{
+  return hasSelection() ? cursor.line : topLine;
+}
+
+void ScateTerminal::showLine( qint64 line, int from, int to )
+{
+  if( !filter ) {
+    int fold = foldContaining( line );
+    if( fold != -1 ) {
+      qint64 header = folds[fold].first - 1;
+      if( toggled.contains( header ) ) toggled.remove( header );
+      else toggled.insert( header );
+      syncFolds( true );
+    }
+  }
+
+  qint64 row = rowOf( line );
+  qint64 top = rowOf( topLine );
+  int rows = visibleLines();
+  if( row < top || row >= top + rows ) {
+    follow = false;
+    topLine = lineAt( qMax( qint64(0), row - rows / 2 ) );
+  }
+
+  anchor = Position( line, from );
+  cursor = Position( line, to );
+
+  updateScrollBars();
+  viewport()->update();
+}
+
+void ScateTerminal::expandAll()
+{
+  allExpanded = true;
+  toggled.clear();
+  syncFolds( true );
+  updateScrollBars();
+  viewport()->update();
+}
+
+void ScateTerminal::collapseAll()
+{
+  allExpanded = false;
+  toggled.clear();
+  syncFolds( true );
+  updateScrollBars();
+  viewport()->update();
+}
+
+/*************************** LAYOUT ******************************/
+
+int ScateTerminal::lineHeight() const
+{
+  return fontMetrics().lineSpacing();
+}
+
+int ScateTerminal::noteWidth() const
+{
+  return store->hasNotes() ? fontMetrics().width( "999.99 ms" ) + margin : 0;
+}
+
+int ScateTerminal::textLeft() const
+{
+  // room for fold markers and notes
+  return lineHeight() + margin + noteWidth();
+}
+
+int ScateTerminal::visibleLines() const
+{
+  return qMax( 1, viewport()->height() / lineHeight() );
+}
+
+int ScateTerminal::textWidth( const QString &text ) const
+{
+  return fontMetrics().size( Qt::TextSingleLine | Qt::TextExpandTabs, text, tabWidth ).width();
+}
+
+int ScateTerminal::columnAt( const QString &text, int x ) const
+{
+  // the boundary between two characters is nearer to x when x lies before
+  // the middle of the character after it; the middles only grow along the
+  // line, so the first such boundary is found by bisection
+  int low = 0;
+  int high = text.size();
+  while( low < high ) {
+    int column = ( low + high ) / 2;
+    int left = textWidth( text.left( column ) );
+    int right = textWidth( text.left( column + 1 ) );
+    if( x < ( left + right ) / 2 )
+      high = column;
+    else
+      low = column + 1;
+  }
+  return low;
+}
+
+void ScateTerminal::updateScrollBars()
+{
+  updatingScrollBars = true;
+
+  int rows = visibleLines();
+  qint64 maxTop = qMax( qint64(0), rowCount() - rows );
+  qint64 top = follow ? maxTop : qMin( rowOf( topLine ), maxTop );
+  topLine = lineAt( top );
+
+  QScrollBar *vsb = verticalScrollBar();
+  vsb->setRange( 0, maxTop );
+  vsb->setPageStep( rows );
+  vsb->setSingleStep( 1 );
+  vsb->setValue( top );
+
+  QScrollBar *hsb = horizontalScrollBar();
+  int contentWidth = store->maxLineLength() * fontMetrics().averageCharWidth()
+    + textLeft() + margin;
+  hsb->setRange( 0, qMax( 0, contentWidth - viewport()->width() ) );
+  hsb->setPageStep( viewport()->width() );
+  hsb->setSingleStep( fontMetrics().averageCharWidth() );
+
+  updatingScrollBars = false;
+}
+
+void ScateTerminal::onStoreChanged()
+{
+  syncFolds();
+  updateScrollBars();
+  viewport()->update();
+}
+
+void ScateTerminal::onScrolled( int value )
+{
+  if( updatingScrollBars ) return;
+  topLine = lineAt( value );
+  follow = value == verticalScrollBar()->maximum();
+  viewport()->update();
+}
+
+void ScateTerminal::scrollToEnd()
+{
+  follow = true;
+  updateScrollBars();
+  viewport()->update();
+}
+
+/*************************** PAINTING ******************************/
+
+static QColor background( ScatePostLine::Kind kind )
+{
+  switch( kind ) {
+    case ScatePostLine::Error:
+      return Qt::red;
+    case ScatePostLine::Backtrace:
+      return QColor( 255, 205, 205 );
+    case ScatePostLine::Warning:
+      return QColor( 255, 220, 120 );
+    default:
+      return QColor();
+  }
+}
+
+static QColor foreground( ScatePostLine::Kind kind, const QPalette &pal )
+{
+  switch( kind ) {
+    case ScatePostLine::Late:
+      return QColor( 200, 100, 0 );
+    case ScatePostLine::Result:
+      return QColor( 0, 100, 180 );
+    case ScatePostLine::Stderr:
+      return QColor( 170, 0, 110 );
+    default:
+      return pal.color( QPalette::Text );
+  }
+}
+
+void ScateTerminal::paintEvent( QPaintEvent * )
+{
+  QPainter painter( viewport() );
+
+  const QPalette &pal = palette();
+  int lh = lineHeight();
+  int x = textLeft() - horizontalScrollBar()->value();
+  int w = viewport()->width();
+  int nw = noteWidth();
+
+  Position selStart = qMin( anchor, cursor );
+  Position selEnd = qMax( anchor, cursor );
+  bool sel = hasSelection();
+
+  qint64 end = store->endLine();
+  qint64 topRow = rowOf( topLine );
+  qint64 n = topLine;
+  int rows = visibleLines() + 1;
+
+  for( int row = 0; row < rows && n < end; ++row ) {
+    if( filter ) n = lineAt( topRow + row );
+    if( n >= end ) break;
+
+    int y = row * lh;
+    QString text = store->line( n );
+    ScatePostLine::Kind kind = store->kind( n );
+    int fold = filter ? -1 : foldAt( n );
+
+    QColor bg = background( kind );
+    if( bg.isValid() ) painter.fillRect( 0, y, w, lh, bg );
+
+    if( sel && n >= selStart.line && n <= selEnd.line ) {
+      int from = n == selStart.line ? textWidth( text.left( selStart.column ) ) : 0;
+      int to = n == selEnd.line ? textWidth( text.left( selEnd.column ) ) : w;
+      painter.fillRect( x + from, y, to - from, lh, pal.brush( QPalette::Highlight ) );
+    }
+
+    // of lines much wider than the viewport, only the visible part is laid
+    // out and drawn; tab stops are relative to where drawing starts, so it
+    // starts at the beginning of lines with tabs in the visible part
+    QString visible = text;
+    int textX = x;
+    if( text.size() * fontMetrics().averageCharWidth() > 2 * w ) {
+      int first = qMax( 0, columnAt( text, -x ) - 1 );
+      int last = qMin( text.size(), columnAt( text, w - x ) + 1 );
+      if( text.indexOf( QChar('\t'), first ) != -1 ) first = 0;
+      visible = text.mid( first, last - first );
+      if( first ) textX = x + textWidth( text.left( first ) );
+    }
+
+    painter.setPen( foreground( kind, pal ) );
+    painter.drawText( QRect( textX, y, w - textX, lh ),
+                      Qt::TextSingleLine | Qt::TextExpandTabs | Qt::AlignLeft | Qt::AlignTop,
+                      visible );
+
+    bool header = fold != -1
+      || ( !filter && !store->isFolded( n ) && store->isFolded( n + 1 ) );
+    if( header ) {
+      // fold marker
+      QRect box( margin, y + lh / 4, lh / 2, lh / 2 );
+      painter.setPen( pal.color( QPalette::Text ) );
+      painter.fillRect( box, pal.brush( QPalette::Base ) );
+      painter.drawRect( box );
+      int cy = box.center().y();
+      painter.drawLine( box.left() + 2, cy, box.right() - 2, cy );
+      if( fold != -1 ) {
+        int cx = box.center().x();
+        painter.drawLine( cx, box.top() + 2, cx, box.bottom() - 2 );
+
+        qint64 hidden = folds[fold].end - folds[fold].first;
+        QString more = tr("  [%1 more lines]").arg( hidden );
+        painter.setPen( pal.color( QPalette::Disabled, QPalette::Text ) );
+        painter.drawText( QRect( x + textWidth( text ), y, w, lh ),
+                          Qt::TextSingleLine | Qt::AlignLeft | Qt::AlignTop, more );
+      }
+    }
+
+    if( nw ) {
+      QString note = store->note( n );
+      if( !note.isEmpty() ) {
+        QRect box( lineHeight(), y, nw - margin, lh );
+        painter.fillRect( box, pal.brush( QPalette::Base ) );
+        painter.setPen( pal.color( QPalette::Disabled, QPalette::Text ) );
+        painter.drawText( box, Qt::TextSingleLine | Qt::AlignRight | Qt::AlignTop, note );
+      }
+    }
+
+    n = fold != -1 ? folds[fold].end : n + 1;
+  }
+}
+
+void ScateTerminal::resizeEvent( QResizeEvent *e )
+{
+  QAbstractScrollArea::resizeEvent( e );
+  updateScrollBars();
+}
+
+void ScateTerminal::changeEvent( QEvent *e )
+{
+  if( e->type() == QEvent::FontChange ) {
+    viewport()->setFont( font() );
+    updateScrollBars();
+  }
+  QAbstractScrollArea::changeEvent( e );
+}
+
+/*************************** INTERACTION ******************************/
+
+ScateTerminal::Position ScateTerminal::positionAt( const QPoint &pos ) const
+{
+  qint64 line = lineAt( rowOf( topLine ) + qMax( 0, pos.y() ) / lineHeight() );
+  line = qBound( store->firstLine(), line, qMax( store->firstLine(), store->endLine() - 1 ) );
+
+  QString text = store->line( line );
+  int x = pos.x() - textLeft() + horizontalScrollBar()->value();
+  return Position( line, columnAt( text, x ) );
+}
+
+void ScateTerminal::mousePressEvent( QMouseEvent *e )
+{
+  if( e->button() != Qt::LeftButton ) return;
+
+  Position pos = positionAt( e->pos() );
+
+  if( !filter && e->pos().x() < textLeft() ) {
+    qint64 n = pos.line;
+    if( foldAt( n ) != -1 || ( !store->isFolded( n ) && store->isFolded( n + 1 ) ) ) {
+      if( toggled.contains( n ) ) toggled.remove( n );
+      else toggled.insert( n );
+      syncFolds( true );
+      updateScrollBars();
+      viewport()->update();
+      return;
+    }
+  }
+
+  anchor = cursor = pos;
+  selecting = true;
+  viewport()->update();
+}
+
+void ScateTerminal::mouseMoveEvent( QMouseEvent *e )
+{
+  if( !selecting ) return;
+  cursor = positionAt( e->pos() );
+  if( e->pos().y() < 0 )
+    verticalScrollBar()->triggerAction( QAbstractSlider::SliderSingleStepSub );
+  else if( e->pos().y() > viewport()->height() )
+    verticalScrollBar()->triggerAction( QAbstractSlider::SliderSingleStepAdd );
+  viewport()->update();
+}
+
+void ScateTerminal::mouseReleaseEvent( QMouseEvent *e )
+{
+  if( e->button() != Qt::LeftButton ) return;
+  selecting = false;
+  if( hasSelection() ) {
+    QApplication::clipboard()->setText( selectedText(), QClipboard::Selection );
+  }
+}
+
+void ScateTerminal::keyPressEvent( QKeyEvent *e )
+{
+  if( e->matches( QKeySequence::Copy ) ) {
+    copy();
+  }
+  else if( e->matches( QKeySequence::SelectAll ) ) {
+    selectAll();
+  }
+  else if( e->matches( QKeySequence::MoveToEndOfDocument ) ) {
+    scrollToEnd();
+  }
+  else if( e->matches( QKeySequence::MoveToStartOfDocument ) ) {
+    verticalScrollBar()->triggerAction( QAbstractSlider::SliderToMinimum );
+  }
+  else {
+    QAbstractScrollArea::keyPressEvent( e );
+  }
+}
+
+void ScateTerminal::contextMenuEvent( QContextMenuEvent *e )
+{
+  QMenu menu;
+  QAction *a = menu.addAction( tr("Copy"), this, SLOT(copy()) );
+  a->setEnabled( hasSelection() );
+  menu.addAction( tr("Select All"), this, SLOT(selectAll()) );
+  menu.addSeparator();
+  menu.addAction( tr("Expand All Errors"), this, SLOT(expandAll()) );
+  menu.addAction( tr("Collapse All Errors"), this, SLOT(collapseAll()) );
+  menu.exec( e->globalPos() );
+}
+
+QString ScateTerminal::selectedText() const
+{
+  if( !hasSelection() ) return QString();
+
+  Position start = qMax( qMin( anchor, cursor ), Position( store->firstLine(), 0 ) );
+  Position end = qMax( anchor, cursor );
+
+  QString text;
+  for( qint64 n = start.line; n <= end.line && n < store->endLine(); ++n ) {
+    QString line = store->line( n );
+    int from = n == start.line ? start.column : 0;
+    int to = n == end.line ? end.column : line.size();
+    text += line.mid( from, to - from );
+    if( n != end.line ) text += QChar('\n');
+  }
+  return text;
+}
+
+void ScateTerminal::copy()
+{
+  if( hasSelection() )
+    QApplication::clipboard()->setText( selectedText() );
+}
+
+void ScateTerminal::selectAll()
+{
+  if( store->isEmpty() ) return;
+  qint64 last = store->endLine() - 1;
+  anchor = Position( store->firstLine(), 0 );
+  cursor = Position( last, store->line( last ).size() );
+  viewport()->update();
+}
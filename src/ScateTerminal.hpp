@@ -0,0 +1,129 @@
+/*
+#
+# Copyright 2010-2011 Jakob Leben (jakob.leben@gmail.com)
+#
+# This file is part of Scate - a SuperCollider plugin for Kate
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+*/
+
+#ifndef SCATE_TERMINAL_H
+#define SCATE_TERMINAL_H
+
+#include <QAbstractScrollArea>
+#include <QVector>
+#include <QSet>
+
+class ScateLineSource;
+class QMenu;
+
+// Displays a ScateLineSource. Only the lines in the viewport are ever
+// decoded and laid out, so scrolling costs the same no matter how many
+// lines the store holds.
+// Error dumps are collapsed to their error line, and can be expanded by
+// clicking the marker in the left margin. Notes of lines, like the latency
+// of evaluations, are shown in the margin too.
+
+class ScateTerminal : public QAbstractScrollArea
+{
+  Q_OBJECT
+  public:
+    ScateTerminal( ScateLineSource *, QWidget *parent = 0 );
+    QString selectedText() const;
+    inline bool hasSelection() const { return anchor != cursor; }
+
+    // Shows only the given lines (ascending numbers), or all lines if 0.
+    // Call updateFilter() whenever the lines change.
+    void setFilter( const QVector<qint64> *lines );
+    void updateFilter();
+    bool isShown( qint64 line ) const;
+    // Scrolls to a line, expanding its error dump if needed, and selects
+    // the given columns.
+    void showLine( qint64 line, int from, int to );
+    // The line of the selection cursor, or the top line.
+    qint64 currentLine() const;
+  public slots:
+    void copy();
+    void selectAll();
+    void scrollToEnd();
+    void expandAll();
+    void collapseAll();
+  protected:
+    void paintEvent( QPaintEvent * );
+    void resizeEvent( QResizeEvent * );
+    void changeEvent( QEvent * );
+    void mousePressEvent( QMouseEvent * );
+    void mouseMoveEvent( QMouseEvent * );
+    void mouseReleaseEvent( QMouseEvent * );
+    void keyPressEvent( QKeyEvent * );
+    void contextMenuEvent( QContextMenuEvent * );
+  private slots:
+    void onStoreChanged();
+    void onScrolled( int );
+  private:
+    struct Position {
+      Position( qint64 l = 0, int c = 0 ) : line(l), column(c) {}
+      bool operator < ( const Position &o ) const
+        { return line < o.line || ( line == o.line && column < o.column ); }
+      bool operator != ( const Position &o ) const
+        { return line != o.line || column != o.column; }
+      qint64 line;
+      int column;
+    };
+
+    struct Fold {
+      qint64 first;
+      qint64 end;
+      // number of lines hidden by all previous folds
+      qint64 hiddenBefore;
+    };
+
+    void syncFolds( bool rebuild = false );
+    int foldAt( qint64 line ) const;
+    int foldContaining( qint64 line ) const;
+    int filterOffset() const;
+    qint64 hiddenBefore( qint64 line ) const;
+    qint64 rowOf( qint64 line ) const;
+    qint64 lineAt( qint64 row ) const;
+    qint64 rowCount() const;
+
+    int lineHeight() const;
+    int noteWidth() const;
+    int textLeft() const;
+    int visibleLines() const;
+    int textWidth( const QString & ) const;
+    // The column of text nearest to the given distance from its start.
+    int columnAt( const QString &text, int x ) const;
+    Position positionAt( const QPoint & ) const;
+    void updateScrollBars();
+
+    ScateLineSource *store;
+    const QVector<qint64> *filter;
+    QVector<Fold> folds;
+    // headers of groups not in the default state
+    QSet<qint64> toggled;
+    bool allExpanded;
+    qint64 syncedGroups;
+    qint64 lastGroupHeader;
+    int syncedGeneration;
+    qint64 topLine;
+    bool follow;
+    bool updatingScrollBars;
+    Position anchor;
+    Position cursor;
+    bool selecting;
+};
+
+#endif // SCATE_TERMINAL_H
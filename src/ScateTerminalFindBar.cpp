@@ -0,0 +1,290 @@
+/*
+#
+# Copyright 2010-2011 Jakob Leben (jakob.leben@gmail.com)
+#
+# This file is part of Scate - a SuperCollider plugin for Kate
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+*/
+
+#include "ScateTerminalFindBar.hpp"
+#include "ScateTerminal.hpp"
+
+#include <kicon.h>
+
+#include <QLineEdit>
+#include <QComboBox>
+#include <QLabel>
+#include <QAction>
+#include <QRegExp>
+#include <QStringMatcher>
+#include <QByteArrayMatcher>
+#include <QtConcurrentRun>
+#include <QtAlgorithms>
+
+static QVector<qint64> findLines( ScateLineStore::Snapshot snapshot, ScateTerminalQuery query,
+                                  qint64 from, qint64 to, QSharedPointer<QAtomicInt> cancel )
+{
+  QVector<qint64> found;
+
+  if( !query.regExp && query.caseSensitive ) {
+    // Plain text can be looked for in the packed UTF-8 data directly,
+    // without decoding each line.
+    QByteArray pattern = query.pattern.toUtf8();
+    QByteArrayMatcher matcher( pattern );
+
+    foreach( const ScateLineStore::Chunk &c, snapshot.chunkList() ) {
+      if( *cancel ) break;
+
+      qint64 chunkEnd = c.first + c.ends.count();
+      if( chunkEnd <= from || c.first >= to ) continue;
+
+      int line = qMax( from, c.first ) - c.first;
+      int lastLine = qMin( to, chunkEnd ) - c.first;
+      int pos = line ? c.ends[line-1] : 0;
+      int limit = c.ends[lastLine-1];
+
+      while( line < lastLine ) {
+        pos = matcher.indexIn( c.data, pos );
+        if( pos == -1 || pos >= limit ) break;
+        // the line in which the match starts
+        line = qUpperBound( c.ends.constBegin() + line, c.ends.constBegin() + lastLine,
+                            (quint32) pos ) - c.ends.constBegin();
+        // lines are packed without separators, so a match may run
+        // into the next line
+        if( pos + pattern.size() <= (int) c.ends[line] )
+          found.append( c.first + line );
+        pos = c.ends[line];
+        ++line;
+      }
+    }
+    return found;
+  }
+
+  Qt::CaseSensitivity cs = query.caseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive;
+  QRegExp regExp( query.pattern, cs );
+  QStringMatcher matcher( query.pattern, cs );
+
+  for( qint64 n = qMax( from, snapshot.firstLine() ); n < to; ++n ) {
+    if( ( n & 1023 ) == 0 && *cancel ) break;
+    QString text = snapshot.line( n );
+    int pos = query.regExp ? regExp.indexIn( text ) : matcher.indexIn( text );
+    if( pos != -1 ) found.append( n );
+  }
+  return found;
+}
+
+ScateTerminalFindBar::ScateTerminalFindBar( ScateLineStore *store_, ScateTerminal *terminal_ ) :
+  store( store_ ),
+  terminal( terminal_ ),
+  searchedEnd( 0 ),
+  searchedGeneration( -1 ),
+  stale( false )
+{
+  query.regExp = false;
+  query.caseSensitive = false;
+
+  filterCombo = new QComboBox();
+  filterCombo->addItem( tr("All Output") );
+  filterCombo->addItem( tr("Errors") );
+  filterCombo->addItem( tr("Warnings") );
+  filterCombo->addItem( tr("Matches") );
+
+  searchField = new QLineEdit();
+
+  QAction *prevAction = new QAction( KIcon("go-up"), tr("Previous"), this );
+  QAction *nextAction = new QAction( KIcon("go-down"), tr("Next"), this );
+
+  regExpAction = new QAction( tr("Regular Expression"), this );
+  regExpAction->setCheckable( true );
+  regExpAction->setIconText( tr(".*") );
+  caseAction = new QAction( tr("Match Case"), this );
+  caseAction->setCheckable( true );
+  caseAction->setIconText( tr("Aa") );
+
+  statusLabel = new QLabel();
+
+  addWidget( filterCombo );
+  addWidget( searchField );
+  addAction( prevAction );
+  addAction( nextAction );
+  addAction( regExpAction );
+  addAction( caseAction );
+  addWidget( statusLabel );
+
+  setIconSize( QSize(16,16) );
+  setSizePolicy( QSizePolicy::Expanding, QSizePolicy::Maximum );
+
+  connect( searchField, SIGNAL(textChanged(const QString&)), this, SLOT(restartSearch()) );
+  connect( searchField, SIGNAL(returnPressed()), this, SLOT(next()) );
+  connect( regExpAction, SIGNAL(toggled(bool)), this, SLOT(restartSearch()) );
+  connect( caseAction, SIGNAL(toggled(bool)), this, SLOT(restartSearch()) );
+  connect( prevAction, SIGNAL(triggered()), this, SLOT(previous()) );
+  connect( nextAction, SIGNAL(triggered()), this, SLOT(next()) );
+  connect( filterCombo, SIGNAL(currentIndexChanged(int)), this, SLOT(setFilter(int)) );
+  connect( store, SIGNAL(changed()), this, SLOT(onStoreChanged()) );
+  connect( &watcher, SIGNAL(finished()), this, SLOT(onSearchFinished()) );
+}
+
+void ScateTerminalFindBar::activate()
+{
+  QString text = terminal->selectedText();
+  if( !text.isEmpty() && !text.contains( QChar('\n') ) )
+    searchField->setText( text );
+  searchField->selectAll();
+  searchField->setFocus();
+}
+
+void ScateTerminalFindBar::restartSearch()
+{
+  query.pattern = searchField->text();
+  query.regExp = regExpAction->isChecked();
+  query.caseSensitive = caseAction->isChecked();
+
+  matches.clear();
+  searchedEnd = store->firstLine();
+  searchedGeneration = store->generation();
+
+  if( watcher.isRunning() ) {
+    // results of the running search are dropped when it finishes
+    *cancel = 1;
+    stale = true;
+  }
+  else {
+    searchMore();
+  }
+
+  if( filterCombo->currentIndex() == ShowMatches ) terminal->updateFilter();
+  updateStatus();
+}
+
+void ScateTerminalFindBar::searchMore()
+{
+  if( query.pattern.isEmpty() || watcher.isRunning() ) return;
+
+  // the last line is searched once it is complete
+  qint64 end = store->endLine() - ( store->hasOpenLine() ? 1 : 0 );
+  if( end <= searchedEnd ) return;
+
+  cancel = QSharedPointer<QAtomicInt>( new QAtomicInt( 0 ) );
+  watcher.setFuture( QtConcurrent::run( findLines, store->snapshot(), query,
+                                        searchedEnd, end, cancel ) );
+  searchedEnd = end;
+}
+
+void ScateTerminalFindBar::onSearchFinished()
+{
+  if( stale ) {
+    stale = false;
+    searchMore();
+    return;
+  }
+
+  matches += watcher.result();
+
+  if( filterCombo->currentIndex() == ShowMatches ) terminal->updateFilter();
+  updateStatus();
+
+  searchMore();
+}
+
+void ScateTerminalFindBar::onStoreChanged()
+{
+  if( store->generation() != searchedGeneration ) {
+    restartSearch();
+    return;
+  }
+  searchMore();
+}
+
+void ScateTerminalFindBar::setFilter( int filter )
+{
+  switch( filter ) {
+    case ShowErrors:
+      terminal->setFilter( &store->linesOfKind( ScatePostLine::Error ) ); break;
+    case ShowWarnings:
+      terminal->setFilter( &store->linesOfKind( ScatePostLine::Warning ) ); break;
+    case ShowMatches:
+      terminal->setFilter( &matches ); break;
+    default:
+      terminal->setFilter( 0 );
+  }
+}
+
+void ScateTerminalFindBar::updateStatus()
+{
+  if( query.pattern.isEmpty() ) {
+    statusLabel->clear();
+    return;
+  }
+  int first = qLowerBound( matches.constBegin(), matches.constEnd(), store->firstLine() )
+    - matches.constBegin();
+  QString status = tr("%1 matches").arg( matches.count() - first );
+  if( watcher.isRunning() ) status += tr("...");
+  statusLabel->setText( status );
+}
+
+void ScateTerminalFindBar::next()
+{
+  navigate( false );
+}
+
+void ScateTerminalFindBar::previous()
+{
+  navigate( true );
+}
+
+void ScateTerminalFindBar::navigate( bool backward )
+{
+  int first = qLowerBound( matches.constBegin(), matches.constEnd(), store->firstLine() )
+    - matches.constBegin();
+  int count = matches.count() - first;
+  if( !count ) return;
+
+  qint64 current = terminal->currentLine();
+  int i;
+  if( backward ) {
+    i = ( qLowerBound( matches.constBegin() + first, matches.constEnd(), current )
+          - matches.constBegin() ) - 1;
+    if( i < first ) i = matches.count() - 1;
+  }
+  else {
+    i = qUpperBound( matches.constBegin() + first, matches.constEnd(), current )
+        - matches.constBegin();
+    if( i >= matches.count() ) i = first;
+  }
+
+  qint64 line = matches[i];
+
+  // leave a filter that does not show the match
+  if( !terminal->isShown( line ) && filterCombo->currentIndex() != ShowAll )
+    filterCombo->setCurrentIndex( ShowAll );
+
+  QString text = store->line( line );
+  Qt::CaseSensitivity cs = query.caseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive;
+  int from, length;
+  if( query.regExp ) {
+    QRegExp regExp( query.pattern, cs );
+    from = regExp.indexIn( text );
+    length = regExp.matchedLength();
+  }
+  else {
+    from = text.indexOf( query.pattern, 0, cs );
+    length = query.pattern.size();
+  }
+  if( from == -1 ) { from = 0; length = 0; }
+
+  terminal->showLine( line, from, from + length );
+}
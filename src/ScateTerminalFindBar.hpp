@@ -0,0 +1,95 @@
+/*
+#
+# Copyright 2010-2011 Jakob Leben (jakob.leben@gmail.com)
+#
+# This file is part of Scate - a SuperCollider plugin for Kate
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+*/
+
+#ifndef SCATE_TERMINAL_FIND_BAR_H
+#define SCATE_TERMINAL_FIND_BAR_H
+
+#include "ScateLineStore.hpp"
+
+#include <QToolBar>
+#include <QFutureWatcher>
+#include <QSharedPointer>
+#include <QAtomicInt>
+#include <QVector>
+
+class ScateTerminal;
+class QLineEdit;
+class QComboBox;
+class QLabel;
+class QAction;
+
+struct ScateTerminalQuery
+{
+  QString pattern;
+  bool regExp;
+  bool caseSensitive;
+};
+
+// Searching and filtering of the SC Terminal.
+// Queries run on a snapshot of the scrollback in a worker thread. While a
+// query is active, lines arriving later are searched in the background as
+// well, so the list of matching lines stays up to date.
+
+class ScateTerminalFindBar : public QToolBar
+{
+  Q_OBJECT
+  public:
+    ScateTerminalFindBar( ScateLineStore *, ScateTerminal * );
+  public slots:
+    void activate();
+    void next();
+    void previous();
+  private slots:
+    void restartSearch();
+    void onStoreChanged();
+    void onSearchFinished();
+    void setFilter( int );
+  private:
+    enum Filter {
+      ShowAll,
+      ShowErrors,
+      ShowWarnings,
+      ShowMatches
+    };
+
+    void searchMore();
+    void navigate( bool backward );
+    void updateStatus();
+
+    ScateLineStore *store;
+    ScateTerminal *terminal;
+
+    QLineEdit *searchField;
+    QComboBox *filterCombo;
+    QAction *regExpAction;
+    QAction *caseAction;
+    QLabel *statusLabel;
+
+    ScateTerminalQuery query;
+    QVector<qint64> matches;
+    qint64 searchedEnd;
+    int searchedGeneration;
+    bool stale;
+    QSharedPointer<QAtomicInt> cancel;
+    QFutureWatcher< QVector<qint64> > watcher;
+};
+
+#endif // SCATE_TERMINAL_FIND_BAR_H
@@ -21,36 +21,67 @@
 
 #include "ScateView.hpp"
 #include "ScatePlugin.hpp"
+#include "ScateSession.hpp"
+#include "ScateSettings.hpp"
 #include "ScateHelpBrowser.hpp"
+#include "ScateTerminal.hpp"
+#include "ScateLineStore.hpp"
+#include "ScateTerminalFindBar.hpp"
+#include "ScatePostLog.hpp"
+#include "ScateEvalQueue.hpp"
+#include "ScateRegionIndex.hpp"
+#include "ScateLiveDocument.hpp"
+#include "ScateEvalTracker.hpp"
+#include "ScateHelpIndex.hpp"
 
 #include <kaction.h>
+#include <kselectaction.h>
 #include <kactioncollection.h>
 #include <ktexteditor/view.h>
 #include <ktexteditor/document.h>
+#include <ktexteditor/movinginterface.h>
+#include <ktexteditor/movingrange.h>
+#include <ktexteditor/attribute.h>
+#include <kcolorscheme.h>
 #include <klocalizedstring.h>
-#include <kconfiggroup.h>
+#include <kfiledialog.h>
+#include <kmessagebox.h>
 
 #include <QVBoxLayout>
 #include <QLabel>
 #include <QKeyEvent>
 #include <QToolBar>
-#include <QTextBlock>
+#include <QStackedWidget>
+#include <QShortcut>
+#include <QFileInfo>
+#include <QTimer>
+#include <QEvent>
 
 using namespace Scate;
 
 ScateView::ScateView( ScatePlugin *plugin_, Kate::MainWindow *mainWin )
     : Kate::PluginView( mainWin ),
     plugin( plugin_ ),
+    session(0),
     outputToolView(0),
+    pageStack(0),
+    evalQueueLabel(0),
+    cmdLine(0),
     helpToolView(0),
-    helpWidget(0)
+    helpWidget(0),
+    helpJobRequested( false ),
+    flashRange(0),
+    errorRange(0)
 {
+  qint64 start = ScateEvalTracker::now();
+  qint64 memory = ScatePlugin::residentMemory();
+
   setComponentData( ScatePluginFactory::componentData() );
   setXMLFile( "kate/plugins/katescate/ui.rc" );
 
   KAction *a;
   KAction *aLangRestart, *aSynthStart, *aSynthStop,
-  *aSwingStart, *aSwingStop, *aEval, *aStopProc, *aHelp;
+  *aSwingStart, *aSwingStop, *aEval, *aEvalRegion, *aStopProc, *aHelp;
 
   aLangSwitch = a = actionCollection()->addAction( "scate_lang_switch" );
   a->setCheckable( true );
@@ -70,13 +101,15 @@ ScateView::ScateView( ScatePlugin *plugin_, Kate::MainWindow *mainWin )
   a->setText( i18n("Shutdown Synth") );
   langDepActions.append(a);
 
-  a = actionCollection()->addAction( "scate_gui_qt", plugin, SLOT(switchToQt()) );
+  a = actionCollection()->addAction( "scate_gui_qt" );
   a->setText( i18n("Qt") );
   langDepActions.append(a);
+  sessionActions.append( SessionAction( a, SLOT(switchToQt()) ) );
 
-  a = actionCollection()->addAction( "scate_gui_swing", plugin, SLOT(switchToSwing()) );
+  a = actionCollection()->addAction( "scate_gui_swing" );
   a->setText( i18n("SwingOSC") );
   langDepActions.append(a);
+  sessionActions.append( SessionAction( a, SLOT(switchToSwing()) ) );
 
   aSwingStart = a = actionCollection()->addAction( "scate_swing_start" );
   a->setText( i18n("Boot SwingOSC Server") );
@@ -92,120 +125,331 @@ ScateView::ScateView( ScatePlugin *plugin_, Kate::MainWindow *mainWin )
   a->setShortcut( Qt::CTRL | Qt::Key_E );
   langDepActions.append(a);
 
+  aEvalRegion = a = actionCollection()->addAction( "scate_evaluate_region" );
+  a->setIcon( KIcon("media-playback-start") );
+  a->setText( i18n("Execute Region") );
+  a->setShortcut( Qt::CTRL | Qt::Key_Return );
+  langDepActions.append(a);
+
+  aLiveMode = a = actionCollection()->addAction( "scate_live_mode" );
+  a->setCheckable( true );
+  a->setText( i18n("Live Mode") );
+  connect( a, SIGNAL(triggered(bool)), this, SLOT(switchLiveMode(bool)) );
+
+  a = actionCollection()->addAction( "scate_evaluate_changed", this, SLOT(evaluateChangedBlocks()) );
+  a->setText( i18n("Execute Changed Blocks") );
+  a->setShortcut( Qt::CTRL | Qt::SHIFT | Qt::Key_Return );
+  langDepActions.append(a);
+
   aStopProc = a = actionCollection()->addAction( "scate_stop_proc" );
   a->setIcon( KIcon("media-playback-stop") );
   a->setText( i18n("Stop") );
   a->setShortcut( Qt::Key_Escape );
   langDepActions.append(a);
 
+  a = actionCollection()->addAction( "scate_interrupt" );
+  a->setIcon( KIcon("process-stop") );
+  a->setText( i18n("Interrupt Interpreter") );
+  a->setToolTip( i18n("Sends the interpreter a signal, which works even while it is busy") );
+  langDepActions.append(a);
+  sessionActions.append( SessionAction( a, SLOT(interrupt()) ) );
+
+  aCancelQueued = a = actionCollection()->addAction( "scate_cancel_queued" );
+  a->setIcon( KIcon("edit-delete") );
+  a->setText( i18n("Cancel Queued Evaluations") );
+  a->setEnabled( false );
+
   aClearOutput = a = actionCollection()->addAction( "scate_clear" );
   a->setIcon( KIcon("window-close") );
   a->setText( i18n("Clear Output") );
 
+  a = actionCollection()->addAction( "scate_statistics", this, SLOT(printStatistics()) );
+  a->setIcon( KIcon("view-statistics") );
+  a->setText( i18n("Output Statistics") );
+
+  aSession = actionCollection()->add<KSelectAction>( "scate_session" );
+  aSession->setText( i18n("Interpreter Session") );
+  aSession->setToolTip( i18n("The interpreter session evaluating the current document") );
+  aSession->setToolBarMode( KSelectAction::ComboBoxMode );
+  connect( aSession, SIGNAL(triggered(int)), this, SLOT(bindSession(int)) );
+
+  a = actionCollection()->addAction( "scate_check_benchmark", this, SLOT(benchmarkSyntaxCheck()) );
+  a->setText( i18n("Benchmark Syntax Check...") );
+
+  a = actionCollection()->addAction( "scate_help_pack", this, SLOT(packHelpFiles()) );
+  a->setText( i18n("Pack Help Files...") );
+
+  a = actionCollection()->addAction( "scate_help_benchmark", this, SLOT(benchmarkHelpLoading()) );
+  a->setText( i18n("Benchmark Help Loading") );
+
+  a = actionCollection()->addAction( "scate_open_log", this, SLOT(openPostLog()) );
+  a->setIcon( KIcon("document-open") );
+  a->setText( i18n("Open Post Log...") );
+
   aHelp = a = actionCollection()->addAction( "scate_help" );
   a->setIcon( KIcon("system-help") );
   a->setText( i18n("Help for Selection") );
   a->setShortcut( Qt::CTRL | Qt::Key_H );
 
+  flashTimer = new QTimer( this );
+  flashTimer->setSingleShot( true );
+  flashTimer->setInterval( 250 );
+  connect( flashTimer, SIGNAL(timeout()), this, SLOT(endFlash()) );
+  connect( plugin, SIGNAL(helpJobFinished(const QString&)),
+           this, SLOT(onHelpJobFinished(const QString&)) );
+
   mainWindow()->guiFactory()->addClient( this );
 
-  //TODO lazy creation (on-demand)
-  outputToolView = createOutputView();
-  helpToolView = createHelpView();
+  // Only the tool views are created here; what they contain, in particular
+  // the web view of the help browser, is created when they are first shown.
+  outputToolView = mainWindow()->createToolView(
+    "SC Terminal",
+    Kate::MainWindow::Right,
+    QPixmap( plugin->iconPath() ),
+    "SC Terminal"
+  );
+  outputToolView->installEventFilter( this );
+
+  helpToolView = mainWindow()->createToolView (
+    "SC Help",
+    Kate::MainWindow::Right,
+    QPixmap( plugin->iconPath() ),
+    "SC Help"
+  );
+  helpToolView->installEventFilter( this );
 
-  connect( plugin, SIGNAL(configChanged()), this, SLOT(applyConfig()) );
+  connect( plugin->settings(), SIGNAL(terminalFontChanged()), this, SLOT(applyTerminalFont()) );
 
-  connect( aLangSwitch, SIGNAL( triggered(bool) ), plugin, SLOT( switchLang(bool) ) );
-  connect( aLangRestart, SIGNAL( triggered(bool) ), plugin, SLOT( recompileLibrary() ) );
-  connect( aSynthStart, SIGNAL( triggered(bool) ), plugin, SLOT( startServer() ) );
-  connect( aSynthStop, SIGNAL( triggered(bool) ), plugin, SLOT( stopServer() ) );
-  connect( aSwingStart, SIGNAL( triggered(bool) ), plugin, SLOT( startSwingOSC() ) );
-  connect( aSwingStop, SIGNAL( triggered(bool) ), plugin, SLOT( stopSwingOSC() ) );
+  sessionActions.append( SessionAction( aLangSwitch, SLOT( switchLang(bool) ) ) );
+  sessionActions.append( SessionAction( aLangRestart, SLOT( recompileLibrary() ) ) );
+  sessionActions.append( SessionAction( aSynthStart, SLOT( startServer() ) ) );
+  sessionActions.append( SessionAction( aSynthStop, SLOT( stopServer() ) ) );
+  sessionActions.append( SessionAction( aSwingStart, SLOT( startSwingOSC() ) ) );
+  sessionActions.append( SessionAction( aSwingStop, SLOT( stopSwingOSC() ) ) );
+  sessionActions.append( SessionAction( aStopProc, SLOT( stopProcessing() ) ) );
   connect( aEval, SIGNAL( triggered(bool) ), this, SLOT( evaluateSelection() ) );
-  connect( aStopProc, SIGNAL( triggered(bool) ), plugin, SLOT( stopProcessing() ) );
-  connect( aClearOutput, SIGNAL( triggered(bool) ), scOutView, SLOT( clear() ) );
+  connect( aEvalRegion, SIGNAL( triggered(bool) ), this, SLOT( evaluateRegion() ) );
   connect( aHelp, SIGNAL( triggered(bool) ), this, SLOT( helpForSelectedClass() ) );
 
-  connect( plugin, SIGNAL( langSwitched(bool) ), this, SLOT( langStatusChanged(bool) ) );
+  connect( plugin, SIGNAL( sessionsChanged() ), this, SLOT( updateSessions() ) );
+  connect( plugin, SIGNAL( documentBound(KTextEditor::Document*) ), this, SLOT( updateSession() ) );
+  connect( mainWindow(), SIGNAL( viewChanged() ), this, SLOT( updateSession() ) );
+  connect( mainWindow(), SIGNAL( viewChanged() ), this, SLOT( updateLiveMode() ) );
+  updateLiveMode();
 
   //check and enable actions according to interpreter status
-  langStatusChanged( plugin->langRunning() );
+  updateSessions();
+
+  plugin->addStartupCost( ScatePlugin::WindowPart, ScateEvalTracker::now() - start,
+                          ScatePlugin::residentMemory() - memory );
 }
 
 ScateView::~ScateView()
 {
+  endFlash();
+  clearSyntaxError();
   mainWindow()->guiFactory()->removeClient( this );
   delete outputToolView;
   delete helpToolView;
 }
 
-void ScateView::applyConfig()
+void ScateView::applyTerminalFont()
+{
+  QFont font = plugin->settings()->terminalFont();
+  foreach( const Page &page, pages )
+    page.terminal->setFont( font );
+}
+
+void ScateView::updateSessions()
 {
-  if( scOutView ) {
-    KConfigGroup config(KGlobal::config(), "Scate");
-    scOutView->document()->setMaximumBlockCount( config.readEntry( "TerminalMaxRows", 500 ) );
-    scOutView->document()->setDefaultFont( config.readEntry( "TerminalFont", QFont() ) );
+  const QList<ScateSession*> &sessions = plugin->sessions();
+  QStringList names;
+  foreach( ScateSession *s, sessions ) {
+    names.append( s->name() );
+    if( pageStack && !pages.contains( s ) ) addPage( s );
+  }
+  aSession->setItems( names );
+  aSession->setEnabled( sessions.count() > 1 );
+
+  if( session && !sessions.contains( session ) ) setSession( 0 );
+  updateSession();
+  aSession->setCurrentItem( sessions.indexOf( session ) );
+
+  // the sessions removed are deleted later
+  foreach( ScateSession *s, pages.keys() ) {
+    if( sessions.contains( s ) ) continue;
+    disconnect( s, 0, this, 0 );
+    delete pages.take( s ).widget;
   }
 }
 
-QWidget * ScateView::createOutputView()
+void ScateView::updateSession()
 {
-  KConfigGroup config(KGlobal::config(), "Scate");
+  KTextEditor::View *view = mainWindow()->activeView();
+  // without a document, the terminal shown stays
+  if( !view && session ) return;
+  setSession( plugin->sessionOf( view ? view->document() : 0 ) );
+}
 
-  QWidget *toolView = mainWindow()->createToolView(
-    "SC Terminal",
-    Kate::MainWindow::Right,
-    QPixmap( plugin->iconPath() ),
-    "SC Terminal"
-  );
+void ScateView::setSession( ScateSession *s )
+{
+  if( s == session ) return;
+  if( session ) {
+    foreach( const SessionAction &a, sessionActions )
+      disconnect( a.first, SIGNAL(triggered(bool)), session, a.second );
+    disconnect( aCancelQueued, SIGNAL(triggered(bool)), session->evalQueue(), SLOT(cancelPending()) );
+    disconnect( aClearOutput, SIGNAL(triggered(bool)), session->terminalLines(), SLOT(clear()) );
+    disconnect( session, SIGNAL(langSwitched(bool)), this, SLOT(langStatusChanged(bool)) );
+    disconnect( session->evalQueue(), SIGNAL(changed()), this, SLOT(updateEvalQueue()) );
+  }
+  session = s;
+  if( !session ) return;
+
+  foreach( const SessionAction &a, sessionActions )
+    connect( a.first, SIGNAL(triggered(bool)), session, a.second );
+  connect( aCancelQueued, SIGNAL(triggered(bool)), session->evalQueue(), SLOT(cancelPending()) );
+  connect( aClearOutput, SIGNAL(triggered(bool)), session->terminalLines(), SLOT(clear()) );
+  connect( session, SIGNAL(langSwitched(bool)), this, SLOT(langStatusChanged(bool)) );
+  connect( session->evalQueue(), SIGNAL(changed()), this, SLOT(updateEvalQueue()) );
+
+  aSession->setCurrentItem( plugin->sessions().indexOf( session ) );
+  if( pageStack ) pageStack->setCurrentWidget( pages[session].widget );
+  updateEvalQueue();
+  langStatusChanged( session->langRunning() );
+}
 
-  QFont defaultFont("monospace");
-  defaultFont.setStyleHint(QFont::TypeWriter);
+void ScateView::bindSession( int index )
+{
+  ScateSession *s = plugin->sessions().value( index );
+  if( !s ) return;
+  KTextEditor::View *view = mainWindow()->activeView();
+  if( view )
+    plugin->bind( view->document(), s );
+  else
+    setSession( s );
+}
+
+void ScateView::evalCommand( const QString &code, bool silent )
+{
+  session->eval( code, silent );
+}
+
+bool ScateView::eventFilter( QObject *object, QEvent *event )
+{
+  if( event->type() == QEvent::Show ) {
+    if( object == outputToolView && !pageStack )
+      createTerminal();
+    else if( object == helpToolView && !helpWidget )
+      createHelpBrowser();
+  }
+  return false;
+}
 
-  scOutView = new QPlainTextEdit;
-  scOutView->setReadOnly( true );
-  scOutView->document()->setMaximumBlockCount( config.readEntry( "TerminalMaxRows", 500 ) );
-  scOutView->document()->setDefaultFont( config.readEntry( "TerminalFont", defaultFont ) );
-  scOutView->setTabStopWidth(20);
-  connect( plugin, SIGNAL( scSaid( const QString& ) ),
-           this, SLOT( scSaid( const QString& ) ) );
+void ScateView::createTerminal()
+{
+  qint64 start = ScateEvalTracker::now();
+  qint64 memory = ScatePlugin::residentMemory();
 
-  new PostSyntaxHighlighter(scOutView->document());
+  pageStack = new QStackedWidget();
 
   cmdLine = new CmdLine( "Code:", 30 );
   connect( cmdLine, SIGNAL( invoked( const QString&, bool ) ),
-           plugin, SLOT( eval( const QString&, bool ) ) );
+           this, SLOT( evalCommand( const QString&, bool ) ) );
 
   QToolBar *toolbar = new QToolBar();
   toolbar->setIconSize(QSize(16,16));
   toolbar->setToolButtonStyle( Qt::ToolButtonTextBesideIcon );
+  toolbar->addAction( aSession );
   toolbar->addAction( aClearOutput );
 
+  evalQueueLabel = new QLabel();
+  evalQueueLabel->setContentsMargins( 8, 0, 4, 0 );
+  toolbar->addWidget( evalQueueLabel );
+  toolbar->addAction( aCancelQueued );
+
   QLayout *l = new QVBoxLayout;
   l->setContentsMargins(0,0,0,0);
   l->setSpacing(0);
   l->addWidget( toolbar );
-  l->addWidget( scOutView );
+  l->addWidget( pageStack );
   l->addWidget( cmdLine );
 
-  QWidget *w = new QWidget (toolView);
+  QWidget *w = new QWidget (outputToolView);
   w->setLayout(l);
 
-  return toolView;
+  // output that arrived so far is in the sessions' line stores already
+  foreach( ScateSession *s, plugin->sessions() )
+    addPage( s );
+  // a tool view may be shown while the window is still being set up
+  if( session ) {
+    pageStack->setCurrentWidget( pages[session].widget );
+    updateEvalQueue();
+  }
+  w->show();
+
+  plugin->addStartupCost( ScatePlugin::TerminalPart, ScateEvalTracker::now() - start,
+                          ScatePlugin::residentMemory() - memory );
 }
 
-QWidget * ScateView::createHelpView()
+void ScateView::addPage( ScateSession *s )
 {
-  QWidget *toolView = mainWindow()->createToolView (
-    "SC Help",
-    Kate::MainWindow::Right,
-    QPixmap( plugin->iconPath() ),
-    "SC Help"
-  );
+  Page page;
+  page.terminal = new ScateTerminal( s->terminalLines() );
+  page.terminal->setFont( plugin->settings()->terminalFont() );
 
-  helpWidget = new ScateHelpBrowser( plugin, toolView );
+  ScateTerminalFindBar *findBar = new ScateTerminalFindBar( s->terminalLines(), page.terminal );
 
-  return toolView;
+  page.suppressedNotice = createNotice();
+  connect( s, SIGNAL(outputSuppressed(qint64, double, double)),
+           this, SLOT(showSuppressed(qint64, double, double)) );
+  connect( s, SIGNAL(outputResumed()), this, SLOT(hideSuppressed()) );
+
+  page.stallNotice = createNotice();
+  connect( s, SIGNAL(stalling(qint64)), this, SLOT(showStall(qint64)) );
+  connect( s, SIGNAL(responsive()), this, SLOT(hideStall()) );
+
+  QLayout *l = new QVBoxLayout;
+  l->setContentsMargins(0,0,0,0);
+  l->setSpacing(0);
+  l->addWidget( findBar );
+  l->addWidget( page.stallNotice );
+  l->addWidget( page.suppressedNotice );
+  l->addWidget( page.terminal );
+
+  page.widget = new QWidget;
+  page.widget->setLayout(l);
+  pageStack->addWidget( page.widget );
+
+  QShortcut *findShortcut = new QShortcut( QKeySequence::Find, page.widget, 0, 0,
+                                           Qt::WidgetWithChildrenShortcut );
+  connect( findShortcut, SIGNAL(activated()), findBar, SLOT(activate()) );
+
+  pages.insert( s, page );
+}
+
+QLabel * ScateView::createNotice()
+{
+  QLabel *notice = new QLabel();
+  notice->setWordWrap( true );
+  notice->setMargin( 4 );
+  notice->setBackgroundRole( QPalette::ToolTipBase );
+  notice->setForegroundRole( QPalette::ToolTipText );
+  notice->setAutoFillBackground( true );
+  notice->hide();
+  connect( notice, SIGNAL(linkActivated(QString)), this, SLOT(noticeLinkActivated(QString)) );
+  return notice;
+}
+
+void ScateView::createHelpBrowser()
+{
+  qint64 start = ScateEvalTracker::now();
+  qint64 memory = ScatePlugin::residentMemory();
+
+  helpWidget = new ScateHelpBrowser( plugin, helpToolView );
+  helpWidget->show();
+
+  plugin->addStartupCost( ScatePlugin::HelpPart, ScateEvalTracker::now() - start,
+                          ScatePlugin::residentMemory() - memory );
 }
 
 void ScateView::langStatusChanged( bool b_switch )
@@ -221,52 +465,375 @@ void ScateView::langStatusChanged( bool b_switch )
   }
 }
 
-void ScateView::scSaid( const QString& str )
+void ScateView::evaluateSelection()
 {
-  scOutView->moveCursor( QTextCursor::End );
-  scOutView->insertPlainText( str );
-  scOutView->ensureCursorVisible();
+  if( helpWidget && helpWidget->webViewFocused() ) {
+    QString text = helpWidget->selectedText();
+    if( !text.isEmpty() ) session->eval( text );
+    return;
+  }
+
+  KTextEditor::View *view = mainWindow()->activeView();
+  if( !view ) return;
+  if( view->selection() && view->blockSelection() ) {
+    // not a single range of the document, so errors are not pointed at
+    QString text = view->selectionText();
+    if( !text.isEmpty() ) plugin->sessionOf( view->document() )->eval( text );
+  }
+  else if( view->selection() )
+    evaluate( view, view->selectionRange() );
+  else {
+    int line = view->cursorPosition().line();
+    evaluate( view, KTextEditor::Range( line, 0, line, view->document()->lineLength( line ) ) );
+  }
 }
 
-void ScateView::evaluateSelection()
+bool ScateView::evaluate( KTextEditor::View *view, const KTextEditor::Range &range )
 {
-  QString text;
+  QString text = view->document()->text( range );
+  if( text.isEmpty() ) return false;
+
+  ScateSession *s = plugin->sessionOf( view->document() );
+  ScateSyntaxCheck::Error error;
+  if( s->eval( text, false, &error ) >= 0 ) return true;
+  if( error.isValid() ) {
+    error.moveBy( range.start().line(), range.start().column() );
+    s->sysMsg( error.text() );
+    showSyntaxError( view, error );
+  }
+  return false;
+}
 
+void ScateView::evaluateRegion()
+{
   if( helpWidget && helpWidget->webViewFocused() ) {
-    text = helpWidget->selectedText();
+    evaluateSelection();
+    return;
   }
-  else {
-    KTextEditor::View *view = mainWindow()->activeView();
-    if( view->selection() )
-        text = view->selectionText();
-    else
-        text = view->document()->line( view->cursorPosition().line() );
+
+  KTextEditor::View *view = mainWindow()->activeView();
+  if( !view ) return;
+  if( view->selection() ) {
+    evaluateSelection();
+    return;
+  }
+
+  KTextEditor::Document *doc = view->document();
+  KTextEditor::Range region = ScateRegionIndex::of( doc )->regionAt( view->cursorPosition() );
+  if( !region.isValid() ) {
+    evaluateSelection();
+    return;
+  }
+
+  if( evaluate( view, region ) ) flash( view, region );
+}
+
+void ScateView::switchLiveMode( bool on )
+{
+  KTextEditor::View *view = mainWindow()->activeView();
+  if( !view ) {
+    aLiveMode->setChecked( false );
+    return;
+  }
+
+  ScateLiveDocument *live = ScateLiveDocument::of( view->document() );
+  if( on && !live )
+    new ScateLiveDocument( view->document(), plugin->sessionOf( view->document() ) );
+  else if( !on && live )
+    live->disable();
+}
+
+void ScateView::updateLiveMode()
+{
+  KTextEditor::View *view = mainWindow()->activeView();
+  aLiveMode->setEnabled( view != 0 );
+  aLiveMode->setChecked( view && ScateLiveDocument::of( view->document() ) );
+}
+
+void ScateView::evaluateChangedBlocks()
+{
+  KTextEditor::View *view = mainWindow()->activeView();
+  if( !view ) return;
+
+  ScateLiveDocument *live = ScateLiveDocument::of( view->document() );
+  if( !live ) {
+    live = new ScateLiveDocument( view->document(), plugin->sessionOf( view->document() ) );
+    aLiveMode->setChecked( true );
   }
+  live->evaluateChanged();
+}
+
+void ScateView::flash( KTextEditor::View *view, const KTextEditor::Range &range )
+{
+  endFlash();
+
+  KTextEditor::Document *doc = view->document();
+  KTextEditor::MovingInterface *moving = qobject_cast<KTextEditor::MovingInterface*>( doc );
+  if( !moving ) return;
+
+  KTextEditor::Attribute::Ptr attr( new KTextEditor::Attribute() );
+  KColorScheme scheme( QPalette::Active, KColorScheme::View );
+  attr->setBackground( scheme.background( KColorScheme::PositiveBackground ) );
+
+  flashRange = moving->newMovingRange( range );
+  flashRange->setAttribute( attr );
+  connect( doc, SIGNAL(aboutToDeleteMovingInterfaceContent(KTextEditor::Document*)),
+           this, SLOT(endFlash()) );
+  flashTimer->start();
+}
+
+void ScateView::showSyntaxError( KTextEditor::View *view, const ScateSyntaxCheck::Error &error )
+{
+  clearSyntaxError();
+
+  KTextEditor::Document *doc = view->document();
+  KTextEditor::MovingInterface *moving = qobject_cast<KTextEditor::MovingInterface*>( doc );
+  if( !moving ) return;
+
+  KTextEditor::Attribute::Ptr attr( new KTextEditor::Attribute() );
+  KColorScheme scheme( QPalette::Active, KColorScheme::View );
+  attr->setBackground( scheme.background( KColorScheme::NegativeBackground ) );
+  attr->setUnderlineStyle( QTextCharFormat::WaveUnderline );
+  attr->setUnderlineColor( scheme.foreground( KColorScheme::NegativeText ).color() );
+
+  // stays until the document is edited
+  errorRange = moving->newMovingRange(
+    KTextEditor::Range( error.line, error.column, error.line, error.column + 1 ) );
+  errorRange->setAttribute( attr );
+  connect( doc, SIGNAL(textChanged(KTextEditor::Document*)), this, SLOT(clearSyntaxError()) );
+  connect( doc, SIGNAL(aboutToDeleteMovingInterfaceContent(KTextEditor::Document*)),
+           this, SLOT(clearSyntaxError()) );
+}
 
-  if( !text.isEmpty() ) plugin->eval( text );
+void ScateView::clearSyntaxError()
+{
+  if( !errorRange ) return;
+  KTextEditor::Document *doc = errorRange->document();
+  disconnect( doc, SIGNAL(textChanged(KTextEditor::Document*)), this, SLOT(clearSyntaxError()) );
+  disconnect( doc, SIGNAL(aboutToDeleteMovingInterfaceContent(KTextEditor::Document*)),
+              this, SLOT(clearSyntaxError()) );
+  delete errorRange;
+  errorRange = 0;
+}
+
+void ScateView::benchmarkSyntaxCheck()
+{
+  QString directory;
+  const char *candidates[] = {
+    "/usr/local/share/SuperCollider/SCClassLibrary",
+    "/usr/share/SuperCollider/SCClassLibrary"
+  };
+  for( int i = 0; i < 2 && directory.isEmpty(); ++i )
+    if( QFileInfo( candidates[i] ).isDir() ) directory = candidates[i];
+
+  directory = KFileDialog::getExistingDirectory(
+    KUrl( directory ), mainWindow()->window(), i18n("Class Library to Check") );
+  if( !directory.isEmpty() ) session->benchmarkSyntaxCheck( directory );
+}
+
+void ScateView::packHelpFiles()
+{
+  const QStringList &helpDirs = plugin->settings()->helpDirs();
+  if( helpDirs.isEmpty() ) {
+    KMessageBox::sorry( mainWindow()->window(),
+                        i18n("Please set at least one SuperCollider Help directory"
+                             " on the Scate configuration panel.") );
+    return;
+  }
+  // not asking about compression only to refuse after
+  if( plugin->isHelpJobRunning() ) {
+    session->sysMsg( "The help files are being packed or benchmarked already." );
+    return;
+  }
+
+  int answer = KMessageBox::questionYesNoCancel( mainWindow()->window(),
+    i18n("Compress the packed help files? The bundle gets smaller, but pages take"
+         " longer to unpack."),
+    i18n("Pack Help Files"), KGuiItem( i18n("Compress") ), KGuiItem( i18n("Do Not Compress") ) );
+  if( answer == KMessageBox::Cancel ) return;
+
+  if( !plugin->packHelpFiles( answer == KMessageBox::Yes ) ) {
+    session->sysMsg( "The help files are being packed or benchmarked already." );
+    return;
+  }
+  helpJobRequested = true;
+  session->sysMsg( "Packing help files..." );
+}
+
+void ScateView::benchmarkHelpLoading()
+{
+  ScateHelpIndex *index = plugin->helpIndex();
+  if( !index->isReady() ) {
+    session->sysMsg( "The help files are still being indexed, try again in a moment." );
+    return;
+  }
+
+  QStringList pages;
+  foreach( const QString &path, index->files() )
+    if( path.endsWith( ".html", Qt::CaseInsensitive ) ) pages << path;
+  if( pages.isEmpty() ) {
+    session->sysMsg( "There are no HTML help pages to load." );
+    return;
+  }
+
+  // an even sample of the pages
+  const int sampleSize = 500;
+  qSort( pages );
+  if( pages.count() > sampleSize ) {
+    QStringList sample;
+    for( int i = 0; i < sampleSize; ++i )
+      sample << pages[ (qint64) i * pages.count() / sampleSize ];
+    pages = sample;
+  }
+
+  if( !plugin->benchmarkHelpLoading( pages ) ) {
+    session->sysMsg( "The help files are being packed or benchmarked already." );
+    return;
+  }
+  helpJobRequested = true;
+  session->sysMsg( "Benchmarking help loading..." );
+}
+
+void ScateView::onHelpJobFinished( const QString &message )
+{
+  // only the window that asked for it tells
+  if( !helpJobRequested ) return;
+  helpJobRequested = false;
+  session->sysMsg( message );
+}
+
+void ScateView::endFlash()
+{
+  if( !flashRange ) return;
+  disconnect( flashRange->document(), SIGNAL(aboutToDeleteMovingInterfaceContent(KTextEditor::Document*)),
+              this, SLOT(endFlash()) );
+  delete flashRange;
+  flashRange = 0;
 }
 
 void ScateView::browseSelectedClass()
 {
   KTextEditor::View *view = mainWindow()->activeView();
-  if( view->selection() )
+  if( view && view->selection() )
   {
       QString text = view->selectionText();
-      plugin->eval( text + QString(".browse;"), true );
+      session->eval( text + QString(".browse;"), true );
   }
 }
 
 void ScateView::helpForSelectedClass()
 {
   KTextEditor::View *view = mainWindow()->activeView();
-  if( view->selection() )
+  if( view && view->selection() )
   {
       QString text = view->selectionText();
+      if( !helpWidget ) createHelpBrowser();
       helpWidget->searchHelp( text );
       mainWindow()->showToolView( helpToolView );
   }
 }
 
+void ScateView::showSuppressed( qint64 lines, double linesPerSecond, double bytesPerSecond )
+{
+  ScateSession *s = qobject_cast<ScateSession*>( sender() );
+  if( !pages.contains( s ) ) return;
+  QLabel *suppressedNotice = pages[s].suppressedNotice;
+  suppressedNotice->setText(
+    i18n("<b>%1 lines suppressed</b> - output is arriving too fast to display "
+         "(%2 lines/s, %3 KiB/s). "
+         "<a href=\"stop\">Stop Processing</a> &nbsp; <a href=\"resume\">Show Output</a>",
+         lines, qRound64( linesPerSecond ), qRound64( bytesPerSecond / 1024 ) ) );
+  suppressedNotice->show();
+}
+
+void ScateView::hideSuppressed()
+{
+  ScateSession *s = qobject_cast<ScateSession*>( sender() );
+  if( pages.contains( s ) ) pages[s].suppressedNotice->hide();
+}
+
+void ScateView::showStall( qint64 nsecs )
+{
+  ScateSession *s = qobject_cast<ScateSession*>( sender() );
+  if( !pages.contains( s ) ) return;
+  QLabel *stallNotice = pages[s].stallNotice;
+  stallNotice->setText(
+    i18n("<b>The interpreter has not responded for %1 s</b> - it may be stuck in a long "
+         "computation. <a href=\"interrupt\">Interrupt</a>",
+         nsecs / 1000000000 ) );
+  stallNotice->show();
+}
+
+void ScateView::hideStall()
+{
+  ScateSession *s = qobject_cast<ScateSession*>( sender() );
+  if( pages.contains( s ) ) pages[s].stallNotice->hide();
+}
+
+void ScateView::noticeLinkActivated( const QString &link )
+{
+  ScateSession *s = 0;
+  QHash<ScateSession*, Page>::const_iterator it;
+  for( it = pages.constBegin(); it != pages.constEnd(); ++it )
+    if( it->suppressedNotice == sender() || it->stallNotice == sender() ) s = it.key();
+  if( !s ) return;
+
+  if( link == "stop" )
+    s->stopProcessing();
+  else if( link == "resume" )
+    s->resumeOutput();
+  else if( link == "interrupt" )
+    s->interrupt();
+}
+
+void ScateView::updateEvalQueue()
+{
+  ScateEvalQueue *queue = session->evalQueue();
+  int depth = queue->depth();
+  aCancelQueued->setEnabled( queue->cancellableCount() > 0 );
+  if( !evalQueueLabel )
+    return;
+  else if( depth == 0 )
+    evalQueueLabel->clear();
+  else
+    evalQueueLabel->setText( i18np( "1 evaluation queued (%2 KiB)",
+                                    "%1 evaluations queued (%2 KiB)",
+                                    depth, ( queue->queuedBytes() + 1023 ) / 1024 ) );
+}
+
+void ScateView::printStatistics()
+{
+  session->printStatistics();
+  session->sysMsg( plugin->startupStatistics() );
+  session->sysMsg( plugin->helpStatistics() );
+}
+
+void ScateView::openPostLog()
+{
+  QString fileName = KFileDialog::getOpenFileName(
+    KUrl( session->postLogDirectory() ), "*.log|" + i18n("Post Logs"),
+    mainWindow()->window(), i18n("Open Post Log") );
+  if( fileName.isEmpty() ) return;
+
+  ScatePostLogFile *log = new ScatePostLogFile();
+  if( !log->open( fileName ) ) {
+    delete log;
+    KMessageBox::error( mainWindow()->window(),
+                        i18n("Could not open the post log %1.", fileName) );
+    return;
+  }
+
+  // The log is mapped into memory and only the visible lines are read,
+  // so even large logs open instantly.
+  ScateTerminal *logView = new ScateTerminal( log );
+  log->setParent( logView );
+  logView->setAttribute( Qt::WA_DeleteOnClose );
+  logView->setWindowTitle( i18n("SC Post Log - %1", QFileInfo( fileName ).fileName()) );
+  logView->setFont( plugin->settings()->terminalFont() );
+  logView->resize( 800, 600 );
+  logView->show();
+}
+
 void ScateView::readSessionConfig( KConfigBase* config, const QString& groupPrefix )
 {
   // If you have session-dependant settings, load them here.
@@ -284,14 +851,3 @@ void ScateView::writeSessionConfig( KConfigBase* config, const QString& groupPre
   Q_UNUSED( config );
   Q_UNUSED( groupPrefix );
 }
-
-void PostSyntaxHighlighter::highlightBlock ( const QString & text )
-{
-    if (text.startsWith("ERROR", Qt::CaseInsensitive)) {
-        QTextBlock b(currentBlock());
-        QTextBlockFormat fm(b.blockFormat());
-        fm.setBackground(Qt::red);
-        QTextCursor c(b);
-        c.setBlockFormat(fm);
-    }
-}
@@ -23,19 +23,32 @@
 #define SCATE_VIEW_H
 
 #include "cmdline.hpp"
+#include "ScateSyntaxCheck.hpp"
 
 #include <kxmlguiclient.h>
 #include <kate/plugin.h>
 #include <kate/mainwindow.h>
 
-#include <QPlainTextEdit>
-#include <QLineEdit>
-#include <QSyntaxHighlighter>
+#include <QHash>
+#include <QPair>
+
 
 class ScatePlugin;
+class ScateSession;
 class ScateHelpWidget;
 class ScateCmdLine;
 class ScateHelpBrowser;
+class ScateTerminal;
+class QLabel;
+class QTimer;
+class QStackedWidget;
+class KSelectAction;
+
+namespace KTextEditor {
+  class View;
+  class Range;
+  class MovingRange;
+}
 
 class ScateView : public Kate::PluginView, public KXMLGUIClient
 {
@@ -48,37 +61,96 @@ class ScateView : public Kate::PluginView, public KXMLGUIClient
     virtual void readSessionConfig( KConfigBase* config, const QString& groupPrefix );
     virtual void writeSessionConfig( KConfigBase* config, const QString& groupPrefix );
   public slots:
-    void applyConfig();
+    void applyTerminalFont();
     void evaluateSelection();
+    // Evaluates the region around the cursor, or the selection or line if
+    // there is none.
+    void evaluateRegion();
+    // Evaluates the blocks of the current document that changed since they
+    // were evaluated, turning on live mode for it.
+    void evaluateChangedBlocks();
+    void switchLiveMode( bool );
     void browseSelectedClass();
     void helpForSelectedClass();
+    void openPostLog();
+    void benchmarkSyntaxCheck();
+    // Packs the help files into the help bundle, in the background.
+    void packHelpFiles();
+    // Compares loading help pages from loose files and from the bundle.
+    void benchmarkHelpLoading();
+    // Prints the statistics of the current session and the cost of
+    // starting the plugin.
+    void printStatistics();
+    // Binds the active document to the session at the given index.
+    void bindSession( int );
   private slots:
     void langStatusChanged( bool );
-    void scSaid( const QString& );
+    // Follows the session of the active document.
+    void updateSession();
+    void updateSessions();
+    void evalCommand( const QString &, bool silent );
+    void showSuppressed( qint64 lines, double linesPerSecond, double bytesPerSecond );
+    void hideSuppressed();
+    void showStall( qint64 nsecs );
+    void hideStall();
+    void noticeLinkActivated( const QString & );
+    void updateEvalQueue();
+    void endFlash();
+    void clearSyntaxError();
+    void updateLiveMode();
+    void onHelpJobFinished( const QString & );
   private:
-    QWidget * createOutputView();
-    QWidget * createHelpView();
+    // The terminal of a session.
+    struct Page {
+      QWidget *widget;
+      ScateTerminal *terminal;
+      QLabel *suppressedNotice;
+      QLabel *stallNotice;
+    };
+
+    bool eventFilter( QObject *, QEvent * );
+    void createTerminal();
+    void addPage( ScateSession * );
+    QLabel *createNotice();
+    // Has the actions and the terminal act on a session.
+    void setSession( ScateSession * );
+    // Evaluates a range of a document, pointing at the mistake if the
+    // syntax check fails. Returns whether the code was sent.
+    bool evaluate( KTextEditor::View *, const KTextEditor::Range & );
+    void showSyntaxError( KTextEditor::View *, const ScateSyntaxCheck::Error & );
+    // Highlights evaluated code for a moment.
+    void flash( KTextEditor::View *, const KTextEditor::Range & );
+    void createHelpBrowser();
 
     ScatePlugin *plugin;
+    // the session of the active document
+    ScateSession *session;
 
     QWidget *outputToolView;
-    QPlainTextEdit *scOutView;
+    QStackedWidget *pageStack;
+    QHash<ScateSession*, Page> pages;
+    QLabel *evalQueueLabel;
     Scate::CmdLine *cmdLine;
 
     QWidget *helpToolView;
     ScateHelpBrowser *helpWidget;
+    // this window asked the plugin to pack or benchmark the help bundle
+    bool helpJobRequested;
 
     QAction *aLangSwitch;
     QList<QAction*> langDepActions;
+    // actions triggering a slot of the current session
+    typedef QPair<QAction*, const char*> SessionAction;
+    QList<SessionAction> sessionActions;
+    KSelectAction *aSession;
 
     QAction *aClearOutput;
-};
+    QAction *aCancelQueued;
+    QAction *aLiveMode;
 
-class PostSyntaxHighlighter : QSyntaxHighlighter
-{
-public:
-    PostSyntaxHighlighter(QTextDocument *doc) : QSyntaxHighlighter(doc) {}
-    void highlightBlock ( const QString & );
+    KTextEditor::MovingRange *flashRange;
+    KTextEditor::MovingRange *errorRange;
+    QTimer *flashTimer;
 };
 
 #endif //SCATE_VIEW_H